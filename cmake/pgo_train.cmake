@@ -0,0 +1,37 @@
+# Training renders of a profile guided build, run by the pgo-train target. Renders random_scene() through
+# the flat and the generic kernel, once per kernel instruction set this machine can run, so that no
+# version the renders use is optimized as if it never ran.
+#
+# Expects RTIOW (the instrumented executable), PROFILE_DIR, WORK_DIR and, for Clang, LLVM_PROFDATA.
+
+# Stale profiles of an older binary would be merged into the new ones.
+file(REMOVE_RECURSE ${PROFILE_DIR})
+
+foreach(isa baseline sse4.2 avx2 avx512)
+    foreach(kernel auto generic)
+        execute_process(
+            COMMAND ${RTIOW} --headless --scene random --kernel ${kernel} --isa ${isa}
+                --width 400 --samples 8 -t ppm -f ${WORK_DIR}/pgo-training.ppm
+            RESULT_VARIABLE result)
+
+        if(NOT result EQUAL 0)
+            if(isa STREQUAL "baseline")
+                message(FATAL_ERROR "The training render failed")
+            endif()
+            message(STATUS "Skipping the ${isa} kernels, this machine can not run them")
+            break()
+        endif()
+    endforeach()
+endforeach()
+
+# Clang writes raw profiles that have to be merged into the one file -fprofile-use reads.
+if(LLVM_PROFDATA)
+    file(GLOB raw_profiles ${PROFILE_DIR}/*.profraw)
+    execute_process(
+        COMMAND ${LLVM_PROFDATA} merge -output=${PROFILE_DIR}/rtiow.profdata ${raw_profiles}
+        RESULT_VARIABLE result)
+
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "Merging the training profiles failed")
+    endif()
+endif()
@@ -0,0 +1,255 @@
+#include "rtiow_core.hpp"
+
+#include "../graphics/cpu_renderer.hpp"
+#include "../graphics/isa.hpp"
+#include "../graphics/render_control.hpp"
+#include "../graphics/renderer_context.hpp"
+#include "../graphics/thread_pool.hpp"
+#include "../graphics/view_context.hpp"
+#include "../scene/camera.hpp"
+#include "../scene/scene_loader.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace jmrtiow::core
+{
+    namespace
+    {
+        // Edge of the square tiles threads take from a region, rtiow's default
+        constexpr uint32_t tile_size = 32;
+
+        math::vec3 to_vec3(const double (&v)[3])
+        {
+            return math::vec3(v[0], v[1], v[2]);
+        }
+    }
+
+    struct renderer::state
+    {
+    public:
+        explicit state(uint32_t thread_count) : pool(thread_count) {}
+
+        graphics::thread_pool pool;
+        graphics::render_control control {};
+        graphics::cpu_renderer cpu {};
+
+        struct cached_scene
+        {
+        public:
+            scene_settings settings;
+            std::unique_ptr<scene::loaded_scene> loaded;
+        };
+
+        // Serializes build_scene() and render_region() calls, and guards the scene cache.
+        std::mutex render_mutex {};
+        // Most recently used first, the front is the current scene.
+        std::list<cached_scene> scenes {};
+        uint32_t scene_cache_size = 1;
+
+        // Rows of the whole image width holding the region, render kernels index the image by its width.
+        std::vector<math::color3> band {};
+
+        std::atomic<uint64_t> samples_done = 0;
+        std::atomic<uint64_t> samples_total = 0;
+        std::atomic<bool> running = false;
+    };
+
+    renderer::renderer(uint32_t thread_count)
+        : impl(std::make_unique<state>(thread_count > 0 ? thread_count : std::max(1u, std::thread::hardware_concurrency())))
+    {
+    }
+
+    renderer::~renderer()
+    {
+        impl->control.stop();
+    }
+
+    bool renderer::build_scene(const scene_settings& settings)
+    {
+        std::lock_guard<std::mutex> lock(impl->render_mutex);
+
+        auto& scenes = impl->scenes;
+        auto cached = std::find_if(scenes.begin(), scenes.end(), [&](const state::cached_scene& c) { return c.settings == settings; });
+        if (cached != scenes.end())
+        {
+            scenes.splice(scenes.begin(), scenes, cached);
+            return true;
+        }
+
+        scene::scene_description description {
+            .name = settings.name,
+            .texture = settings.texture,
+            .procedural = scene::procedural_settings {
+                .sphere_count = settings.sphere_count,
+                .distribution = settings.clustered ? scene::sphere_distribution::clustered : scene::sphere_distribution::uniform,
+                .diffuse_weight = settings.diffuse_weight,
+                .metal_weight = settings.metal_weight,
+                .glass_weight = settings.glass_weight,
+                .seed = settings.scene_seed,
+                .thread_count = impl->pool.size(),
+            },
+            .shutter = math::interval(settings.shutter_open, settings.shutter_close),
+            .flatten = settings.flatten,
+        };
+
+        auto loaded = std::make_unique<scene::loaded_scene>();
+        if (!scene::load_scene(description, *loaded))
+            return false;
+
+        scenes.push_front(state::cached_scene { .settings = settings, .loaded = std::move(loaded) });
+        while (scenes.size() > impl->scene_cache_size)
+            scenes.pop_back();
+
+        return true;
+    }
+
+    void renderer::set_scene_cache_size(uint32_t scenes)
+    {
+        std::lock_guard<std::mutex> lock(impl->render_mutex);
+
+        impl->scene_cache_size = std::max(scenes, 1u);
+        while (impl->scenes.size() > impl->scene_cache_size)
+            impl->scenes.pop_back();
+    }
+
+    bool renderer::render_region(const image_settings& image, const region& area, uint32_t first_sample, uint32_t samples, rgb* pixels)
+    {
+        std::lock_guard<std::mutex> lock(impl->render_mutex);
+
+        if (impl->scenes.empty())
+        {
+            std::cerr << "No scene to render, build_scene() was not called or failed\n";
+            return false;
+        }
+
+        if (image.width < 2 || image.height < 2 || area.width == 0 || area.height == 0 || area.x >= image.width || area.y >= image.height
+            || area.width > image.width - area.x || area.height > image.height - area.y)
+        {
+            std::cerr << "Region " << area.width << "x" << area.height << " at " << area.x << "," << area.y << " is not inside the "
+                      << image.width << "x" << image.height << " image\n";
+            return false;
+        }
+
+        graphics::isa_level isa = graphics::detect_isa();
+        if (image.isa != "auto" && (!graphics::parse_isa(image.isa, isa) || !graphics::isa_supported(isa)))
+        {
+            std::cerr << "This build or CPU can not run the " << image.isa << " kernels\n";
+            return false;
+        }
+
+        const state::cached_scene& current = impl->scenes.front();
+        const camera_settings& view = image.camera;
+        scene::camera cam(to_vec3(view.lookfrom), to_vec3(view.lookat), to_vec3(view.vup), view.vfov, static_cast<double>(image.width) / image.height,
+            view.aperture, view.focus_distance, math::interval(current.settings.shutter_open, current.settings.shutter_close));
+
+        scene::loaded_scene& loaded = *current.loaded;
+        graphics::renderer_context context {
+            .max_depth = image.max_depth,
+            .samples_per_pixel = 1,
+            .control = &impl->control,
+            .scene = loaded.bvh.get(),
+            .spheres = loaded.flattened ? &loaded.spheres : nullptr,
+            .isa = isa,
+            .lights = loaded.lights.objects.empty() ? nullptr : &loaded.lights,
+            .background = loaded.background,
+            .camera = &cam,
+        };
+
+        // Image rows count from the bottom, regions from the top.
+        uint32_t first_row = image.height - area.y - area.height;
+        impl->band.resize(static_cast<size_t>(image.width) * area.height);
+        math::color3* band_data = impl->band.data();
+
+        if (first_sample > 0)
+        {
+            for (uint32_t row = 0; row < area.height; row++)
+            {
+                const rgb* source = pixels + static_cast<size_t>(area.height - 1 - row) * area.width;
+                math::color3* target = band_data + static_cast<size_t>(row) * image.width + area.x;
+                for (uint32_t i = 0; i < area.width; i++)
+                    target[i] = math::color3(source[i].r, source[i].g, source[i].b);
+            }
+        }
+
+        uint64_t epoch = impl->control.epoch();
+        impl->samples_done = 0;
+        impl->samples_total = static_cast<uint64_t>(area.width) * area.height * samples;
+        impl->running = true;
+
+        // Tiles vary a lot in cost, threads take the next one as they finish instead of a fixed share.
+        uint32_t tiles_per_row = (area.width + tile_size - 1) / tile_size;
+        size_t tile_count = static_cast<size_t>(tiles_per_row) * ((area.height + tile_size - 1) / tile_size);
+        std::atomic<size_t> next_tile = 0;
+
+        impl->pool.run_on_all([&](uint32_t)
+            {
+                for (size_t t = next_tile++; t < tile_count && !impl->control.cancelled(epoch); t = next_tile++)
+                {
+                    uint32_t x = static_cast<uint32_t>(t % tiles_per_row) * tile_size;
+                    uint32_t y = static_cast<uint32_t>(t / tiles_per_row) * tile_size;
+
+                    graphics::view_context tile_view {
+                        .width = std::min(tile_size, area.width - x),
+                        .height = std::min(tile_size, area.height - y),
+                        .x = area.x + x,
+                        .y = first_row + y,
+                        .data = &band_data,
+                        .data_width = image.width,
+                        .data_height = image.height,
+                        .data_y = first_row,
+                        .seed = image.seed,
+                        .iteration = first_sample,
+                        .block = 1,
+                        .epoch = epoch,
+                        .aovs = nullptr,
+                    };
+
+                    // One sample at a time, so progress moves while a tile renders.
+                    for (uint32_t sample = 0; sample < samples && !impl->control.cancelled(epoch); sample++)
+                    {
+                        impl->cpu.render_samples(context, tile_view, 1);
+                        impl->samples_done += static_cast<uint64_t>(tile_view.width) * tile_view.height;
+                    }
+                }
+            });
+
+        impl->running = false;
+        if (impl->control.cancelled(epoch))
+            return false;
+
+        for (uint32_t row = 0; row < area.height; row++)
+        {
+            const math::color3* source = band_data + static_cast<size_t>(row) * image.width + area.x;
+            rgb* target = pixels + static_cast<size_t>(area.height - 1 - row) * area.width;
+            for (uint32_t i = 0; i < area.width; i++)
+                target[i] = rgb { .r = source[i].r, .g = source[i].g, .b = source[i].b };
+        }
+
+        return true;
+    }
+
+    progress renderer::query_progress() const
+    {
+        return progress {
+            .samples_done = impl->samples_done.load(),
+            .samples_total = impl->samples_total.load(),
+            .running = impl->running.load(),
+        };
+    }
+
+    void renderer::cancel()
+    {
+        impl->control.cancel();
+    }
+
+    uint32_t renderer::thread_count() const
+    {
+        return impl->pool.size();
+    }
+}
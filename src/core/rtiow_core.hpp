@@ -0,0 +1,144 @@
+#ifndef CORE_RTIOW_CORE_HPP
+#define CORE_RTIOW_CORE_HPP
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+
+// Public API of the rtiow_core library. Only this header is needed to embed the renderer, it includes
+// none of the renderer's own headers, so their changes do not reach code built against it.
+
+namespace jmrtiow::core
+{
+    /// @brief Raised whenever a declaration of this header changes incompatibly
+    constexpr uint32_t api_version = 1;
+
+    /// @brief Scene to build, the same scenes and parameters as rtiow's command line
+    struct scene_settings
+    {
+    public:
+        /// @brief random, demo, demo2, bouncing, checkered, perlin, earth, lights or procedural
+        std::string name = "random";
+        /// @brief Image wrapped around the sphere of the earth scene
+        std::string texture = "earthmap.jpg";
+        /// @brief Number of spheres of the procedural scene
+        uint64_t sphere_count = 10000;
+        /// @brief Pile the procedural scene's spheres up in clusters instead of spreading them evenly
+        bool clustered = false;
+        /// @brief Relative weights of diffuse, metal and glass spheres in the procedural scene
+        double diffuse_weight = 0.8;
+        double metal_weight = 0.15;
+        double glass_weight = 0.05;
+        /// @brief Seed of the procedural scene
+        uint64_t scene_seed = 0;
+        /// @brief Times the camera shutter opens and closes, for motion blur
+        double shutter_open = 0.0;
+        double shutter_close = 1.0;
+        /// @brief Render scenes of plain spheres with the inlined sphere kernel, false always traces
+        /// through virtual calls
+        bool flatten = true;
+
+        bool operator==(const scene_settings&) const = default;
+    };
+
+    /// @brief Camera the image is rendered through, by default the one of rtiow
+    struct camera_settings
+    {
+    public:
+        double lookfrom[3] = { 13, 2, 3 };
+        double lookat[3] = { 0, 0, 0 };
+        double vup[3] = { 0, 1, 0 };
+        /// @brief Vertical field of view in degrees
+        double vfov = 20;
+        double aperture = 0.1;
+        double focus_distance = 10;
+    };
+
+    /// @brief The whole image regions are rendered from
+    struct image_settings
+    {
+    public:
+        uint32_t width = 1200;
+        uint32_t height = 800;
+        camera_settings camera {};
+        /// @brief Maximum depth a ray will travel
+        uint32_t max_depth = 25;
+        /// @brief Base seed, equal seeds render equal pixels whatever the region or thread count
+        uint64_t seed = 0;
+        /// @brief Kernel instruction set: auto, baseline, sse4.2, avx2 or avx512
+        std::string isa = "auto";
+    };
+
+    /// @brief Rectangle of the image, from its top left corner
+    struct region
+    {
+    public:
+        uint32_t x;
+        uint32_t y;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    /// @brief Gamma corrected pixel, the values rtiow writes to its images
+    struct rgb
+    {
+    public:
+        double r;
+        double g;
+        double b;
+    };
+
+    /// @brief Samples of the current, or else the last, render_region() call
+    struct progress
+    {
+    public:
+        /// @brief Pixel samples rendered so far
+        uint64_t samples_done;
+        /// @brief Pixel samples the call renders in all
+        uint64_t samples_total;
+        bool running;
+    };
+
+    /// @brief Renders regions of images of one scene on a pool of threads
+    class renderer
+    {
+    public:
+        /// @param thread_count Render threads, 0 for one per core
+        explicit renderer(uint32_t thread_count = 0);
+        ~renderer();
+
+        renderer(const renderer&) = delete;
+        renderer& operator=(const renderer&) = delete;
+
+        /// @brief Builds the scene and its BVH, replacing the previous scene once a running
+        /// render_region() call returned. Scenes built with equal settings before are taken from the
+        /// scene cache instead.
+        /// @return False if settings name no scene
+        bool build_scene(const scene_settings& settings);
+
+        /// @brief Number of built scenes kept for build_scene() to return to, 1 by default. The least
+        /// recently used scenes are dropped first, the current scene never.
+        void set_scene_cache_size(uint32_t scenes);
+
+        /// @brief Adds samples samples per pixel to area of image. pixels holds area row by row, top
+        /// row first, and the mean of the area's first first_sample samples, so a region refines over
+        /// several calls and gives the pixels of a single call. Calls from several threads run one after
+        /// another.
+        /// @return False without a scene, for invalid settings or if cancel() stopped the render
+        bool render_region(const image_settings& image, const region& area, uint32_t first_sample, uint32_t samples, rgb* pixels);
+
+        /// @brief Safe to call from any thread
+        progress query_progress() const;
+
+        /// @brief Stops the running render_region() call, from any thread
+        void cancel();
+
+        uint32_t thread_count() const;
+
+    private:
+        struct state;
+        std::unique_ptr<state> impl;
+    };
+}
+
+#endif // CORE_RTIOW_CORE_HPP
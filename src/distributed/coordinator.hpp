@@ -0,0 +1,225 @@
+#ifndef DISTRIBUTED_COORDINATOR_HPP
+#define DISTRIBUTED_COORDINATOR_HPP
+
+#include "protocol.hpp"
+
+#include <deque>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace jmrtiow::distributed
+{
+    /// @brief Splits a render across worker processes and merges their tiles into one image.
+    class coordinator
+    {
+    public:
+        /// @brief Spawns worker_count copies of executable, each with worker_args plus --worker-fd
+        coordinator(const std::string& executable, const std::vector<std::string>& worker_args, uint32_t worker_count);
+        ~coordinator();
+
+        coordinator(const coordinator&) = delete;
+        coordinator& operator=(const coordinator&) = delete;
+
+        /// @brief Renders every tile on the workers and writes the results into image.
+        /// @return False if every worker died before all tiles were returned
+        bool render(const std::vector<graphics::tile>& tiles, uint32_t samples, uint64_t seed, math::color3* image, uint32_t image_width);
+
+    private:
+        struct worker_process
+        {
+            pid_t pid;
+            int fd;
+            /// @brief Tile in flight on this worker, or -1 when idle
+            int64_t tile_index;
+        };
+
+        void close_worker(worker_process& worker);
+
+        std::vector<worker_process> workers;
+    };
+
+    inline coordinator::coordinator(const std::string& executable, const std::vector<std::string>& worker_args, uint32_t worker_count)
+    {
+        for (uint32_t i = 0; i < worker_count; i++)
+        {
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+                throw std::runtime_error("Could not create a socket pair for a render worker");
+
+            // Only the worker's end of the pair may survive exec.
+            fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+
+            // The command line is built before forking: other threads may hold the allocator's locks,
+            // so the child must not allocate before exec.
+            std::vector<std::string> args { executable };
+            args.insert(args.end(), worker_args.begin(), worker_args.end());
+            args.push_back("--worker-fd");
+            args.push_back(std::to_string(fds[1]));
+
+            std::vector<char*> argv {};
+            for (auto& arg : args)
+                argv.push_back(arg.data());
+            argv.push_back(nullptr);
+
+            pid_t pid = fork();
+            if (pid < 0)
+            {
+                close(fds[0]);
+                close(fds[1]);
+                throw std::runtime_error("Could not fork a render worker");
+            }
+
+            if (pid == 0)
+            {
+                execv(argv[0], argv.data());
+                _exit(127);
+            }
+
+            close(fds[1]);
+            workers.push_back(worker_process { .pid = pid, .fd = fds[0], .tile_index = -1 });
+        }
+    }
+
+    inline coordinator::~coordinator()
+    {
+        // Hanging up is the shutdown signal, workers exit once their socket reaches EOF.
+        for (auto& worker : workers)
+        {
+            close_worker(worker);
+        }
+
+        for (auto& worker : workers)
+        {
+            waitpid(worker.pid, nullptr, 0);
+        }
+    }
+
+    inline void coordinator::close_worker(worker_process& worker)
+    {
+        if (worker.fd >= 0)
+        {
+            close(worker.fd);
+            worker.fd = -1;
+        }
+    }
+
+    inline bool coordinator::render(const std::vector<graphics::tile>& tiles, uint32_t samples, uint64_t seed, math::color3* image, uint32_t image_width)
+    {
+        std::deque<uint32_t> pending {};
+        for (uint32_t i = 0; i < tiles.size(); i++)
+        {
+            pending.push_back(i);
+        }
+
+        std::vector<math::color3> pixels {};
+        size_t completed = 0;
+
+        while (completed < tiles.size())
+        {
+            // Hand a tile to every idle worker.
+            for (auto& worker : workers)
+            {
+                if (worker.fd < 0 || worker.tile_index >= 0 || pending.empty())
+                    continue;
+
+                uint32_t tile_index = pending.front();
+                job_message job {
+                    .magic = job_magic,
+                    .tile_index = tile_index,
+                    .region = tiles[tile_index],
+                    .samples = samples,
+                    .seed = seed,
+                };
+
+                if (write_all(worker.fd, &job, sizeof(job)))
+                {
+                    pending.pop_front();
+                    worker.tile_index = tile_index;
+                }
+                else
+                {
+                    close_worker(worker);
+                }
+            }
+
+            std::vector<pollfd> poll_fds {};
+            std::vector<worker_process*> polled {};
+            for (auto& worker : workers)
+            {
+                if (worker.fd >= 0 && worker.tile_index >= 0)
+                {
+                    poll_fds.push_back(pollfd { .fd = worker.fd, .events = POLLIN, .revents = 0 });
+                    polled.push_back(&worker);
+                }
+            }
+
+            if (poll_fds.empty())
+            {
+                std::cerr << "All render workers exited before the frame completed\n";
+                return false;
+            }
+
+            if (poll(poll_fds.data(), poll_fds.size(), -1) < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+
+            for (size_t i = 0; i < poll_fds.size(); i++)
+            {
+                if (poll_fds[i].revents == 0)
+                    continue;
+
+                worker_process& worker = *polled[i];
+                const graphics::tile& region = tiles[worker.tile_index];
+
+                result_message result;
+                bool received = read_all(worker.fd, &result, sizeof(result))
+                    && result.magic == result_magic
+                    && result.tile_index == worker.tile_index
+                    && result.pixel_count == region.width * region.height;
+
+                if (received)
+                {
+                    pixels.resize(result.pixel_count);
+                    received = read_all(worker.fd, pixels.data(), pixels.size() * sizeof(math::color3));
+                }
+
+                if (!received)
+                {
+                    // Give the tile to someone else, its seed makes the result identical.
+                    std::cerr << "Render worker " << worker.pid << " failed, requeueing tile " << worker.tile_index << '\n';
+                    pending.push_back(static_cast<uint32_t>(worker.tile_index));
+                    worker.tile_index = -1;
+                    close_worker(worker);
+                    continue;
+                }
+
+                // Tiles are disjoint, so the merged image does not depend on arrival order.
+                for (uint32_t j = 0; j < region.height; j++)
+                {
+                    for (uint32_t k = 0; k < region.width; k++)
+                    {
+                        image[(region.y + j) * image_width + region.x + k] = pixels[j * region.width + k];
+                    }
+                }
+
+                worker.tile_index = -1;
+                completed++;
+            }
+        }
+
+        return true;
+    }
+}
+
+#endif // DISTRIBUTED_COORDINATOR_HPP
@@ -0,0 +1,87 @@
+#ifndef DISTRIBUTED_PROTOCOL_HPP
+#define DISTRIBUTED_PROTOCOL_HPP
+
+#include <stdint.h>
+#include <errno.h>
+#include <sys/socket.h>
+
+#include "../graphics/tile.hpp"
+#include "../math/color3.hpp"
+
+namespace jmrtiow::distributed
+{
+    // Messages are exchanged over local stream sockets between processes of the same binary
+    // on the same machine, so they are sent as raw structs in native byte order.
+
+    constexpr uint32_t job_magic = 0x424f4a52;    // "RJOB"
+    constexpr uint32_t result_magic = 0x534c5252; // "RRLS"
+
+    /// @brief Request from the coordinator to render one tile
+    struct job_message
+    {
+    public:
+        /// @brief Always job_magic, used to detect a desynchronised stream
+        uint32_t magic;
+        /// @brief Index of the tile in the coordinator's tile list
+        uint32_t tile_index;
+        /// @brief Region of the image to render
+        graphics::tile region;
+        /// @brief Number of progressive iterations to accumulate
+        uint32_t samples;
+        /// @brief Base seed of the render
+        uint64_t seed;
+    };
+
+    /// @brief Header of a rendered tile, followed by pixel_count math::color3 values in row order
+    struct result_message
+    {
+    public:
+        /// @brief Always result_magic, used to detect a desynchronised stream
+        uint32_t magic;
+        /// @brief Index of the tile this result belongs to
+        uint32_t tile_index;
+        /// @brief Number of pixels following the header
+        uint32_t pixel_count;
+    };
+
+    inline bool write_all(int fd, const void* data, size_t size)
+    {
+        auto bytes = static_cast<const char*>(data);
+
+        while (size > 0)
+        {
+            // MSG_NOSIGNAL turns a dead peer into an error instead of SIGPIPE.
+            ssize_t written = ::send(fd, bytes, size, MSG_NOSIGNAL);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written <= 0)
+                return false;
+
+            bytes += written;
+            size -= written;
+        }
+
+        return true;
+    }
+
+    inline bool read_all(int fd, void* data, size_t size)
+    {
+        auto bytes = static_cast<char*>(data);
+
+        while (size > 0)
+        {
+            ssize_t received = ::recv(fd, bytes, size, 0);
+            if (received < 0 && errno == EINTR)
+                continue;
+            if (received <= 0)
+                return false;
+
+            bytes += received;
+            size -= received;
+        }
+
+        return true;
+    }
+}
+
+#endif // DISTRIBUTED_PROTOCOL_HPP
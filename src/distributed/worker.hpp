@@ -0,0 +1,78 @@
+#ifndef DISTRIBUTED_WORKER_HPP
+#define DISTRIBUTED_WORKER_HPP
+
+#include "protocol.hpp"
+#include "../graphics/cpu_renderer.hpp"
+#include "../graphics/renderer_context.hpp"
+#include "../graphics/view_context.hpp"
+
+#include <vector>
+
+namespace jmrtiow::distributed
+{
+    /// @brief Serves tile jobs from the coordinator on fd until the coordinator hangs up.
+    /// @return Process exit code
+    inline int run_worker(int fd, const graphics::renderer_context& context, uint32_t image_width, uint32_t image_height)
+    {
+        graphics::cpu_renderer renderer {};
+
+        // The camera maps pixels through the full image size, so the worker renders into a band of full
+        // width rows holding the region and only sends back the region it was asked for.
+        std::vector<math::color3> band {};
+        math::color3* band_data = nullptr;
+
+        std::vector<math::color3> pixels {};
+        job_message job;
+
+        while (read_all(fd, &job, sizeof(job)))
+        {
+            if (job.magic != job_magic)
+                return 1;
+
+            const graphics::tile& region = job.region;
+            if (region.width == 0 || region.height == 0 || region.x + region.width > image_width || region.y + region.height > image_height)
+                return 1;
+
+            band.assign(static_cast<size_t>(image_width) * region.height, math::color3(0.0, 0.0, 0.0));
+            band_data = band.data();
+
+            graphics::view_context view {
+                .width = region.width,
+                .height = region.height,
+                .x = region.x,
+                .y = region.y,
+                .data = &band_data,
+                .data_width = image_width,
+                .data_height = image_height,
+                .data_y = region.y,
+                .seed = job.seed,
+                .iteration = 0,
+                .block = 1,
+                .epoch = context.control->epoch(),
+                .aovs = nullptr,
+            };
+
+            renderer.render_samples(context, view, job.samples);
+
+            pixels.clear();
+            for (uint32_t j = 0; j < region.height; j++)
+            {
+                const math::color3* row = band_data + static_cast<size_t>(j) * image_width + region.x;
+                pixels.insert(pixels.end(), row, row + region.width);
+            }
+
+            result_message result {
+                .magic = result_magic,
+                .tile_index = job.tile_index,
+                .pixel_count = static_cast<uint32_t>(pixels.size()),
+            };
+
+            if (!write_all(fd, &result, sizeof(result)) || !write_all(fd, pixels.data(), pixels.size() * sizeof(math::color3)))
+                return 1;
+        }
+
+        return 0;
+    }
+}
+
+#endif // DISTRIBUTED_WORKER_HPP
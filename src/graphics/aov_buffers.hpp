@@ -0,0 +1,89 @@
+#ifndef GRAPHICS_AOV_BUFFERS_HPP
+#define GRAPHICS_AOV_BUFFERS_HPP
+
+#include "../math/color3.hpp"
+#include "../math/vec3.hpp"
+#include "../scene/aov_sample.hpp"
+
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+namespace jmrtiow::graphics
+{
+    /// @brief Per-pixel sums of the first hit outputs and luminance moments of every sample, next to the image
+    struct aov_buffers
+    {
+    public:
+        aov_buffers(uint32_t width, uint32_t height);
+
+        /// @brief Adds a sample and its radiance to a pixel, replacing what it held if first is set
+        void add(size_t pixel, const scene::aov_sample& sample, const math::color3& radiance, bool first);
+
+        math::color3 mean_albedo(size_t pixel) const { return samples[pixel] > 0 ? albedo[pixel] / samples[pixel] : albedo[pixel]; }
+        math::vec3 mean_normal(size_t pixel) const { return samples[pixel] > 0 ? normal[pixel] / samples[pixel] : normal[pixel]; }
+        double mean_depth(size_t pixel) const { return samples[pixel] > 0 ? depth[pixel] / samples[pixel] : depth[pixel]; }
+
+        /// @brief Unbiased variance of the luminance of a pixel's samples, zero below two samples
+        double variance(size_t pixel) const;
+
+        /// @brief Sum of the albedo samples of each pixel
+        std::vector<math::color3> albedo;
+        /// @brief Sum of the normal samples of each pixel
+        std::vector<math::vec3> normal;
+        /// @brief Sum of the depth samples of each pixel
+        std::vector<double> depth;
+        /// @brief Sum of the linear luminance of each pixel's samples
+        std::vector<double> luminance;
+        /// @brief Sum of the squared linear luminance of each pixel's samples
+        std::vector<double> luminance_squared;
+        /// @brief Number of samples summed into each pixel
+        std::vector<uint32_t> samples;
+    };
+
+    inline aov_buffers::aov_buffers(uint32_t width, uint32_t height)
+    {
+        size_t pixel_count = static_cast<size_t>(width) * height;
+        albedo.assign(pixel_count, math::color3(0, 0, 0));
+        normal.assign(pixel_count, math::vec3(0, 0, 0));
+        depth.assign(pixel_count, 0.0);
+        luminance.assign(pixel_count, 0.0);
+        luminance_squared.assign(pixel_count, 0.0);
+        samples.assign(pixel_count, 0);
+    }
+
+    inline double aov_buffers::variance(size_t pixel) const
+    {
+        uint32_t n = samples[pixel];
+        if (n < 2)
+            return 0.0;
+
+        double mean = luminance[pixel] / n;
+        return std::max(0.0, (luminance_squared[pixel] - mean * luminance[pixel]) / (n - 1));
+    }
+
+    inline void aov_buffers::add(size_t pixel, const scene::aov_sample& sample, const math::color3& radiance, bool first)
+    {
+        double y = 0.2126 * radiance.r + 0.7152 * radiance.g + 0.0722 * radiance.b;
+
+        if (first)
+        {
+            albedo[pixel] = sample.albedo;
+            normal[pixel] = sample.normal;
+            depth[pixel] = sample.depth;
+            luminance[pixel] = y;
+            luminance_squared[pixel] = y * y;
+            samples[pixel] = 1;
+            return;
+        }
+
+        albedo[pixel] += sample.albedo;
+        normal[pixel] += sample.normal;
+        depth[pixel] += sample.depth;
+        luminance[pixel] += y;
+        luminance_squared[pixel] += y * y;
+        samples[pixel]++;
+    }
+}
+
+#endif // GRAPHICS_AOV_BUFFERS_HPP
@@ -0,0 +1,142 @@
+#ifndef GRAPHICS_BUCKET_RENDERER_HPP
+#define GRAPHICS_BUCKET_RENDERER_HPP
+
+#include "aov_buffers.hpp"
+#include "cpu_renderer.hpp"
+#include "renderer_context.hpp"
+#include "thread_pool.hpp"
+#include "tile.hpp"
+#include "view_context.hpp"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace jmrtiow::graphics
+{
+    /// @brief Renders the image one band of tile rows at a time, from the top of the image down,
+    /// taking every tile of a band to its full sample count before the next band starts. Only two
+    /// bands are held at once: the one being rendered and the finished one being handed on, so memory
+    /// depends on the band size and not on the image size. Every pixel sample is seeded as in
+    /// progressive_renderer, so the pixels are the same as those of a progressive render.
+    class bucket_renderer
+    {
+    public:
+        /// @brief Receives rows first_row to first_row + row_count of the image, bottom row first like the
+        /// image, with their first hit outputs if collected. Returning false stops the render.
+        using band_callback = std::function<bool(uint32_t first_row, uint32_t row_count, const math::color3* data, const aov_buffers* aovs)>;
+
+        bucket_renderer(cpu_renderer& renderer, const renderer_context& context, uint32_t data_width, uint32_t data_height, uint32_t tile_size, uint32_t band_tile_rows, uint64_t seed, bool collect_aovs);
+
+        /// @brief Renders every band with samples samples per pixel on the threads of pool. Each finished band
+        /// is handed to on_band on a separate thread while the next one renders.
+        /// @return False if on_band failed or the render control stopped the render
+        bool run(thread_pool& pool, uint32_t samples, band_callback on_band);
+
+    private:
+        struct band
+        {
+        public:
+            std::vector<math::color3> data;
+            std::unique_ptr<aov_buffers> aovs;
+        };
+
+        cpu_renderer& renderer;
+        const renderer_context& context;
+        uint32_t data_width;
+        uint32_t data_height;
+        uint32_t tile_size;
+        uint32_t band_tile_rows;
+        uint64_t seed;
+        band bands[2];
+    };
+
+    inline bucket_renderer::bucket_renderer(cpu_renderer& renderer, const renderer_context& context, uint32_t data_width, uint32_t data_height, uint32_t tile_size, uint32_t band_tile_rows, uint64_t seed, bool collect_aovs)
+        : renderer(renderer), context(context), data_width(data_width), data_height(data_height), tile_size(std::max<uint32_t>(tile_size, 1)), band_tile_rows(std::max<uint32_t>(band_tile_rows, 1)), seed(seed)
+    {
+        uint32_t band_height = std::min(this->tile_size * this->band_tile_rows, data_height);
+
+        for (auto& b : bands)
+        {
+            b.data.resize(static_cast<size_t>(data_width) * band_height);
+            if (collect_aovs)
+                b.aovs = std::make_unique<aov_buffers>(data_width, band_height);
+        }
+    }
+
+    inline bool bucket_renderer::run(thread_pool& pool, uint32_t samples, band_callback on_band)
+    {
+        render_control& control = *context.control;
+        uint64_t epoch = control.epoch();
+
+        uint32_t tile_rows = (data_height + tile_size - 1) / tile_size;
+        uint32_t tiles_per_row = (data_width + tile_size - 1) / tile_size;
+
+        std::thread band_writer {};
+        bool written = true;
+
+        // Files are written top down and the top of the image is its last row, so bands start at the last tile row.
+        for (uint32_t band_index = 0, end_row = tile_rows; end_row > 0 && !control.cancelled(epoch); band_index++)
+        {
+            uint32_t first_tile_row = end_row > band_tile_rows ? end_row - band_tile_rows : 0;
+            uint32_t first_row = first_tile_row * tile_size;
+            uint32_t row_count = std::min(end_row * tile_size, data_height) - first_row;
+            band& target = bands[band_index % 2];
+
+            // Tiles vary a lot in cost, threads take the next one as they finish instead of a fixed share.
+            std::atomic<size_t> next_tile = 0;
+            size_t tile_count = static_cast<size_t>(end_row - first_tile_row) * tiles_per_row;
+            math::color3* band_data = target.data.data();
+
+            pool.run_on_all([&](uint32_t)
+                {
+                    for (size_t i = next_tile++; i < tile_count && !control.cancelled(epoch); i = next_tile++)
+                    {
+                        uint32_t x = static_cast<uint32_t>(i % tiles_per_row) * tile_size;
+                        uint32_t y = first_row + static_cast<uint32_t>(i / tiles_per_row) * tile_size;
+
+                        view_context view {
+                            .width = std::min(tile_size, data_width - x),
+                            .height = std::min(tile_size, data_height - y),
+                            .x = x,
+                            .y = y,
+                            .data = &band_data,
+                            .data_width = data_width,
+                            .data_height = data_height,
+                            .data_y = first_row,
+                            .seed = seed,
+                            .iteration = 0,
+                            .block = 1,
+                            .epoch = epoch,
+                            .aovs = target.aovs.get(),
+                        };
+
+                        renderer.render_samples(context, view, samples);
+                    }
+                });
+
+            // The previous band must be written out before this one is handed on, and before its buffer is reused.
+            if (band_writer.joinable())
+                band_writer.join();
+
+            if (!written || control.cancelled(epoch))
+                break;
+
+            band_writer = std::thread([&on_band, &written, &target, first_row, row_count]()
+                {
+                    written = on_band(first_row, row_count, target.data.data(), target.aovs.get());
+                });
+
+            end_row = first_tile_row;
+        }
+
+        if (band_writer.joinable())
+            band_writer.join();
+
+        return written && !control.cancelled(epoch);
+    }
+}
+
+#endif // GRAPHICS_BUCKET_RENDERER_HPP
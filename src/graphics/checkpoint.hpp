@@ -0,0 +1,313 @@
+#ifndef GRAPHICS_CHECKPOINT_HPP
+#define GRAPHICS_CHECKPOINT_HPP
+
+#include <stdint.h>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "aov_buffers.hpp"
+#include "../math/color3.hpp"
+
+namespace jmrtiow::graphics
+{
+    constexpr uint32_t checkpoint_magic = 0x4b435452; // "RTCK"
+    constexpr uint32_t checkpoint_version = 6;
+
+    /// @brief Fixed size header of a checkpoint file, followed by width * height math::color3 values
+    /// and then, if aov_sums is set, the per-pixel sums of aov_buffers, member by member
+    struct checkpoint_header
+    {
+    public:
+        /// @brief Always checkpoint_magic
+        uint32_t magic;
+        /// @brief Always checkpoint_version
+        uint32_t version;
+        /// @brief Width of the image in pixels
+        uint32_t width;
+        /// @brief Height of the image in pixels
+        uint32_t height;
+        /// @brief Edge length of the tiles the render was split into
+        uint32_t tile_size;
+        /// @brief Completed passes, i.e. samples accumulated in every pixel
+        uint32_t passes;
+        /// @brief 1 if the AOV sums follow the image, 0 for renders that kept none. Set by checkpoint_writer::submit().
+        uint32_t aov_sums;
+        /// @brief Always 0, keeps the header free of padding
+        uint32_t reserved;
+        /// @brief Base seed of the render. Generators are reseeded from (seed, pixel, pass), so
+        /// together with passes this is the complete random state of the render.
+        uint64_t seed;
+        /// @brief settings_hash of the scene and camera, a checkpoint of another scene or view is not resumed
+        uint64_t settings;
+    };
+
+    /// @brief 64-bit FNV-1a hash of the settings that decide what a render converges to besides its
+    /// size and seed, i.e. its scene and camera
+    class settings_hash
+    {
+    public:
+        settings_hash& add(const void* data, size_t size);
+        settings_hash& add(const std::string& text) { return add(text.c_str(), text.size() + 1); }
+
+        template <typename T>
+            requires std::is_arithmetic_v<T> || std::is_enum_v<T>
+        settings_hash& add(T value)
+        {
+            return add(&value, sizeof(value));
+        }
+
+        uint64_t value() const { return hash; }
+
+    private:
+        uint64_t hash = 0xcbf29ce484222325ull;
+    };
+
+    inline settings_hash& settings_hash::add(const void* data, size_t size)
+    {
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ull;
+        }
+
+        return *this;
+    }
+
+    /// @brief Writes checkpoints on a background thread. Submitting only copies the image and its
+    /// AOV sums into back buffers, the previous checkpoint keeps being written from the front ones.
+    class checkpoint_writer
+    {
+    public:
+        checkpoint_writer(std::string filepath);
+        ~checkpoint_writer();
+
+        checkpoint_writer(const checkpoint_writer&) = delete;
+        checkpoint_writer& operator=(const checkpoint_writer&) = delete;
+
+        /// @brief Queues a snapshot of data and aovs, or of data alone if aovs is nullptr. A snapshot that
+        /// has not started writing yet is replaced.
+        void submit(const checkpoint_header& header, const math::color3* data, const aov_buffers* aovs);
+
+        /// @brief Blocks until every submitted snapshot is on disk.
+        void flush();
+
+    private:
+        void write_loop();
+        bool write_file(const checkpoint_header& header, const std::vector<math::color3>& data, const aov_buffers& aovs);
+
+        std::string filepath;
+
+        std::mutex mutex;
+        std::condition_variable condition;
+        checkpoint_header back_header;
+        std::vector<math::color3> back_buffer;
+        std::vector<math::color3> front_buffer;
+        aov_buffers back_aovs;
+        aov_buffers front_aovs;
+        bool pending;
+        bool writing;
+        bool stopping;
+
+        std::thread writer_thread;
+    };
+
+    inline checkpoint_writer::checkpoint_writer(std::string filepath)
+        : filepath(std::move(filepath)), back_header {}, back_aovs(0, 0), front_aovs(0, 0), pending(false), writing(false), stopping(false)
+    {
+        writer_thread = std::thread(&checkpoint_writer::write_loop, this);
+    }
+
+    inline checkpoint_writer::~checkpoint_writer()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+
+        condition.notify_all();
+        writer_thread.join();
+    }
+
+    inline void checkpoint_writer::submit(const checkpoint_header& header, const math::color3* data, const aov_buffers* aovs)
+    {
+        size_t count = static_cast<size_t>(header.width) * header.height;
+
+        {
+            std::lock_guard lock(mutex);
+            back_header = header;
+            back_header.aov_sums = aovs != nullptr;
+            back_buffer.resize(count);
+            std::memcpy(back_buffer.data(), data, count * sizeof(math::color3));
+            if (aovs != nullptr)
+                back_aovs = *aovs;
+            pending = true;
+        }
+
+        condition.notify_all();
+    }
+
+    inline void checkpoint_writer::flush()
+    {
+        std::unique_lock lock(mutex);
+        condition.wait(lock, [this]() { return !pending && !writing; });
+    }
+
+    inline void checkpoint_writer::write_loop()
+    {
+        std::unique_lock lock(mutex);
+
+        while (true)
+        {
+            condition.wait(lock, [this]() { return pending || stopping; });
+
+            // Pending snapshots are still written on shutdown.
+            if (!pending)
+                break;
+
+            checkpoint_header header = back_header;
+            std::swap(back_buffer, front_buffer);
+            std::swap(back_aovs, front_aovs);
+            pending = false;
+            writing = true;
+
+            lock.unlock();
+            if (!write_file(header, front_buffer, front_aovs))
+                std::cerr << "Could not write checkpoint " << filepath << '\n';
+            lock.lock();
+
+            writing = false;
+            condition.notify_all();
+        }
+    }
+
+    inline bool checkpoint_writer::write_file(const checkpoint_header& header, const std::vector<math::color3>& data, const aov_buffers& aovs)
+    {
+        // Write next to the checkpoint and rename over it, so a crash mid-write keeps the last good one.
+        // The new file is synced before the rename and the directory after it, or else a crash could
+        // leave the rename on disk ahead of the data it points to.
+        std::string temporary_path = filepath + ".tmp";
+
+        int fd = open(temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return false;
+
+        auto write_bytes = [fd](const void* bytes, size_t size)
+            {
+                const char* next = static_cast<const char*>(bytes);
+                while (size > 0)
+                {
+                    ssize_t written = write(fd, next, size);
+                    if (written < 0 && errno == EINTR)
+                        continue;
+                    if (written <= 0)
+                        return false;
+
+                    next += written;
+                    size -= written;
+                }
+
+                return true;
+            };
+
+        auto write_values = [&write_bytes](const auto& values) { return write_bytes(values.data(), values.size() * sizeof(values[0])); };
+
+        bool written = write_bytes(&header, sizeof(header)) && write_values(data)
+            && (header.aov_sums == 0
+                || (write_values(aovs.albedo) && write_values(aovs.normal) && write_values(aovs.depth) && write_values(aovs.luminance)
+                    && write_values(aovs.luminance_squared) && write_values(aovs.samples)))
+            && fsync(fd) == 0;
+        if (close(fd) != 0 || !written)
+            return false;
+
+        std::error_code error;
+        std::filesystem::rename(temporary_path, filepath, error);
+        if (error)
+            return false;
+
+        std::filesystem::path directory = std::filesystem::path(filepath).parent_path();
+        int directory_fd = open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (directory_fd >= 0)
+        {
+            fsync(directory_fd);
+            close(directory_fd);
+        }
+
+        return true;
+    }
+
+    /// @brief Reads a checkpoint of a width by height image written by checkpoint_writer, and its AOV sums
+    /// into aovs if it has them and aovs, sized for the image, is not nullptr. Nothing is allocated
+    /// before the header matches the image and the size of the file.
+    /// @return False if the file is missing, truncated, not a checkpoint or of another image size
+    inline bool read_checkpoint(const std::string& filepath, uint32_t width, uint32_t height, checkpoint_header& header, std::vector<math::color3>& data,
+        aov_buffers* aovs)
+    {
+        std::ifstream file_stream(filepath, std::ios::binary);
+        if (!file_stream.is_open())
+        {
+            std::cerr << "Could not read checkpoint " << filepath << '\n';
+            return false;
+        }
+
+        file_stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+        if (!file_stream.good() || header.magic != checkpoint_magic || header.version != checkpoint_version)
+        {
+            std::cerr << "Could not read checkpoint " << filepath << '\n';
+            return false;
+        }
+
+        if (header.width != width || header.height != height)
+        {
+            std::cerr << "Checkpoint " << filepath << " is " << header.width << "x" << header.height
+                      << ", the image is " << width << "x" << height << '\n';
+            return false;
+        }
+
+        // The image and every AOV sum, per pixel.
+        constexpr uintmax_t aov_bytes = sizeof(math::color3) + sizeof(math::vec3) + 3 * sizeof(double) + sizeof(uint32_t);
+        uintmax_t pixel_bytes = sizeof(math::color3) + (header.aov_sums != 0 ? aov_bytes : 0);
+        std::error_code error;
+        uintmax_t file_size = std::filesystem::file_size(filepath, error);
+        if (error || file_size != sizeof(header) + static_cast<uintmax_t>(width) * height * pixel_bytes)
+        {
+            std::cerr << "Checkpoint " << filepath << " is truncated or holds more than the image\n";
+            return false;
+        }
+
+        data.resize(static_cast<size_t>(header.width) * header.height);
+
+        auto read_values = [&file_stream](auto& values) { file_stream.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(values[0])); };
+        read_values(data);
+        if (header.aov_sums != 0 && aovs != nullptr)
+        {
+            read_values(aovs->albedo);
+            read_values(aovs->normal);
+            read_values(aovs->depth);
+            read_values(aovs->luminance);
+            read_values(aovs->luminance_squared);
+            read_values(aovs->samples);
+        }
+        if (!file_stream.good())
+        {
+            std::cerr << "Could not read checkpoint " << filepath << '\n';
+            return false;
+        }
+
+        return true;
+    }
+}
+
+#endif // GRAPHICS_CHECKPOINT_HPP
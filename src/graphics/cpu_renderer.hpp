@@ -1,11 +1,18 @@
 #ifndef GRAPHICS_CPU_RENDERER_HPP
 #define GRAPHICS_CPU_RENDERER_HPP
 
+#include "isa.hpp"
+#include "render_kernel.hpp"
 #include "renderer_context.hpp"
 #include "view_context.hpp"
+#include "tile.hpp"
+#include "../math/simd.hpp"
 #include "../math/vec3.hpp"
 #include "../scene/hittable_list.hpp"
 #include "../rtweekend.hpp"
+#include "../stats/render_stats.hpp"
+
+#include <chrono>
 
 namespace jmrtiow::graphics
 {
@@ -13,39 +20,86 @@ namespace jmrtiow::graphics
     {
     public:
         void render(const renderer_context& context, const view_context& view);
+        void render_samples(const renderer_context& context, view_context& view, uint32_t samples);
+
+    private:
+        /// @brief Renders the view with the kernels of the target tag Target
+        template <typename Target>
+        static void select_kernel(const renderer_context& context, const view_context& view);
+
+        template <typename Target, typename Integrator>
+        static void render_with(const renderer_context& context, const view_context& view, const Integrator& integrator);
     };
 
-    void cpu_renderer::render(const renderer_context& context, const view_context& view)
+    inline void cpu_renderer::render(const renderer_context& context, const view_context& view)
+    {
+        switch (context.isa)
+        {
+#if defined(JMRTIOW_ISA_DISPATCH)
+        case isa_level::sse42:
+            select_kernel<math::simd::sse42_target>(context, view);
+            return;
+        case isa_level::avx2:
+            select_kernel<math::simd::avx2_target>(context, view);
+            return;
+        case isa_level::avx512:
+            select_kernel<math::simd::avx512_target>(context, view);
+            return;
+#endif
+        default:
+            select_kernel<math::simd::baseline_target>(context, view);
+            return;
+        }
+    }
+
+    template <typename Target>
+    void cpu_renderer::select_kernel(const renderer_context& context, const view_context& view)
+    {
+        // Runtime settings pick one of the kernels instantiated here, nothing is decided per pixel.
+        if (context.spheres != nullptr)
+            render_with<Target>(context, view, sphere_scene_integrator { .world = *context.spheres, .background = context.background });
+        else
+            render_with<Target>(context, view, hittable_integrator { .world = *context.scene, .lights = context.lights, .background = context.background });
+    }
+
+    template <typename Target, typename Integrator>
+    void cpu_renderer::render_with(const renderer_context& context, const view_context& view, const Integrator& integrator)
+    {
+        // The kernel runs through Target::run() so it, and the vector math inlined into it, is compiled
+        // for the target.
+        if (context.blend_callback)
+        {
+            callback_blend blend { .context = context };
+            if (view.block > 1)
+                Target::run([&]() { render_kernel<Target, true>(context, view, integrator, blend); });
+            else
+                Target::run([&]() { render_kernel<Target, false>(context, view, integrator, blend); });
+        }
+        else
+        {
+            running_mean_blend blend {};
+            if (view.block > 1)
+                Target::run([&]() { render_kernel<Target, true>(context, view, integrator, blend); });
+            else
+                Target::run([&]() { render_kernel<Target, false>(context, view, integrator, blend); });
+        }
+    }
+
+    inline void cpu_renderer::render_samples(const renderer_context& context, view_context& view, uint32_t samples)
     {
-        for (int j = view.y; j < view.y + view.height; j++)
+        for (uint32_t sample = 0; sample < samples && !context.control->cancelled(view.epoch); sample++)
         {
-            for (int i = view.x; i < view.x + view.width; i++)
-            {
-                math::color3 pixel_color(0, 0, 0);
-                auto u = (i + random_double()) / (view.data_width - 1);
-                auto v = (j + random_double()) / (view.data_height - 1);
-                math::ray r = context.camera->get_ray(u, v);
-                pixel_color += jmrtiow::scene::ray_color(r, (*context.scene), context.max_depth);
-
-                // For better readability.
-                auto& image_data_element = (*view.data)[j * view.data_width + i];
-
-                // Pixel data is normalized, be sure to un-normalize it before averaging.
-                image_data_element = image_data_element * image_data_element;
-
-                // Blend color with source.
-                image_data_element = context.blend_callback(image_data_element, pixel_color, view.iteration);
-
-                // Normalize the color samples and gamma correct before passing off to pixel data.
-                image_data_element.r = sqrt(image_data_element.r);
-                image_data_element.g = sqrt(image_data_element.g);
-                image_data_element.b = sqrt(image_data_element.b);
-            }
-
-            if (*context.pause)
-            {
-                break;
-            }
+            auto start = std::chrono::steady_clock::now();
+            render(context, view);
+            uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+            stats::counters& counters = stats::local();
+            counters.tiles++;
+            counters.tile_nanoseconds += elapsed;
+            counters.max_tile_nanoseconds = std::max(counters.max_tile_nanoseconds, elapsed);
+            stats::registry::global().publish();
+
+            view.iteration++;
         }
     }
 }
@@ -0,0 +1,246 @@
+#ifndef GRAPHICS_DENOISER_HPP
+#define GRAPHICS_DENOISER_HPP
+
+#include "aov_buffers.hpp"
+#include "thread_pool.hpp"
+#include "../math/color3.hpp"
+#include "../math/vec3.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <stdint.h>
+#include <vector>
+
+namespace jmrtiow::graphics
+{
+    /// @brief Edge-avoiding a-trous wavelet filter. Every iteration blurs with a 5x5 B3 spline
+    /// kernel whose taps are twice as far apart as in the previous one, and weights each tap
+    /// down by how much its color, normal and depth differ from the center pixel's. Colors are
+    /// divided by the albedo before filtering and multiplied back after, so textures stay sharp.
+    class denoiser
+    {
+    public:
+        struct settings
+        {
+        public:
+            /// @brief Number of filter iterations, the last one reaching 2 << iterations pixels away
+            uint32_t iterations;
+            /// @brief Color difference that weighs a tap down by 1/e in the first iteration, halved every iteration after
+            float color_sigma;
+            /// @brief Normal difference that weighs a tap down by 1/e
+            float normal_sigma;
+            /// @brief Depth difference, relative to the center depth, that weighs a tap down by 1/e
+            float depth_sigma;
+        };
+
+        static constexpr settings default_settings { .iterations = 5, .color_sigma = 1.0f, .normal_sigma = 0.3f, .depth_sigma = 0.05f };
+
+        denoiser(uint32_t width, uint32_t height, settings options = default_settings);
+
+        /// @brief Filters input into output, both gamma encoded like the framebuffer. They may be the same buffer.
+        void denoise(thread_pool& pool, const math::color3* input, const aov_buffers& aovs, math::color3* output);
+
+    private:
+        /// @brief e^-x for 0 <= x within 3e-5 relative error, x is clamped to 80. Unlike std::exp it
+        /// inlines into the tap loops, which then vectorize.
+        static float exp_negative(float x);
+
+        void filter_rows(uint32_t first_row, uint32_t last_row, uint32_t step, float inv_color_variance, const float* const source[3], float* const target[3]);
+
+        uint32_t width;
+        uint32_t height;
+        settings options;
+
+        // Planar buffers, so the filter's inner loops run over contiguous floats and vectorize.
+        std::vector<float> color[2][3];
+        std::vector<float> albedo[3];
+        std::vector<float> normal[3];
+        std::vector<float> depth;
+    };
+
+    inline denoiser::denoiser(uint32_t width, uint32_t height, settings options)
+        : width(width), height(height), options(options)
+    {
+        size_t pixel_count = static_cast<size_t>(width) * height;
+
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            color[0][c].resize(pixel_count);
+            color[1][c].resize(pixel_count);
+            albedo[c].resize(pixel_count);
+            normal[c].resize(pixel_count);
+        }
+        depth.resize(pixel_count);
+    }
+
+    inline void denoiser::denoise(thread_pool& pool, const math::color3* input, const aov_buffers& aovs, math::color3* output)
+    {
+        const float albedo_epsilon = 1e-3f;
+
+        pool.parallel_for(height, [&](size_t row)
+            {
+                for (size_t i = row * width; i < (row + 1) * width; i++)
+                {
+                    math::color3 a = aovs.mean_albedo(i);
+                    math::vec3 n = aovs.mean_normal(i);
+
+                    // The framebuffer is gamma encoded, the filter works on linear irradiance.
+                    albedo[0][i] = static_cast<float>(a.r) + albedo_epsilon;
+                    albedo[1][i] = static_cast<float>(a.g) + albedo_epsilon;
+                    albedo[2][i] = static_cast<float>(a.b) + albedo_epsilon;
+                    color[0][0][i] = static_cast<float>(input[i].r * input[i].r) / albedo[0][i];
+                    color[0][1][i] = static_cast<float>(input[i].g * input[i].g) / albedo[1][i];
+                    color[0][2][i] = static_cast<float>(input[i].b * input[i].b) / albedo[2][i];
+                    normal[0][i] = static_cast<float>(n.x);
+                    normal[1][i] = static_cast<float>(n.y);
+                    normal[2][i] = static_cast<float>(n.z);
+                    depth[i] = static_cast<float>(aovs.mean_depth(i));
+                }
+            });
+
+        uint32_t source = 0;
+        float color_sigma = options.color_sigma;
+
+        for (uint32_t iteration = 0; iteration < options.iterations; iteration++)
+        {
+            const float* const source_planes[3] = { color[source][0].data(), color[source][1].data(), color[source][2].data() };
+            float* const target_planes[3] = { color[1 - source][0].data(), color[1 - source][1].data(), color[1 - source][2].data() };
+            float inv_color_variance = 1.0f / (color_sigma * color_sigma);
+
+            pool.run_on_all([&](uint32_t index)
+                {
+                    uint32_t first_row = static_cast<uint64_t>(height) * index / pool.size();
+                    uint32_t last_row = static_cast<uint64_t>(height) * (index + 1) / pool.size();
+                    filter_rows(first_row, last_row, 1u << iteration, inv_color_variance, source_planes, target_planes);
+                });
+
+            source = 1 - source;
+            color_sigma *= 0.5f;
+        }
+
+        pool.parallel_for(height, [&](size_t row)
+            {
+                for (size_t i = row * width; i < (row + 1) * width; i++)
+                {
+                    output[i].r = std::sqrt(std::max(0.0f, color[source][0][i] * albedo[0][i]));
+                    output[i].g = std::sqrt(std::max(0.0f, color[source][1][i] * albedo[1][i]));
+                    output[i].b = std::sqrt(std::max(0.0f, color[source][2][i] * albedo[2][i]));
+                }
+            });
+    }
+
+    inline float denoiser::exp_negative(float x)
+    {
+        // e^-x = 2^t with t = -x log2(e) = n + f, n rounded toward zero and f in (-1, 0]. x is clamped
+        // on its bits, which order like the values for positive floats: a float comparison may trap,
+        // so the compiler would keep it as a branch and not vectorize the loop around it.
+        float t = std::bit_cast<float>(std::min(std::bit_cast<int32_t>(x), std::bit_cast<int32_t>(80.0f))) * -1.44269504f;
+        int32_t n = static_cast<int32_t>(t);
+        float f = t - static_cast<float>(n);
+
+        // Taylor series of 2^f = e^(f ln 2) to the sixth power.
+        float p = 1.54035304e-4f;
+        p = p * f + 1.33335581e-3f;
+        p = p * f + 9.61812911e-3f;
+        p = p * f + 5.55041087e-2f;
+        p = p * f + 2.40226507e-1f;
+        p = p * f + 6.93147181e-1f;
+        p = p * f + 1.0f;
+
+        // p is in (0.5, 1], scaling by 2^n is adding n to its exponent.
+        return std::bit_cast<float>(std::bit_cast<int32_t>(p) + n * (1 << 23));
+    }
+
+    inline void denoiser::filter_rows(uint32_t first_row, uint32_t last_row, uint32_t step, float inv_color_variance, const float* const source[3], float* const target[3])
+    {
+        static constexpr float kernel[5] = { 1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16 };
+
+        // Rows are filtered in spans, whose sums are local arrays: the compiler knows nothing else
+        // points into them, so the tap loop needs no alias checks against the guide planes.
+        constexpr uint32_t span_width = 256;
+
+        const float inv_normal_variance = 1.0f / (options.normal_sigma * options.normal_sigma);
+        const float inv_depth_sigma = 1.0f / options.depth_sigma;
+
+        for (uint32_t y = first_row; y < last_row; y++)
+        {
+            const size_t row = static_cast<size_t>(y) * width;
+            const float* center_r = source[0] + row;
+            const float* center_g = source[1] + row;
+            const float* center_b = source[2] + row;
+            const float* center_nx = normal[0].data() + row;
+            const float* center_ny = normal[1].data() + row;
+            const float* center_nz = normal[2].data() + row;
+            const float* center_depth = depth.data() + row;
+
+            for (uint32_t span_x = 0; span_x < width; span_x += span_width)
+            {
+                const uint32_t span_end = std::min(span_x + span_width, width);
+
+                float sum[3][span_width] = {};
+                float weight_sum[span_width] = {};
+
+                for (int ky = -2; ky <= 2; ky++)
+                {
+                    int64_t tap_y = static_cast<int64_t>(y) + ky * static_cast<int64_t>(step);
+                    if (tap_y < 0 || tap_y >= height)
+                        continue;
+
+                    for (int kx = -2; kx <= 2; kx++)
+                    {
+                        // Taps that would leave the image are skipped, which keeps the loop below branch free.
+                        int64_t offset = kx * static_cast<int64_t>(step);
+                        uint32_t first_x = static_cast<uint32_t>(std::clamp<int64_t>(-offset, span_x, span_end));
+                        uint32_t last_x = static_cast<uint32_t>(std::clamp<int64_t>(width - offset, span_x, span_end));
+
+                        const float h = kernel[ky + 2] * kernel[kx + 2];
+                        const size_t tap_row = static_cast<size_t>(tap_y) * width;
+                        const float* tap_r = source[0] + tap_row;
+                        const float* tap_g = source[1] + tap_row;
+                        const float* tap_b = source[2] + tap_row;
+                        const float* tap_nx = normal[0].data() + tap_row;
+                        const float* tap_ny = normal[1].data() + tap_row;
+                        const float* tap_nz = normal[2].data() + tap_row;
+                        const float* tap_depth = depth.data() + tap_row;
+
+                        // Signed indices cannot wrap, so the compiler sees every access step by one element.
+                        for (int64_t x = first_x; x < last_x; x++)
+                        {
+                            const int64_t t = x + offset;
+                            const int64_t i = x - span_x;
+                            float dr = center_r[x] - tap_r[t];
+                            float dg = center_g[x] - tap_g[t];
+                            float db = center_b[x] - tap_b[t];
+                            float dnx = center_nx[x] - tap_nx[t];
+                            float dny = center_ny[x] - tap_ny[t];
+                            float dnz = center_nz[x] - tap_nz[t];
+                            float dz = (center_depth[x] - tap_depth[t]) * inv_depth_sigma / (center_depth[x] + 1e-3f);
+
+                            float exponent = (dr * dr + dg * dg + db * db) * inv_color_variance
+                                + (dnx * dnx + dny * dny + dnz * dnz) * inv_normal_variance
+                                + dz * dz;
+                            float w = h * exp_negative(exponent);
+
+                            sum[0][i] += w * tap_r[t];
+                            sum[1][i] += w * tap_g[t];
+                            sum[2][i] += w * tap_b[t];
+                            weight_sum[i] += w;
+                        }
+                    }
+                }
+
+                // The center tap always has weight, so the sum is never zero.
+                for (uint32_t x = span_x; x < span_end; x++)
+                {
+                    const uint32_t i = x - span_x;
+                    target[0][row + x] = sum[0][i] / weight_sum[i];
+                    target[1][row + x] = sum[1][i] / weight_sum[i];
+                    target[2][row + x] = sum[2][i] / weight_sum[i];
+                }
+            }
+        }
+    }
+}
+
+#endif // GRAPHICS_DENOISER_HPP
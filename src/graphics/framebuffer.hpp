@@ -0,0 +1,271 @@
+#ifndef GRAPHICS_FRAMEBUFFER_HPP
+#define GRAPHICS_FRAMEBUFFER_HPP
+
+#include "thread_pool.hpp"
+#include "tile.hpp"
+#include "../math/color3.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <new>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace jmrtiow::graphics
+{
+    constexpr uint32_t framebuffer_magic = 0x42465452; // "RTFB"
+    constexpr uint32_t framebuffer_version = 3;
+
+    /// @brief Set in a tile's sample count while a sample is being added to it. A tile left with it
+    /// set was interrupted part way and holds no consistent number of samples.
+    constexpr uint32_t tile_passes_dirty = 0x80000000;
+
+    /// @brief Start of a framebuffer, followed by the sample count of every tile and then the pixels.
+    /// A mapped framebuffer file holds exactly this layout, so other processes can watch a render.
+    struct framebuffer_header
+    {
+    public:
+        /// @brief Always framebuffer_magic
+        uint32_t magic;
+        /// @brief Always framebuffer_version
+        uint32_t version;
+        /// @brief Width of the image in pixels
+        uint32_t width;
+        /// @brief Height of the image in pixels
+        uint32_t height;
+        /// @brief Edge length of the tiles, tiles are numbered row by row from the bottom left
+        uint32_t tile_size;
+        /// @brief Number of tiles, and of entries in the sample count table
+        uint32_t tile_count;
+        /// @brief Base seed of the render, see pixel_seed()
+        uint64_t seed;
+        /// @brief Completed passes: every tile holds at least this many samples per pixel
+        std::atomic<uint32_t> passes;
+        uint32_t reserved;
+        /// @brief Offset from the start of the header of the uint32_t sample count of every tile
+        uint64_t tile_passes_offset;
+        /// @brief Offset from the start of the header of width * height math::color3 pixels, bottom row
+        /// first and gamma corrected like the preview
+        uint64_t pixels_offset;
+    };
+
+    /// @brief Image pixels and per-tile sample counts of progressive renders, in anonymous memory or
+    /// in a file mapped shared, so a render can be read while it runs and continued after a restart.
+    /// The kernel places a page on the NUMA node of the thread that first touches it, so each pool
+    /// thread clears the band of rows whose tiles it renders first, see tile_range().
+    class framebuffer
+    {
+    public:
+        /// @brief Creates a framebuffer, in filepath if it is not empty. With resume set, an existing
+        /// file of the same image size keeps its pixels, seed, tile size and sample counts instead.
+        /// Failures are reported on std::cerr and leave is_open() false.
+        framebuffer(thread_pool& pool, uint32_t width, uint32_t height, uint32_t tile_size, uint64_t seed, const std::string& filepath = {}, bool resume = false);
+        ~framebuffer();
+
+        framebuffer(const framebuffer&) = delete;
+        framebuffer& operator=(const framebuffer&) = delete;
+
+        bool is_open() const { return header != nullptr; }
+
+        uint32_t width() const { return header->width; }
+        uint32_t height() const { return header->height; }
+        uint32_t tile_size() const { return header->tile_size; }
+        uint64_t seed() const { return header->seed; }
+
+        /// @brief Completed passes, kept in the header for other readers of the mapping
+        std::atomic<uint32_t>& passes() { return header->passes; }
+
+        /// @brief Sample count of every tile of make_tiles(width(), height(), tile_size())
+        uint32_t* tile_passes() { return reinterpret_cast<uint32_t*>(mapping + header->tile_passes_offset); }
+
+        /// @brief Marks every tile and the whole image as holding passes samples, e.g. after a checkpoint was copied in
+        void set_passes(uint32_t passes);
+
+        math::color3* data() { return pixels; }
+
+        /// @brief Address of the pixel pointer, as renderers take it
+        math::color3** data_reference() { return &pixels; }
+
+    private:
+        bool create(const std::string& filepath, uint32_t width, uint32_t height, uint32_t tile_size, uint64_t seed);
+        bool reopen(const std::string& filepath, uint32_t width, uint32_t height);
+        void clear_rows(thread_pool& pool);
+
+        char* mapping = nullptr;
+        size_t bytes = 0;
+        framebuffer_header* header = nullptr;
+        math::color3* pixels = nullptr;
+    };
+
+    inline framebuffer::framebuffer(thread_pool& pool, uint32_t width, uint32_t height, uint32_t tile_size, uint64_t seed, const std::string& filepath, bool resume)
+    {
+        tile_size = std::max<uint32_t>(tile_size, 1);
+
+        if (resume && !filepath.empty())
+        {
+            if (reopen(filepath, width, height))
+                std::cerr << "Resuming from " << filepath << " at " << header->passes << " samples per pixel\n";
+            return;
+        }
+
+        if (create(filepath, width, height, tile_size, seed))
+            clear_rows(pool);
+    }
+
+    inline framebuffer::~framebuffer()
+    {
+        if (mapping != nullptr)
+            munmap(mapping, bytes);
+    }
+
+    inline bool framebuffer::create(const std::string& filepath, uint32_t width, uint32_t height, uint32_t tile_size, uint64_t seed)
+    {
+        uint32_t tile_count = ((width + tile_size - 1) / tile_size) * ((height + tile_size - 1) / tile_size);
+
+        // The pixels start on a page of their own, so the header and counts never share one with them.
+        uint64_t tile_passes_offset = (sizeof(framebuffer_header) + 63) & ~uint64_t { 63 };
+        uint64_t pixels_offset = (tile_passes_offset + tile_count * sizeof(uint32_t) + 4095) & ~uint64_t { 4095 };
+        bytes = pixels_offset + static_cast<size_t>(width) * height * sizeof(math::color3);
+
+        void* memory;
+        if (filepath.empty())
+        {
+            // Anonymous pages are not backed by memory until written.
+            memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED)
+                throw std::bad_alloc();
+        }
+        else
+        {
+            int fd = open(filepath.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (fd < 0 || ftruncate(fd, bytes) != 0)
+            {
+                std::cerr << "Could not create framebuffer " << filepath << '\n';
+                if (fd >= 0)
+                    close(fd);
+                return false;
+            }
+
+            // The mapping keeps the file open.
+            memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            close(fd);
+            if (memory == MAP_FAILED)
+            {
+                std::cerr << "Could not map framebuffer " << filepath << '\n';
+                return false;
+            }
+        }
+
+        mapping = static_cast<char*>(memory);
+        header = new (mapping) framebuffer_header {
+            .magic = framebuffer_magic,
+            .version = framebuffer_version,
+            .width = width,
+            .height = height,
+            .tile_size = tile_size,
+            .tile_count = tile_count,
+            .seed = seed,
+            .passes = 0,
+            .reserved = 0,
+            .tile_passes_offset = tile_passes_offset,
+            .pixels_offset = pixels_offset,
+        };
+        pixels = reinterpret_cast<math::color3*>(mapping + pixels_offset);
+        std::fill(tile_passes(), tile_passes() + tile_count, 0);
+
+        return true;
+    }
+
+    inline bool framebuffer::reopen(const std::string& filepath, uint32_t width, uint32_t height)
+    {
+        int fd = open(filepath.c_str(), O_RDWR | O_CLOEXEC);
+        struct stat file_stat;
+        if (fd < 0 || fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(framebuffer_header))
+        {
+            std::cerr << "Could not read framebuffer " << filepath << '\n';
+            if (fd >= 0)
+                close(fd);
+            return false;
+        }
+
+        bytes = file_stat.st_size;
+        void* memory = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED)
+        {
+            std::cerr << "Could not map framebuffer " << filepath << '\n';
+            return false;
+        }
+
+        mapping = static_cast<char*>(memory);
+        auto* existing = reinterpret_cast<framebuffer_header*>(mapping);
+
+        bool valid = existing->magic == framebuffer_magic && existing->version == framebuffer_version
+            && existing->tile_size > 0
+            && existing->tile_count == ((static_cast<uint64_t>(existing->width) + existing->tile_size - 1) / existing->tile_size)
+                    * ((static_cast<uint64_t>(existing->height) + existing->tile_size - 1) / existing->tile_size)
+            && existing->tile_passes_offset + existing->tile_count * sizeof(uint32_t) <= existing->pixels_offset
+            && existing->pixels_offset + static_cast<uint64_t>(existing->width) * existing->height * sizeof(math::color3) == bytes;
+
+        if (!valid || existing->width != width || existing->height != height)
+        {
+            if (valid)
+                std::cerr << "Framebuffer " << filepath << " is " << existing->width << "x" << existing->height
+                          << ", the image is " << width << "x" << height << '\n';
+            else
+                std::cerr << "Framebuffer " << filepath << " is not a framebuffer file\n";
+
+            munmap(mapping, bytes);
+            mapping = nullptr;
+            return false;
+        }
+
+        header = existing;
+        pixels = reinterpret_cast<math::color3*>(mapping + header->pixels_offset);
+
+        // A tile interrupted mid-sample holds rows at different counts, it starts over. Its first
+        // sample overwrites whatever it held.
+        uint32_t* counts = tile_passes();
+        uint32_t passes = UINT32_MAX;
+        for (uint32_t i = 0; i < header->tile_count; i++)
+        {
+            if (counts[i] & tile_passes_dirty)
+                counts[i] = 0;
+            passes = std::min(passes, counts[i]);
+        }
+        header->passes = header->tile_count > 0 ? passes : 0;
+
+        return true;
+    }
+
+    inline void framebuffer::set_passes(uint32_t passes)
+    {
+        std::fill(tile_passes(), tile_passes() + header->tile_count, passes);
+        header->passes = passes;
+    }
+
+    inline void framebuffer::clear_rows(thread_pool& pool)
+    {
+        uint32_t width = header->width;
+        uint32_t height = header->height;
+
+        pool.run_on_all([this, width, height, &pool](uint32_t index)
+            {
+                // Tiles are numbered row by row, so a thread's range of tiles is a band of rows.
+                size_t first_row = static_cast<size_t>(height) * index / pool.size();
+                size_t last_row = static_cast<size_t>(height) * (index + 1) / pool.size();
+
+                for (size_t i = first_row * width; i < last_row * width; i++)
+                {
+                    pixels[i] = { 0.0, 0.0, 0.0 };
+                }
+            });
+    }
+}
+
+#endif // GRAPHICS_FRAMEBUFFER_HPP
@@ -0,0 +1,106 @@
+#ifndef GRAPHICS_ISA_HPP
+#define GRAPHICS_ISA_HPP
+
+#include "../math/simd.hpp"
+
+#include <stdint.h>
+#include <string>
+
+// The render kernels get a version per target tag of math/simd.hpp where JMRTIOW_ISA_DISPATCH is
+// defined, and GCC and Clang tell at run time what the CPU supports. Other compilers and architectures
+// only have the baseline kernels.
+
+namespace jmrtiow::graphics
+{
+    /// @brief Instruction sets the render kernels are compiled for, from oldest to newest
+    enum class isa_level : uint8_t
+    {
+        /// @brief Whatever the whole program is compiled for
+        baseline,
+        sse42,
+        /// @brief AVX2 without FMA
+        avx2,
+        /// @brief AVX-512 F, VL, DQ and BW
+        avx512,
+    };
+
+    const char* isa_name(isa_level level);
+
+    /// @brief Reads an isa_name()
+    bool parse_isa(const std::string& name, isa_level& level);
+
+    /// @brief Whether this CPU and operating system can run the kernels of level
+    bool isa_supported(isa_level level);
+
+    /// @brief Newest instruction set with kernels that this CPU can run
+    isa_level detect_isa();
+
+    inline const char* isa_name(isa_level level)
+    {
+        switch (level)
+        {
+        case isa_level::baseline:
+            return "baseline";
+        case isa_level::sse42:
+            return "sse4.2";
+        case isa_level::avx2:
+            return "avx2";
+        case isa_level::avx512:
+            return "avx512";
+        }
+
+        return "unknown";
+    }
+
+    inline bool parse_isa(const std::string& name, isa_level& level)
+    {
+        for (isa_level candidate : { isa_level::baseline, isa_level::sse42, isa_level::avx2, isa_level::avx512 })
+        {
+            if (name == isa_name(candidate))
+            {
+                level = candidate;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    inline bool isa_supported(isa_level level)
+    {
+#if defined(JMRTIOW_ISA_DISPATCH)
+        // The builtins also check that the OS saves the wider registers.
+        __builtin_cpu_init();
+
+        switch (level)
+        {
+        case isa_level::baseline:
+            return true;
+        case isa_level::sse42:
+            return __builtin_cpu_supports("sse4.2");
+        case isa_level::avx2:
+            return __builtin_cpu_supports("avx2");
+        case isa_level::avx512:
+            return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq")
+                && __builtin_cpu_supports("avx512bw");
+        }
+
+        return false;
+#else
+        return level == isa_level::baseline;
+#endif
+    }
+
+    inline isa_level detect_isa()
+    {
+        for (isa_level level : { isa_level::avx512, isa_level::avx2, isa_level::sse42 })
+        {
+            if (isa_supported(level))
+                return level;
+        }
+
+        return isa_level::baseline;
+    }
+}
+
+#endif // GRAPHICS_ISA_HPP
@@ -0,0 +1,258 @@
+#ifndef GRAPHICS_PROGRESSIVE_RENDERER_HPP
+#define GRAPHICS_PROGRESSIVE_RENDERER_HPP
+
+#include "cpu_renderer.hpp"
+#include "framebuffer.hpp"
+#include "renderer_context.hpp"
+#include "thread_pool.hpp"
+#include "tile.hpp"
+#include "view_context.hpp"
+
+#include <atomic>
+#include <barrier>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace jmrtiow::graphics
+{
+    /// @brief Accumulates one sample per pixel per pass over every tile, with all render
+    /// threads meeting between passes so the image is consistent at every pass boundary.
+    /// Each tile's sample count is kept in the framebuffer, so a render continued from a
+    /// mapped framebuffer brings every tile up to the same count before the next pass.
+    class progressive_renderer
+    {
+    public:
+        /// @brief Called with the number of completed passes while every render thread is parked
+        using pass_callback = std::function<void(uint32_t)>;
+
+        /// @brief Renders into image, continuing from the passes and tile sample counts it holds
+        progressive_renderer(cpu_renderer& renderer, const renderer_context& context, framebuffer& image, aov_buffers* aovs = nullptr);
+
+        /// @brief Renders passes on every thread of pool until pass_limit passes are complete or
+        /// the render control stops. While it is paused the threads wait between tiles.
+        void run(thread_pool& pool, uint32_t pass_limit, pass_callback on_pass_complete = {});
+
+        /// @brief Number of fully completed passes, i.e. samples accumulated per pixel
+        uint32_t completed_passes() const { return passes.load(std::memory_order_acquire); }
+
+        /// @brief Cancels the current pass and starts accumulating again from the first pass.
+        /// update runs once every render thread is parked, so it may change the scene or camera.
+        /// The first pass after a restart is a preview of preview_block sized pixel blocks.
+        void restart(std::function<void()> update, uint32_t preview_block = 1);
+
+    private:
+        cpu_renderer& renderer;
+        const renderer_context& context;
+        std::vector<tile> tiles;
+        math::color3** data;
+        uint32_t data_width;
+        uint32_t data_height;
+        uint64_t seed;
+        aov_buffers* aovs;
+        // Samples held by each tile, only written by the thread rendering the tile or while every thread is parked.
+        uint32_t* tile_passes;
+
+        // Next tile of each thread's range, see tile_range(). Threads render their own range
+        // first, where framebuffer put the pixels on their NUMA node, then help the others.
+        struct alignas(64) tile_cursor
+        {
+            std::atomic<size_t> next;
+            size_t end;
+        };
+
+        void reset_cursors();
+
+        // Lives in the framebuffer header, where other readers of a mapped framebuffer see it.
+        std::atomic<uint32_t>& passes;
+        std::vector<tile_cursor> cursors;
+        std::atomic<size_t> tiles_done;
+
+        // Only changed by the pass barrier completion, while every render thread is parked.
+        bool finished;
+        uint64_t epoch;
+        uint32_t block;
+
+        // Written by restart(), taken by the pass barrier completion once the epoch moved on.
+        std::mutex restart_mutex;
+        std::function<void()> restart_update;
+        uint32_t restart_block;
+    };
+
+    inline progressive_renderer::progressive_renderer(cpu_renderer& renderer, const renderer_context& context, framebuffer& image, aov_buffers* aovs)
+        : renderer(renderer), context(context), tiles(make_tiles(image.width(), image.height(), image.tile_size())), data(image.data_reference()), data_width(image.width()), data_height(image.height()), seed(image.seed()), aovs(aovs), tile_passes(image.tile_passes()), passes(image.passes()), tiles_done(0), finished(false), epoch(0), block(1), restart_block(1)
+    {
+    }
+
+    inline void progressive_renderer::restart(std::function<void()> update, uint32_t preview_block)
+    {
+        {
+            std::lock_guard lock(restart_mutex);
+
+            // Updates that were not applied yet are superseded, not queued.
+            restart_update = std::move(update);
+            restart_block = std::max<uint32_t>(preview_block, 1);
+        }
+
+        // The update is stored before the epoch moves, so a completion that sees the new epoch finds it.
+        context.control->cancel();
+    }
+
+    inline void progressive_renderer::reset_cursors()
+    {
+        for (uint32_t i = 0; i < cursors.size(); i++)
+        {
+            auto [begin, end] = tile_range(i, static_cast<uint32_t>(cursors.size()), tiles.size());
+            cursors[i].next.store(begin, std::memory_order_relaxed);
+            cursors[i].end = end;
+        }
+    }
+
+    inline void progressive_renderer::run(thread_pool& pool, uint32_t pass_limit, pass_callback on_pass_complete)
+    {
+        render_control& control = *context.control;
+        uint32_t thread_count = pool.size();
+
+        cursors = std::vector<tile_cursor>(thread_count);
+        reset_cursors();
+        tiles_done = 0;
+        epoch = control.epoch();
+        finished = passes >= pass_limit || control.stopping();
+
+        if (finished)
+            return;
+
+        // Runs on the last thread to arrive, before any thread starts the next pass.
+        auto complete_pass = [&]() noexcept
+            {
+                uint64_t current_epoch = control.epoch();
+
+                if (current_epoch != epoch && !control.stopping())
+                {
+                    std::function<void()> update;
+                    {
+                        std::lock_guard lock(restart_mutex);
+                        update = std::move(restart_update);
+                        block = restart_block;
+                    }
+
+                    // Every thread is parked, nothing reads the scene or camera while they change.
+                    if (update)
+                        update();
+
+                    // The next pass blends with weight 0 and so overwrites the old image.
+                    epoch = current_epoch;
+                    std::fill(tile_passes, tile_passes + tiles.size(), 0);
+                    passes.store(0, std::memory_order_release);
+                }
+                else if (tiles_done == tiles.size())
+                {
+                    // A preview only stands in for the first pass, which then renders every pixel.
+                    if (block > 1)
+                    {
+                        block = 1;
+                    }
+                    else
+                    {
+                        passes.fetch_add(1, std::memory_order_release);
+                        if (on_pass_complete)
+                            on_pass_complete(passes);
+                    }
+                }
+
+                // A cancelled pass leaves some tiles a sample ahead, their counts say so.
+                reset_cursors();
+                tiles_done = 0;
+                finished = control.stopping() || passes >= pass_limit;
+            };
+
+        std::barrier pass_barrier(thread_count, complete_pass);
+
+        // Takes the next tile of the thread's own range, or else of the others' in turn.
+        auto take_tile = [&](uint32_t index, size_t& tile_index)
+            {
+                for (uint32_t offset = 0; offset < thread_count; offset++)
+                {
+                    tile_cursor& cursor = cursors[(index + offset) % thread_count];
+                    if (cursor.next.load(std::memory_order_relaxed) >= cursor.end)
+                        continue;
+
+                    size_t i = cursor.next.fetch_add(1, std::memory_order_relaxed);
+                    if (i < cursor.end)
+                    {
+                        tile_index = i;
+                        return true;
+                    }
+                }
+
+                return false;
+            };
+
+        auto work = [&](uint32_t index)
+            {
+                while (true)
+                {
+                    uint32_t pass = passes.load(std::memory_order_acquire);
+                    uint64_t pass_epoch = epoch;
+                    size_t i;
+
+                    while (true)
+                    {
+                        // Pausing holds threads here, between tiles, so no work is lost or repeated.
+                        if (control.paused() && !control.wait_while_paused())
+                            break;
+                        if (control.cancelled(pass_epoch) || !take_tile(index, i))
+                            break;
+
+                        // Tiles already at the pass's count are skipped, tiles behind catch up.
+                        // A preview does not count, the first pass renders over it.
+                        uint32_t held = block > 1 ? 0 : tile_passes[i];
+                        uint32_t samples = block > 1 ? 1 : pass + 1 - std::min(held, pass + 1);
+
+                        if (samples > 0)
+                        {
+                            view_context view {
+                                .width = tiles[i].width,
+                                .height = tiles[i].height,
+                                .x = tiles[i].x,
+                                .y = tiles[i].y,
+                                .data = data,
+                                .data_width = data_width,
+                                .data_height = data_height,
+                                .data_y = 0,
+                                .seed = seed,
+                                .iteration = held,
+                                .block = block,
+                                .epoch = pass_epoch,
+                                .aovs = aovs,
+                            };
+
+                            // The dirty mark stays if the tile is interrupted, its rows then hold different counts.
+                            if (block == 1)
+                                tile_passes[i] = held | tile_passes_dirty;
+
+                            renderer.render_samples(context, view, samples);
+
+                            if (control.cancelled(pass_epoch))
+                                break;
+
+                            if (block == 1)
+                                tile_passes[i] = pass + 1;
+                        }
+
+                        tiles_done++;
+                    }
+
+                    pass_barrier.arrive_and_wait();
+
+                    if (finished)
+                        break;
+                }
+            };
+
+        pool.run_on_all(work);
+    }
+}
+
+#endif // GRAPHICS_PROGRESSIVE_RENDERER_HPP
@@ -0,0 +1,89 @@
+#ifndef GRAPHICS_RENDER_CONTROL_HPP
+#define GRAPHICS_RENDER_CONTROL_HPP
+
+#include <atomic>
+#include <cstdint>
+
+namespace jmrtiow::graphics
+{
+    /// @brief Run state shared by a render's threads. Work is tagged with the epoch it started
+    /// in; bumping the epoch cancels it, pausing parks threads between tiles and stopping
+    /// cancels everything for good. Render threads only ever load the state.
+    class render_control
+    {
+    public:
+        render_control() : current_epoch(0), state(running) {}
+
+        render_control(const render_control&) = delete;
+        render_control& operator=(const render_control&) = delete;
+
+        uint64_t epoch() const { return current_epoch.load(std::memory_order_acquire); }
+
+        /// @brief Cancels all work started before, e.g. because the camera changed
+        /// @return The new epoch
+        uint64_t cancel() { return current_epoch.fetch_add(1, std::memory_order_acq_rel) + 1; }
+
+        /// @brief Parks render threads before their next tile, without cancelling work
+        void pause();
+        void resume();
+
+        /// @brief Cancels all work and releases paused threads, for shutdown
+        void stop();
+
+        bool paused() const { return state.load(std::memory_order_relaxed) == paused_state; }
+        bool stopping() const { return state.load(std::memory_order_relaxed) == stopping_state; }
+
+        /// @brief True if work started in epoch must be abandoned
+        bool cancelled(uint64_t epoch) const
+        {
+            return current_epoch.load(std::memory_order_relaxed) != epoch || stopping();
+        }
+
+        /// @brief Blocks the calling thread while paused
+        /// @return False if the render is stopping
+        bool wait_while_paused();
+
+    private:
+        enum : uint32_t
+        {
+            running,
+            paused_state,
+            stopping_state,
+        };
+
+        std::atomic<uint64_t> current_epoch;
+        std::atomic<uint32_t> state;
+    };
+
+    inline void render_control::pause()
+    {
+        uint32_t expected = running;
+        state.compare_exchange_strong(expected, paused_state, std::memory_order_acq_rel);
+    }
+
+    inline void render_control::resume()
+    {
+        uint32_t expected = paused_state;
+        if (state.compare_exchange_strong(expected, running, std::memory_order_acq_rel))
+            state.notify_all();
+    }
+
+    inline void render_control::stop()
+    {
+        state.store(stopping_state, std::memory_order_release);
+        state.notify_all();
+    }
+
+    inline bool render_control::wait_while_paused()
+    {
+        uint32_t current;
+        while ((current = state.load(std::memory_order_acquire)) == paused_state)
+        {
+            state.wait(paused_state, std::memory_order_acquire);
+        }
+
+        return current != stopping_state;
+    }
+}
+
+#endif // GRAPHICS_RENDER_CONTROL_HPP
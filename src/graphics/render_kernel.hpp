@@ -0,0 +1,142 @@
+#ifndef GRAPHICS_RENDER_KERNEL_HPP
+#define GRAPHICS_RENDER_KERNEL_HPP
+
+#include "renderer_context.hpp"
+#include "tile.hpp"
+#include "view_context.hpp"
+#include "../math/color3.hpp"
+#include "../scene/aov_sample.hpp"
+#include "../scene/hittable_list.hpp"
+#include "../scene/sphere_scene.hpp"
+#include "../rtweekend.hpp"
+#include "../stats/render_stats.hpp"
+
+#include <algorithm>
+
+namespace jmrtiow::graphics
+{
+    /// @brief Traces any scene through virtual calls, sampling its lights directly if it has any
+    struct hittable_integrator
+    {
+    public:
+        const scene::hittable& world;
+        const scene::hittable* lights;
+        const scene::background& background;
+
+        template <typename Target>
+        math::color3 radiance(const math::ray& r, int depth, scene::aov_sample* aov) const
+        {
+            return scene::ray_color<Target>(r, world, lights, background, depth, 0, aov);
+        }
+    };
+
+    /// @brief Traces a flattened sphere_scene with every call known at compile time
+    struct sphere_scene_integrator
+    {
+    public:
+        const scene::sphere_scene& world;
+        const scene::background& background;
+
+        template <typename Target>
+        math::color3 radiance(const math::ray& r, int depth, scene::aov_sample* aov) const
+        {
+            return world.template ray_color<Target>(r, background, depth, aov);
+        }
+    };
+
+    /// @brief Running mean of the samples of a pixel, used when the context has no blend_callback
+    struct running_mean_blend
+    {
+    public:
+        math::color3 operator()(const math::color3& a, const math::color3& b, uint32_t iteration) const
+        {
+            uint32_t n = iteration + 1;
+            return a * (n - 1) / n + b / n;
+        }
+    };
+
+    /// @brief Blends through the context's blend_callback
+    struct callback_blend
+    {
+    public:
+        const renderer_context& context;
+
+        math::color3 operator()(const math::color3& a, const math::color3& b, uint32_t iteration) const
+        {
+            return context.blend_callback(a, b, iteration);
+        }
+    };
+
+    /// @brief Adds one sample per pixel, or per block of pixels, of the view. Instantiated for each
+    /// integrator and blend so the whole path of a sample can be inlined, and for each target tag of
+    /// math/simd.hpp the caller runs it with. Blocked is false for views of single pixels, which drops
+    /// the loops spreading a sample over its block.
+    template <typename Target, bool Blocked, typename Integrator, typename Blend>
+    void render_kernel(const renderer_context& context, const view_context& view, const Integrator& integrator, const Blend& blend)
+    {
+        const uint32_t block = Blocked ? view.block : 1;
+        double pixel_spread = context.camera->pixel_spread(view.data_height);
+        stats::counters& counters = stats::local();
+
+        for (uint32_t j = view.y; j < view.y + view.height; j += block)
+        {
+            for (uint32_t i = view.x; i < view.x + view.width; i += block)
+            {
+                // Reseeded per sample so the image is reproducible no matter which thread or
+                // process renders a pixel, in which tile, or in what order.
+                seed_random(pixel_seed(view.seed, i, j, view.iteration));
+
+                math::color3 pixel_color(0, 0, 0);
+                auto u = (i + random_double() * block) / (view.data_width - 1);
+                auto v = (j + random_double() * block) / (view.data_height - 1);
+                math::ray r = context.camera->get_ray(u, v);
+                r.sprd = pixel_spread * block;
+
+                uint64_t path_start = counters.rays;
+                scene::aov_sample aov;
+                pixel_color += integrator.template radiance<Target>(r, context.max_depth, view.aovs != nullptr ? &aov : nullptr);
+
+                // Every traced segment after the camera ray is a bounce.
+                uint64_t bounces = counters.rays - path_start;
+                counters.bounces[std::min<uint64_t>(bounces > 0 ? bounces - 1 : 0, stats::bounce_buckets - 1)]++;
+                counters.samples++;
+
+                // A block sample covers every pixel of the block that lies inside the view.
+                uint32_t block_bottom = Blocked ? std::min(j + block, view.y + view.height) : j + 1;
+                uint32_t block_right = Blocked ? std::min(i + block, view.x + view.width) : i + 1;
+
+                for (uint32_t block_j = j; block_j < block_bottom; block_j++)
+                {
+                    for (uint32_t block_i = i; block_i < block_right; block_i++)
+                    {
+                        // For better readability.
+                        size_t pixel = static_cast<size_t>(block_j - view.data_y) * view.data_width + block_i;
+                        auto& image_data_element = (*view.data)[pixel];
+
+                        // Pixel data is normalized, be sure to un-normalize it before averaging.
+                        image_data_element = image_data_element * image_data_element;
+
+                        // Blend color with source.
+                        image_data_element = blend(image_data_element, pixel_color, view.iteration);
+
+                        // Normalize the color samples and gamma correct before passing off to pixel data.
+                        image_data_element.r = sqrt(image_data_element.r);
+                        image_data_element.g = sqrt(image_data_element.g);
+                        image_data_element.b = sqrt(image_data_element.b);
+
+                        if (view.aovs != nullptr)
+                            view.aovs->add(pixel, aov, pixel_color, view.iteration == 0);
+                    }
+                }
+            }
+
+            // A row of a tile is the most work a cancellation waits for.
+            if (context.control->cancelled(view.epoch))
+            {
+                break;
+            }
+        }
+    }
+}
+
+#endif // GRAPHICS_RENDER_KERNEL_HPP
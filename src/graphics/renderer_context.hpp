@@ -2,8 +2,13 @@
 #define GRAPHICS_RENDERER_CONTEXT_HPP
 
 #include <stdint.h>
+#include <functional>
+#include "isa.hpp"
+#include "render_control.hpp"
+#include "../scene/background.hpp"
 #include "../scene/hittable.hpp"
 #include "../scene/camera.hpp"
+#include "../scene/sphere_scene.hpp"
 
 namespace jmrtiow::graphics
 {
@@ -15,13 +20,23 @@ namespace jmrtiow::graphics
         uint32_t max_depth;
         /// @brief Number of samples to render and average per pixel (set to -1 for cumulative sampling)
         uint32_t samples_per_pixel;
-        /// @brief Bool to stop the renderer
-        bool* pause;
+        /// @brief Cancellation, pause and stop requests for the renderer
+        render_control* control;
         /// @brief Pointer to the scene to render
         scene::hittable* scene;
+        /// @brief Flattened copy of scene if it only holds spheres sphere_scene supports, renderers then trace
+        /// it without virtual calls. nullptr to always trace scene.
+        const scene::sphere_scene* spheres;
+        /// @brief Instruction set of the kernel versions to render with, one isa_supported() on this CPU
+        isa_level isa;
+        /// @brief Emitters sampled directly at every diffuse hit, nullptr to only find light by scattering
+        scene::hittable* lights;
+        /// @brief Radiance of rays leaving the scene
+        scene::background background;
         /// @brief Pointer to the camera to use
         scene::camera* camera;
-        /// @brief Blending function to use if samples_per_pixel is not 1
+        /// @brief Blending function to use if samples_per_pixel is not 1, empty for the running mean, which
+        /// renderers inline
         std::function<math::color3(const math::color3&, const math::color3&, const uint32_t&)> blend_callback;
     };
 }
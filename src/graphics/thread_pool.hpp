@@ -0,0 +1,197 @@
+#ifndef GRAPHICS_THREAD_POOL_HPP
+#define GRAPHICS_THREAD_POOL_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace jmrtiow::graphics
+{
+    /// @brief Fixed set of threads living as long as the pool, shared by rendering and any
+    /// other parallel work. Threads are numbered, so callers can give each one a fixed share
+    /// of the work and keep its data local to it.
+    class thread_pool
+    {
+    public:
+        /// @brief Starts thread_count threads, optionally pinned one per CPU with CPUs of the same
+        /// NUMA node next to each other, so neighbouring thread indices share a node.
+        thread_pool(uint32_t thread_count, bool pin_threads = false);
+        ~thread_pool();
+
+        thread_pool(const thread_pool&) = delete;
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        uint32_t size() const { return static_cast<uint32_t>(threads.size()); }
+
+        /// @brief Calls task with each thread's index on every pool thread and returns once all
+        /// calls returned. Calls from several threads run one after another. Must not be called
+        /// from a pool thread.
+        void run_on_all(const std::function<void(uint32_t)>& task);
+
+        /// @brief Calls task for every index in [0, count), each thread taking a contiguous range
+        void parallel_for(size_t count, const std::function<void(size_t)>& task);
+
+    private:
+        void work(uint32_t index, int cpu);
+
+        std::vector<std::thread> threads;
+
+        // Serializes run_on_all callers.
+        std::mutex run_mutex;
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+        const std::function<void(uint32_t)>* task;
+        uint64_t generation;
+        uint32_t running;
+        bool stopping;
+    };
+
+    /// @brief CPUs this process may run on, grouped by NUMA node
+    inline std::vector<int> numa_ordered_cpus()
+    {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+            return {};
+
+        std::vector<std::pair<int, int>> node_cpus {};
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (!CPU_ISSET(cpu, &allowed))
+                continue;
+
+            // Linux lists a CPU's node as a nodeN entry of its sysfs directory.
+            int node = 0;
+            std::error_code error;
+            for (const auto& entry : std::filesystem::directory_iterator("/sys/devices/system/cpu/cpu" + std::to_string(cpu), error))
+            {
+                std::string name = entry.path().filename().string();
+                if (name.starts_with("node") && name.size() > 4 && std::isdigit(static_cast<unsigned char>(name[4])))
+                    node = std::stoi(name.substr(4));
+            }
+
+            node_cpus.emplace_back(node, cpu);
+        }
+
+        std::sort(node_cpus.begin(), node_cpus.end());
+
+        std::vector<int> cpus {};
+        for (const auto& [node, cpu] : node_cpus)
+            cpus.push_back(cpu);
+
+        return cpus;
+    }
+
+    inline thread_pool::thread_pool(uint32_t thread_count, bool pin_threads)
+        : task(nullptr), generation(0), running(0), stopping(false)
+    {
+        thread_count = std::max<uint32_t>(thread_count, 1);
+
+        std::vector<int> cpus {};
+        if (pin_threads)
+        {
+            cpus = numa_ordered_cpus();
+            if (cpus.empty())
+                std::cerr << "Could not read the CPU affinity, threads are not pinned\n";
+        }
+
+        threads.reserve(thread_count);
+        for (uint32_t i = 0; i < thread_count; i++)
+        {
+            int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+            threads.emplace_back(&thread_pool::work, this, i, cpu);
+        }
+    }
+
+    inline thread_pool::~thread_pool()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+
+        for (auto& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    inline void thread_pool::run_on_all(const std::function<void(uint32_t)>& new_task)
+    {
+        std::lock_guard run_lock(run_mutex);
+        std::unique_lock lock(mutex);
+
+        task = &new_task;
+        running = size();
+        generation++;
+        wake.notify_all();
+
+        done.wait(lock, [this]() { return running == 0; });
+        task = nullptr;
+    }
+
+    inline void thread_pool::parallel_for(size_t count, const std::function<void(size_t)>& body)
+    {
+        run_on_all([this, count, &body](uint32_t index)
+            {
+                size_t begin = count * index / size();
+                size_t end = count * (index + 1) / size();
+
+                for (size_t i = begin; i < end; i++)
+                {
+                    body(i);
+                }
+            });
+    }
+
+    inline void thread_pool::work(uint32_t index, int cpu)
+    {
+        if (cpu >= 0)
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+                std::cerr << "Could not pin thread " << index << " to CPU " << cpu << '\n';
+        }
+
+        uint64_t seen_generation = 0;
+
+        while (true)
+        {
+            const std::function<void(uint32_t)>* current_task;
+            {
+                std::unique_lock lock(mutex);
+                wake.wait(lock, [&]() { return stopping || generation != seen_generation; });
+
+                if (stopping)
+                    return;
+
+                seen_generation = generation;
+                current_task = task;
+            }
+
+            (*current_task)(index);
+
+            std::lock_guard lock(mutex);
+            if (--running == 0)
+                done.notify_one();
+        }
+    }
+}
+
+#endif // GRAPHICS_THREAD_POOL_HPP
@@ -0,0 +1,64 @@
+#ifndef GRAPHICS_TILE_HPP
+#define GRAPHICS_TILE_HPP
+
+#include <stdint.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include "../rtweekend.hpp"
+
+namespace jmrtiow::graphics
+{
+    /// @brief Rectangular region of the image that is rendered as one unit of work
+    struct tile
+    {
+    public:
+        /// @brief X location to start from
+        uint32_t x;
+        /// @brief Y location to start from
+        uint32_t y;
+        /// @brief Width of the tile in pixels
+        uint32_t width;
+        /// @brief Height of the tile in pixels
+        uint32_t height;
+    };
+
+    /// @brief First and one past the last tile index thread renders first, out of tile_count tiles split over thread_count threads
+    inline std::pair<size_t, size_t> tile_range(uint32_t thread, uint32_t thread_count, size_t tile_count)
+    {
+        return { tile_count * thread / thread_count, tile_count * (thread + 1) / thread_count };
+    }
+
+    inline std::vector<tile> make_tiles(uint32_t image_width, uint32_t image_height, uint32_t tile_size)
+    {
+        std::vector<tile> tiles {};
+        tile_size = std::max<uint32_t>(tile_size, 1);
+
+        for (uint32_t y = 0; y < image_height; y += tile_size)
+        {
+            for (uint32_t x = 0; x < image_width; x += tile_size)
+            {
+                tiles.push_back(tile {
+                    .x = x,
+                    .y = y,
+                    .width = std::min(tile_size, image_width - x),
+                    .height = std::min(tile_size, image_height - y),
+                });
+            }
+        }
+
+        return tiles;
+    }
+
+    inline uint64_t pixel_seed(uint64_t seed, uint32_t x, uint32_t y, uint32_t iteration)
+    {
+        // A stream per pixel and iteration, whose draws are the dimensions of the sample, so a
+        // pixel's samples only depend on where it is and how many times it has been sampled, not
+        // on the tile layout or on which thread or process happens to render it.
+        return mix_bits(seed
+            + 0x9e3779b97f4a7c15ull * ((static_cast<uint64_t>(x) << 32 | y) + 1)
+            + 0xbf58476d1ce4e5b9ull * (static_cast<uint64_t>(iteration) + 1));
+    }
+}
+
+#endif // GRAPHICS_TILE_HPP
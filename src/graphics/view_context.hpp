@@ -2,7 +2,8 @@
 #define GRAPHICS_VIEW_CONTEXT_HPP
 
 #include <stdint.h>
-#include "../math/vec3.hpp"
+#include "aov_buffers.hpp"
+#include "../math/color3.hpp"
 
 namespace jmrtiow::graphics
 {
@@ -24,8 +25,18 @@ namespace jmrtiow::graphics
         uint32_t data_width;
         /// @brief Number of pixels per column in the view
         uint32_t data_height;
+        /// @brief Image row held by the first row of data, which may only hold a band of the image
+        uint32_t data_y;
+        /// @brief Base seed of the render, every pixel sample draws from its own stream, see pixel_seed()
+        uint64_t seed;
         /// @brief The number of completed iterations this view has rendered
         uint32_t iteration;
+        /// @brief Edge of the square pixel blocks sharing one sample, 1 renders every pixel
+        uint32_t block;
+        /// @brief Render control epoch the view is rendered for, it stops once that is cancelled
+        uint64_t epoch;
+        /// @brief First hit outputs summed next to data, or nullptr to skip them
+        aov_buffers* aovs;
     };
 }
 
@@ -0,0 +1,414 @@
+#ifndef IMAGE_EXR_WRITER_HPP
+#define IMAGE_EXR_WRITER_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+namespace jmrtiow::image
+{
+    /// @brief Storage type of every channel of an EXR file
+    enum class exr_pixel_type : int32_t
+    {
+        half = 1,
+        float32 = 2
+    };
+
+    /// @brief One named channel of an EXR image, width * height values stored top row first.
+    /// Layers are channels sharing a prefix, as in "albedo.R".
+    struct exr_channel
+    {
+    public:
+        std::string name;
+        std::vector<float> values;
+    };
+
+    /// @brief Writes single part OpenEXR files: tiled or scanline, half or float, ZIP compressed.
+    /// Rows are streamed in top row first, only the rows of one line of chunks are held at a time.
+    class exr_writer
+    {
+    public:
+        struct settings
+        {
+        public:
+            exr_pixel_type pixel_type;
+            /// @brief Edge length of a tile in pixels, 0 writes scanlines instead
+            uint32_t tile_size;
+        };
+
+        static constexpr settings default_settings { .pixel_type = exr_pixel_type::half, .tile_size = 64 };
+
+        exr_writer(settings options = default_settings) : options(options) {}
+
+        /// @brief Writes the header to out, which must be seekable to fill in the chunk offsets on close().
+        /// Names up to 31 bytes keep the file readable without the long names flag.
+        bool open(std::ostream& out, const std::vector<std::string>& channel_names, uint32_t width, uint32_t height);
+
+        /// @brief Adds the next row, one pointer to width values per channel in the order given to open()
+        bool write_row(const float* const* values);
+
+        /// @brief Writes the rows still buffered and the chunk offsets. Fails if rows are missing.
+        bool close();
+
+        /// @brief Writes a whole image of equally sized channels
+        bool write(std::ostream& out, const std::vector<exr_channel>& channels, uint32_t width, uint32_t height);
+
+    private:
+        void write_header(std::string& header, const std::vector<std::string>& sorted_names) const;
+        void write_chunks();
+        void pack_block(std::string& chunk, uint32_t x, uint32_t chunk_width, uint32_t chunk_rows) const;
+        static void compress_block(std::string& block, std::string& scratch);
+
+        settings options;
+
+        std::ostream* out = nullptr;
+        std::streamoff file_start;
+        std::streamoff table_start;
+        uint32_t width;
+        uint32_t height;
+        uint32_t block_width;
+        uint32_t block_height;
+        uint32_t blocks_x;
+
+        // Caller's index of each channel, in the name order the file stores them.
+        std::vector<size_t> channel_order;
+        // Buffered rows of the current line of chunks, one block_height by width plane per stored channel.
+        std::vector<float> rows;
+        uint32_t buffered_rows;
+        uint32_t next_row;
+        std::vector<uint64_t> offsets;
+        std::string block;
+        std::string scratch;
+    };
+
+    /// @brief Converts a float to the nearest half precision value, overflowing to infinity
+    inline uint16_t float_to_half(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        uint16_t sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+        uint32_t magnitude = bits & 0x7fffffff;
+
+        // Infinity stays infinity, NaN stays a quiet NaN.
+        if (magnitude >= 0x7f800000)
+            return sign | 0x7c00 | (magnitude > 0x7f800000 ? 0x0200 : 0);
+
+        if (magnitude >= 0x47800000)
+            return sign | 0x7c00;
+
+        // Below the smallest normal half the value becomes a denormal, or zero below half of the smallest denormal.
+        if (magnitude < 0x38800000)
+        {
+            if (magnitude < 0x33000000)
+                return sign;
+
+            uint32_t shift = 126 - (magnitude >> 23);
+            uint32_t mantissa = (magnitude & 0x007fffff) | 0x00800000;
+            uint32_t result = mantissa >> shift;
+            uint32_t remainder = mantissa & ((1u << shift) - 1);
+            uint32_t halfway = 1u << (shift - 1);
+            if (remainder > halfway || (remainder == halfway && (result & 1)))
+                result++;
+
+            return sign | static_cast<uint16_t>(result);
+        }
+
+        // Rebias the exponent and round the mantissa to nearest even, a carry correctly bumps the exponent.
+        uint32_t result = (magnitude - 0x38000000) >> 13;
+        uint32_t remainder = magnitude & 0x1fff;
+        if (remainder > 0x1000 || (remainder == 0x1000 && (result & 1)))
+            result++;
+
+        return sign | static_cast<uint16_t>(result);
+    }
+
+    namespace detail
+    {
+        template <typename T>
+        inline void append_value(std::string& bytes, T value)
+        {
+            // EXR files are little endian, like every platform we build for.
+            bytes.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        inline void append_attribute(std::string& bytes, const char* name, const char* type, const std::string& value)
+        {
+            bytes.append(name).push_back('\0');
+            bytes.append(type).push_back('\0');
+            append_value(bytes, static_cast<int32_t>(value.size()));
+            bytes.append(value);
+        }
+    }
+
+    inline bool exr_writer::open(std::ostream& out, const std::vector<std::string>& channel_names, uint32_t width, uint32_t height)
+    {
+        this->out = nullptr;
+        if (channel_names.empty() || width == 0 || height == 0)
+            return false;
+
+        for (auto&& name : channel_names)
+        {
+            if (name.empty() || name.size() > 31)
+                return false;
+        }
+
+        // Readers expect the channel list, and so the channel data of every line, sorted by name.
+        channel_order.resize(channel_names.size());
+        for (size_t i = 0; i < channel_order.size(); i++)
+            channel_order[i] = i;
+        std::sort(channel_order.begin(), channel_order.end(), [&](size_t a, size_t b) { return channel_names[a] < channel_names[b]; });
+
+        std::vector<std::string> sorted_names {};
+        for (size_t index : channel_order)
+            sorted_names.push_back(channel_names[index]);
+
+        this->width = width;
+        this->height = height;
+
+        // A ZIP chunk holds 16 scanlines, a tiled file holds one tile per chunk.
+        block_width = options.tile_size > 0 ? options.tile_size : width;
+        block_height = options.tile_size > 0 ? options.tile_size : 16;
+        blocks_x = (width + block_width - 1) / block_width;
+        uint32_t blocks_y = (height + block_height - 1) / block_height;
+
+        std::string header {};
+        write_header(header, sorted_names);
+
+        file_start = out.tellp();
+        out.write(header.data(), header.size());
+        table_start = out.tellp();
+
+        // The offsets are only known once the chunks are written, the table is filled in by close().
+        offsets.assign(static_cast<size_t>(blocks_x) * blocks_y, 0);
+        out.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+        offsets.clear();
+
+        rows.assign(channel_order.size() * block_height * width, 0.0f);
+        buffered_rows = 0;
+        next_row = 0;
+
+        if (!out.good() || file_start < 0)
+            return false;
+
+        this->out = &out;
+        return true;
+    }
+
+    inline bool exr_writer::write_row(const float* const* values)
+    {
+        if (out == nullptr || next_row >= height)
+            return false;
+
+        for (size_t c = 0; c < channel_order.size(); c++)
+        {
+            const float* source = values[channel_order[c]];
+            std::copy(source, source + width, rows.begin() + (c * block_height + buffered_rows) * width);
+        }
+
+        buffered_rows++;
+        next_row++;
+
+        if (buffered_rows == block_height || next_row == height)
+            write_chunks();
+
+        return out->good();
+    }
+
+    inline bool exr_writer::close()
+    {
+        if (out == nullptr)
+            return false;
+
+        std::ostream& file = *out;
+        out = nullptr;
+
+        if (next_row != height)
+            return false;
+
+        std::streamoff file_end = file.tellp();
+        file.seekp(table_start);
+        file.write(reinterpret_cast<const char*>(offsets.data()), offsets.size() * sizeof(uint64_t));
+        file.seekp(file_end);
+
+        return file.good();
+    }
+
+    inline bool exr_writer::write(std::ostream& out, const std::vector<exr_channel>& channels, uint32_t width, uint32_t height)
+    {
+        size_t pixel_count = static_cast<size_t>(width) * height;
+
+        std::vector<std::string> names {};
+        for (auto&& channel : channels)
+        {
+            if (channel.values.size() != pixel_count)
+                return false;
+            names.push_back(channel.name);
+        }
+
+        if (!open(out, names, width, height))
+            return false;
+
+        std::vector<const float*> row(channels.size());
+        for (uint32_t j = 0; j < height; j++)
+        {
+            for (size_t c = 0; c < channels.size(); c++)
+                row[c] = channels[c].values.data() + static_cast<size_t>(j) * width;
+
+            if (!write_row(row.data()))
+                return false;
+        }
+
+        return close();
+    }
+
+    inline void exr_writer::write_header(std::string& header, const std::vector<std::string>& sorted_names) const
+    {
+        // Magic number, then version 2 with the single part tiled flag if needed.
+        detail::append_value(header, int32_t { 20000630 });
+        detail::append_value(header, static_cast<int32_t>(options.tile_size > 0 ? 2 | 0x200 : 2));
+
+        std::string channel_list {};
+        for (auto&& name : sorted_names)
+        {
+            channel_list.append(name).push_back('\0');
+            detail::append_value(channel_list, static_cast<int32_t>(options.pixel_type));
+            // pLinear and three reserved bytes, then the x and y sampling.
+            detail::append_value(channel_list, int32_t { 0 });
+            detail::append_value(channel_list, int32_t { 1 });
+            detail::append_value(channel_list, int32_t { 1 });
+        }
+        channel_list.push_back('\0');
+
+        std::string window {};
+        detail::append_value(window, int32_t { 0 });
+        detail::append_value(window, int32_t { 0 });
+        detail::append_value(window, static_cast<int32_t>(width - 1));
+        detail::append_value(window, static_cast<int32_t>(height - 1));
+
+        std::string one {};
+        detail::append_value(one, 1.0f);
+
+        std::string center {};
+        detail::append_value(center, 0.0f);
+        detail::append_value(center, 0.0f);
+
+        // ZIP_COMPRESSION and INCREASING_Y.
+        detail::append_attribute(header, "channels", "chlist", channel_list);
+        detail::append_attribute(header, "compression", "compression", std::string(1, '\3'));
+        detail::append_attribute(header, "dataWindow", "box2i", window);
+        detail::append_attribute(header, "displayWindow", "box2i", window);
+        detail::append_attribute(header, "lineOrder", "lineOrder", std::string(1, '\0'));
+        detail::append_attribute(header, "pixelAspectRatio", "float", one);
+        detail::append_attribute(header, "screenWindowCenter", "v2f", center);
+        detail::append_attribute(header, "screenWindowWidth", "float", one);
+
+        if (options.tile_size > 0)
+        {
+            // A single level with round down mode.
+            std::string tiles {};
+            detail::append_value(tiles, options.tile_size);
+            detail::append_value(tiles, options.tile_size);
+            tiles.push_back('\0');
+            detail::append_attribute(header, "tiles", "tiledesc", tiles);
+        }
+
+        header.push_back('\0');
+    }
+
+    inline void exr_writer::write_chunks()
+    {
+        uint32_t y = next_row - buffered_rows;
+        std::string chunk_header {};
+
+        for (uint32_t block_x = 0; block_x < blocks_x; block_x++)
+        {
+            uint32_t x = block_x * block_width;
+
+            pack_block(block, x, std::min(block_width, width - x), buffered_rows);
+            compress_block(block, scratch);
+
+            chunk_header.clear();
+            if (options.tile_size > 0)
+            {
+                detail::append_value(chunk_header, static_cast<int32_t>(block_x));
+                detail::append_value(chunk_header, static_cast<int32_t>(y / block_height));
+                detail::append_value(chunk_header, int32_t { 0 });
+                detail::append_value(chunk_header, int32_t { 0 });
+            }
+            else
+            {
+                detail::append_value(chunk_header, static_cast<int32_t>(y));
+            }
+            detail::append_value(chunk_header, static_cast<int32_t>(block.size()));
+
+            // Chunks are written in increasing y, in the order of the offset table.
+            offsets.push_back(static_cast<uint64_t>(out->tellp() - file_start));
+            out->write(chunk_header.data(), chunk_header.size());
+            out->write(block.data(), block.size());
+        }
+
+        buffered_rows = 0;
+    }
+
+    inline void exr_writer::pack_block(std::string& chunk, uint32_t x, uint32_t chunk_width, uint32_t chunk_rows) const
+    {
+        chunk.clear();
+
+        // Every line of the chunk holds each channel's values in turn.
+        for (uint32_t j = 0; j < chunk_rows; j++)
+        {
+            for (size_t c = 0; c < channel_order.size(); c++)
+            {
+                const float* row = rows.data() + (c * block_height + j) * width;
+
+                for (uint32_t i = x; i < x + chunk_width; i++)
+                {
+                    if (options.pixel_type == exr_pixel_type::half)
+                        detail::append_value(chunk, float_to_half(row[i]));
+                    else
+                        detail::append_value(chunk, row[i]);
+                }
+            }
+        }
+    }
+
+    inline void exr_writer::compress_block(std::string& block, std::string& scratch)
+    {
+        size_t size = block.size();
+        scratch.resize(size);
+
+        // Split the even and odd bytes, so the high bytes of neighbouring values sit next to each other.
+        size_t half_size = (size + 1) / 2;
+        for (size_t i = 0; i < size; i++)
+        {
+            scratch[(i & 1) ? half_size + i / 2 : i / 2] = block[i];
+        }
+
+        // Then store each byte as the difference to the previous one.
+        for (size_t i = size; i-- > 1;)
+        {
+            int delta = static_cast<uint8_t>(scratch[i]) - static_cast<uint8_t>(scratch[i - 1]) + 128;
+            scratch[i] = static_cast<char>(delta);
+        }
+
+        uLongf compressed_size = compressBound(size);
+        std::string compressed(compressed_size, '\0');
+        if (compress2(reinterpret_cast<Bytef*>(compressed.data()), &compressed_size, reinterpret_cast<const Bytef*>(scratch.data()), size, Z_DEFAULT_COMPRESSION) != Z_OK)
+            return;
+
+        // Readers take a chunk that did not shrink as stored uncompressed.
+        if (compressed_size < size)
+        {
+            compressed.resize(compressed_size);
+            block.swap(compressed);
+        }
+    }
+}
+
+#endif // IMAGE_EXR_WRITER_HPP
@@ -0,0 +1,42 @@
+#ifndef IMAGE_IMAGE_CHECKSUM_HPP
+#define IMAGE_IMAGE_CHECKSUM_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "../math/color3.hpp"
+
+namespace jmrtiow::image
+{
+    /// @brief 64-bit FNV-1a hash of the exact bits of the red, green and blue values of the pixels of an
+    /// image, top row first. Renders are deterministic, so equal checksums of the same scene, size, seed
+    /// and samples mean equal images.
+    class image_checksum
+    {
+    public:
+        /// @brief Adds the next count pixels
+        void add(const math::color3* pixels, size_t count);
+
+        uint64_t value() const { return hash; }
+
+    private:
+        uint64_t hash = 0xcbf29ce484222325ull;
+    };
+
+    inline void image_checksum::add(const math::color3* pixels, size_t count)
+    {
+        for (size_t pixel = 0; pixel < count; pixel++)
+        {
+            // The padding lane is not part of the image.
+            const auto* bytes = reinterpret_cast<const uint8_t*>(pixels[pixel].data);
+
+            for (size_t i = 0; i < 3 * sizeof(double); i++)
+            {
+                hash ^= bytes[i];
+                hash *= 0x100000001b3ull;
+            }
+        }
+    }
+}
+
+#endif // IMAGE_IMAGE_CHECKSUM_HPP
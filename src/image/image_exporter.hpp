@@ -6,9 +6,11 @@
 #include <format>
 #include <stdint.h>
 
+#include "exr_writer.hpp"
 #include "image_type.hpp"
 #include "../exceptions/not_implemented.hpp"
 
+#define STB_IMAGE_WRITE_STATIC
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include <stb_image_write.h>
 
@@ -49,6 +51,10 @@ namespace jmrtiow::image
         bool export_data(std::ostream& out, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height);
         bool export_data(std::string filepath, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height);
 
+        /// @brief Writes the image as linear R, G and B channels and any extra layers to one OpenEXR file
+        bool export_exr(std::ostream& out, const std::vector<math::color3>& image_data, std::vector<exr_channel> layers, int image_width, int image_height, exr_writer::settings options = exr_writer::default_settings);
+        bool export_exr(std::string filepath, const std::vector<math::color3>& image_data, std::vector<exr_channel> layers, int image_width, int image_height, exr_writer::settings options = exr_writer::default_settings);
+
     private:
         bool export_png(std::ostream& out, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height);
         bool export_jpg(std::ostream& out, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height);
@@ -62,7 +68,7 @@ namespace jmrtiow::image
         std::vector<color3float> prime_for_hdr(const std::vector<math::color3>& image_data);
     };
 
-    bool image_exporter::export_data(std::ostream& out, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height)
+    inline bool image_exporter::export_data(std::ostream& out, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height)
     {
         switch (file_type)
         {
@@ -87,12 +93,15 @@ namespace jmrtiow::image
         case image_type::WEBP:
             return export_webp(out, file_type, image_data, image_width, image_height);
             break;
+        case image_type::EXR:
+            return export_exr(out, image_data, {}, image_width, image_height);
+            break;
         default:
             throw not_implemented("Unknown file type export started", __PRETTY_FUNCTION__);
         }
     }
 
-    bool image_exporter::export_data(std::string filepath, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height)
+    inline bool image_exporter::export_data(std::string filepath, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height)
     {
         std::ofstream file_stream(filepath, std::ios::trunc);
 
@@ -104,7 +113,46 @@ namespace jmrtiow::image
         return export_data(file_stream, file_type, image_data, image_width, image_height);
     }
 
-    bool image_exporter::export_png(std::ostream& out, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height)
+    inline bool image_exporter::export_exr(std::ostream& out, const std::vector<math::color3>& image_data, std::vector<exr_channel> layers, int image_width, int image_height, exr_writer::settings options)
+    {
+        // Image data is gamma corrected, EXR files hold linear values.
+        auto pixel_data = prime_for_hdr(image_data);
+
+        exr_channel red { .name = "R" };
+        exr_channel green { .name = "G" };
+        exr_channel blue { .name = "B" };
+        red.values.reserve(pixel_data.size());
+        green.values.reserve(pixel_data.size());
+        blue.values.reserve(pixel_data.size());
+
+        for (auto&& pixel : pixel_data)
+        {
+            red.values.push_back(pixel.r);
+            green.values.push_back(pixel.g);
+            blue.values.push_back(pixel.b);
+        }
+
+        layers.push_back(std::move(red));
+        layers.push_back(std::move(green));
+        layers.push_back(std::move(blue));
+
+        exr_writer writer(options);
+        return writer.write(out, layers, image_width, image_height);
+    }
+
+    inline bool image_exporter::export_exr(std::string filepath, const std::vector<math::color3>& image_data, std::vector<exr_channel> layers, int image_width, int image_height, exr_writer::settings options)
+    {
+        std::ofstream file_stream(filepath, std::ios::trunc | std::ios::binary);
+
+        if (!file_stream.is_open())
+        {
+            return false;
+        }
+
+        return export_exr(file_stream, image_data, std::move(layers), image_width, image_height, options);
+    }
+
+    inline bool image_exporter::export_png(std::ostream& out, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height)
     {
         // First we change the doubles to bytes from 0-255.
         auto pixel_data = convert_to_bytes(image_data);
@@ -120,7 +168,7 @@ namespace jmrtiow::image
         return return_code != 0;
     }
 
-    bool image_exporter::export_jpg(std::ostream& out, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height)
+    inline bool image_exporter::export_jpg(std::ostream& out, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height)
     {
         // First we change the doubles to bytes from 0-255.
         auto pixel_data = convert_to_bytes(image_data);
@@ -136,7 +184,7 @@ namespace jmrtiow::image
         return return_code != 0;
     }
 
-    bool image_exporter::export_bmp(std::ostream& out, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height)
+    inline bool image_exporter::export_bmp(std::ostream& out, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height)
     {
         // First we change the doubles to bytes from 0-255.
         auto pixel_data = convert_to_bytes(image_data);
@@ -152,7 +200,7 @@ namespace jmrtiow::image
         return return_code != 0;
     }
 
-    bool image_exporter::export_tga(std::ostream& out, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height)
+    inline bool image_exporter::export_tga(std::ostream& out, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height)
     {
         // First we change the doubles to bytes from 0-255.
         auto pixel_data = convert_to_bytes(image_data);
@@ -168,7 +216,7 @@ namespace jmrtiow::image
         return return_code != 0;
     }
 
-    bool image_exporter::export_hdr(std::ostream& out, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height)
+    inline bool image_exporter::export_hdr(std::ostream& out, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height)
     {
         // First we change the doubles to bytes from 0-255.
         auto pixel_data = prime_for_hdr(image_data);
@@ -184,7 +232,7 @@ namespace jmrtiow::image
         return return_code != 0;
     }
 
-    bool image_exporter::export_ppm(std::ostream& out, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height)
+    inline bool image_exporter::export_ppm(std::ostream& out, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height)
     {
         out << std::format("P3\n{} {}\n255\n", image_width, image_height);
 
@@ -202,7 +250,7 @@ namespace jmrtiow::image
         return true;
     }
 
-    bool image_exporter::export_webp(std::ostream& out, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height)
+    inline bool image_exporter::export_webp(std::ostream& out, image_type file_type, const std::vector<math::color3>& image_data, int image_width, int image_height)
     {
         // First we change the doubles to bytes from 0-255.
         auto pixel_data = convert_to_bytes(image_data);
@@ -235,7 +283,7 @@ namespace jmrtiow::image
         return bytes;
     }
 
-    inline std::vector<color4byte> convert_to_bytes_rgba(math::color3* image_data, size_t image_data_size)
+    inline std::vector<color4byte> convert_to_bytes_rgba(const math::color3* image_data, size_t image_data_size)
     {
         std::vector<color4byte> bytes {};
         bytes.reserve(image_data_size);
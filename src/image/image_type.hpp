@@ -1,6 +1,8 @@
 #ifndef IMAGE_IMAGE_TYPE_HPP
 #define IMAGE_IMAGE_TYPE_HPP
 
+#include <string>
+
 namespace jmrtiow::image
 {
     enum class image_type
@@ -12,8 +14,30 @@ namespace jmrtiow::image
         TGA,
         HDR,
         PPM,
-        WEBP
+        WEBP,
+        EXR
     };
+
+    inline image_type image_type_from_string(const std::string& name)
+    {
+        if (name == "png")
+            return image_type::PNG;
+        if (name == "jpg" || name == "jpeg")
+            return image_type::JPG;
+        if (name == "bmp")
+            return image_type::BMP;
+        if (name == "tga")
+            return image_type::TGA;
+        if (name == "hdr")
+            return image_type::HDR;
+        if (name == "ppm")
+            return image_type::PPM;
+        if (name == "webp")
+            return image_type::WEBP;
+        if (name == "exr")
+            return image_type::EXR;
+        return image_type::Unknown;
+    }
 }
 
 #endif // IMAGE_IMAGE_TYPE_HPP
@@ -0,0 +1,346 @@
+#ifndef IMAGE_STREAM_WRITER_HPP
+#define IMAGE_STREAM_WRITER_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <format>
+#include <memory>
+#include <ostream>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "exr_writer.hpp"
+#include "image_type.hpp"
+#include "../math/color3.hpp"
+
+#include <zlib.h>
+
+namespace jmrtiow::image
+{
+    /// @brief Writes an image one row at a time, top row first, so only the rows in flight are held in memory
+    class stream_writer
+    {
+    public:
+        virtual ~stream_writer() = default;
+
+        /// @brief Adds the next row of gamma corrected colors, and a row of each extra layer the writer was made with
+        virtual bool write_row(const math::color3* colors, const float* const* layers) = 0;
+
+        /// @brief Finishes the file. Fails if rows are missing.
+        virtual bool close() = 0;
+    };
+
+    /// @brief Plain text PPM, the same as image_exporter writes
+    class ppm_stream_writer : public stream_writer
+    {
+    public:
+        ppm_stream_writer(std::ostream& out, uint32_t width, uint32_t height);
+
+        virtual bool write_row(const math::color3* colors, const float* const* layers) override;
+        virtual bool close() override;
+
+    private:
+        std::ostream& out;
+        uint32_t width;
+        uint32_t rows_left;
+        std::string text;
+    };
+
+    /// @brief 8-bit RGB PNG with its image data deflated as the rows arrive
+    class png_stream_writer : public stream_writer
+    {
+    public:
+        png_stream_writer(std::ostream& out, uint32_t width, uint32_t height);
+        ~png_stream_writer();
+
+        png_stream_writer(const png_stream_writer&) = delete;
+        png_stream_writer& operator=(const png_stream_writer&) = delete;
+
+        virtual bool write_row(const math::color3* colors, const float* const* layers) override;
+        virtual bool close() override;
+
+    private:
+        void write_chunk(const char* type, const uint8_t* data, size_t size);
+        bool deflate_row(const uint8_t* row, size_t size, int flush);
+
+        std::ostream& out;
+        uint32_t width;
+        uint32_t rows_left;
+        z_stream stream;
+        bool stream_open;
+        std::vector<uint8_t> previous;
+        std::vector<uint8_t> current;
+        // The row run through each of the five PNG filters, led by the filter type byte.
+        std::array<std::vector<uint8_t>, 5> filtered;
+        std::vector<uint8_t> compressed;
+    };
+
+    /// @brief Tiled or scanline OpenEXR with linear R, G and B channels and any extra layers
+    class exr_stream_writer : public stream_writer
+    {
+    public:
+        exr_stream_writer(std::ostream& out, uint32_t width, uint32_t height, const std::vector<std::string>& layer_names, exr_writer::settings options);
+
+        virtual bool write_row(const math::color3* colors, const float* const* layers) override;
+        virtual bool close() override;
+
+        bool good() const { return opened; }
+
+    private:
+        exr_writer writer;
+        uint32_t width;
+        size_t layer_count;
+        bool opened;
+        std::vector<float> rgb;
+        std::vector<const float*> channels;
+    };
+
+    /// @brief Creates a writer of file_type on out, or nullptr if that type can not be streamed or the header
+    /// could not be written. Only EXR files keep the extra layers.
+    std::unique_ptr<stream_writer> make_stream_writer(image_type file_type, std::ostream& out, uint32_t width, uint32_t height,
+        const std::vector<std::string>& layer_names = {}, exr_writer::settings exr_options = exr_writer::default_settings);
+
+    namespace detail
+    {
+        inline uint8_t to_byte(double value)
+        {
+            return static_cast<uint8_t>(256 * std::clamp(value, 0.0, 0.999));
+        }
+    }
+
+    inline ppm_stream_writer::ppm_stream_writer(std::ostream& out, uint32_t width, uint32_t height)
+        : out(out), width(width), rows_left(height)
+    {
+        out << std::format("P3\n{} {}\n255\n", width, height);
+    }
+
+    inline bool ppm_stream_writer::write_row(const math::color3* colors, const float* const* layers)
+    {
+        if (rows_left == 0)
+            return false;
+        rows_left--;
+
+        text.clear();
+        for (uint32_t i = 0; i < width; i++)
+        {
+            text += std::format("{} {} {}\n", static_cast<int>(detail::to_byte(colors[i].r)), static_cast<int>(detail::to_byte(colors[i].g)), static_cast<int>(detail::to_byte(colors[i].b)));
+        }
+
+        out.write(text.data(), text.size());
+        return out.good();
+    }
+
+    inline bool ppm_stream_writer::close()
+    {
+        out.flush();
+        return rows_left == 0 && out.good();
+    }
+
+    inline png_stream_writer::png_stream_writer(std::ostream& out, uint32_t width, uint32_t height)
+        : out(out), width(width), rows_left(height), stream {}, stream_open(false)
+    {
+        static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        out.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+
+        // Big endian size, 8 bits per channel, RGB, deflate, adaptive filtering, not interlaced.
+        uint8_t header[13] = {
+            static_cast<uint8_t>(width >> 24), static_cast<uint8_t>(width >> 16), static_cast<uint8_t>(width >> 8), static_cast<uint8_t>(width),
+            static_cast<uint8_t>(height >> 24), static_cast<uint8_t>(height >> 16), static_cast<uint8_t>(height >> 8), static_cast<uint8_t>(height),
+            8, 2, 0, 0, 0,
+        };
+        write_chunk("IHDR", header, sizeof(header));
+
+        stream_open = deflateInit(&stream, Z_DEFAULT_COMPRESSION) == Z_OK;
+
+        previous.assign(static_cast<size_t>(width) * 3, 0);
+        current.resize(previous.size());
+        for (auto& candidate : filtered)
+            candidate.resize(previous.size() + 1);
+        compressed.resize(size_t { 1 } << 16);
+    }
+
+    inline png_stream_writer::~png_stream_writer()
+    {
+        if (stream_open)
+            deflateEnd(&stream);
+    }
+
+    inline void png_stream_writer::write_chunk(const char* type, const uint8_t* data, size_t size)
+    {
+        uint8_t length[4] = { static_cast<uint8_t>(size >> 24), static_cast<uint8_t>(size >> 16), static_cast<uint8_t>(size >> 8), static_cast<uint8_t>(size) };
+
+        uLong crc = crc32(0, reinterpret_cast<const Bytef*>(type), 4);
+        // zlib takes a null buffer as a request for the initial value, empty chunks skip it.
+        if (size > 0)
+            crc = crc32(crc, data, static_cast<uInt>(size));
+        uint8_t crc_bytes[4] = { static_cast<uint8_t>(crc >> 24), static_cast<uint8_t>(crc >> 16), static_cast<uint8_t>(crc >> 8), static_cast<uint8_t>(crc) };
+
+        out.write(reinterpret_cast<const char*>(length), 4);
+        out.write(type, 4);
+        out.write(reinterpret_cast<const char*>(data), size);
+        out.write(reinterpret_cast<const char*>(crc_bytes), 4);
+    }
+
+    inline bool png_stream_writer::deflate_row(const uint8_t* row, size_t size, int flush)
+    {
+        stream.next_in = const_cast<Bytef*>(row);
+        stream.avail_in = static_cast<uInt>(size);
+
+        // Every full output buffer becomes an IDAT chunk, so nothing but the buffer is kept.
+        while (true)
+        {
+            stream.next_out = compressed.data();
+            stream.avail_out = static_cast<uInt>(compressed.size());
+
+            int result = deflate(&stream, flush);
+            if (result == Z_STREAM_ERROR)
+                return false;
+
+            size_t produced = compressed.size() - stream.avail_out;
+            if (produced > 0)
+                write_chunk("IDAT", compressed.data(), produced);
+
+            if (flush == Z_FINISH ? result == Z_STREAM_END : stream.avail_out != 0)
+                return out.good();
+        }
+    }
+
+    inline bool png_stream_writer::write_row(const math::color3* colors, const float* const* layers)
+    {
+        if (!stream_open || rows_left == 0)
+            return false;
+        rows_left--;
+
+        for (uint32_t i = 0; i < width; i++)
+        {
+            current[i * 3 + 0] = detail::to_byte(colors[i].r);
+            current[i * 3 + 1] = detail::to_byte(colors[i].g);
+            current[i * 3 + 2] = detail::to_byte(colors[i].b);
+        }
+
+        // Pick the filter whose output has the smallest sum of absolute values, as libpng does.
+        size_t best = 0;
+        uint64_t best_sum = UINT64_MAX;
+
+        for (size_t filter = 0; filter < filtered.size(); filter++)
+        {
+            auto& candidate = filtered[filter];
+            candidate[0] = static_cast<uint8_t>(filter);
+            uint64_t sum = 0;
+
+            for (size_t i = 0; i < current.size(); i++)
+            {
+                int left = i >= 3 ? current[i - 3] : 0;
+                int up = previous[i];
+                int up_left = i >= 3 ? previous[i - 3] : 0;
+                int predicted = 0;
+
+                if (filter == 1)
+                    predicted = left;
+                else if (filter == 2)
+                    predicted = up;
+                else if (filter == 3)
+                    predicted = (left + up) / 2;
+                else if (filter == 4)
+                {
+                    int p = left + up - up_left;
+                    int distance_left = std::abs(p - left);
+                    int distance_up = std::abs(p - up);
+                    int distance_up_left = std::abs(p - up_left);
+                    predicted = distance_left <= distance_up && distance_left <= distance_up_left ? left : distance_up <= distance_up_left ? up : up_left;
+                }
+
+                uint8_t value = static_cast<uint8_t>(current[i] - predicted);
+                candidate[i + 1] = value;
+                sum += value < 128 ? value : 256 - value;
+            }
+
+            if (sum < best_sum)
+            {
+                best_sum = sum;
+                best = filter;
+            }
+        }
+
+        previous.swap(current);
+
+        return deflate_row(filtered[best].data(), filtered[best].size(), Z_NO_FLUSH);
+    }
+
+    inline bool png_stream_writer::close()
+    {
+        if (!stream_open || rows_left != 0 || !deflate_row(nullptr, 0, Z_FINISH))
+            return false;
+
+        write_chunk("IEND", nullptr, 0);
+        out.flush();
+        return out.good();
+    }
+
+    inline exr_stream_writer::exr_stream_writer(std::ostream& out, uint32_t width, uint32_t height, const std::vector<std::string>& layer_names, exr_writer::settings options)
+        : writer(options), width(width), layer_count(layer_names.size())
+    {
+        std::vector<std::string> names { "R", "G", "B" };
+        names.insert(names.end(), layer_names.begin(), layer_names.end());
+        opened = writer.open(out, names, width, height);
+
+        rgb.resize(static_cast<size_t>(width) * 3);
+        channels.resize(names.size());
+        for (uint32_t c = 0; c < 3; c++)
+            channels[c] = rgb.data() + c * width;
+    }
+
+    inline bool exr_stream_writer::write_row(const math::color3* colors, const float* const* layers)
+    {
+        // Image data is gamma corrected, EXR files hold linear values.
+        for (uint32_t i = 0; i < width; i++)
+        {
+            rgb[i] = static_cast<float>(colors[i].r * colors[i].r);
+            rgb[width + i] = static_cast<float>(colors[i].g * colors[i].g);
+            rgb[2 * width + i] = static_cast<float>(colors[i].b * colors[i].b);
+        }
+
+        for (size_t layer = 0; layer < layer_count; layer++)
+            channels[3 + layer] = layers[layer];
+
+        return writer.write_row(channels.data());
+    }
+
+    inline bool exr_stream_writer::close()
+    {
+        return writer.close();
+    }
+
+    inline std::unique_ptr<stream_writer> make_stream_writer(image_type file_type, std::ostream& out, uint32_t width, uint32_t height, const std::vector<std::string>& layer_names, exr_writer::settings exr_options)
+    {
+        std::unique_ptr<stream_writer> writer {};
+
+        switch (file_type)
+        {
+        case image_type::PPM:
+            writer = std::make_unique<ppm_stream_writer>(out, width, height);
+            break;
+        case image_type::PNG:
+            writer = std::make_unique<png_stream_writer>(out, width, height);
+            break;
+        case image_type::EXR:
+        {
+            auto exr = std::make_unique<exr_stream_writer>(out, width, height, layer_names, exr_options);
+            if (exr->good())
+                writer = std::move(exr);
+            break;
+        }
+        default:
+            break;
+        }
+
+        if (!out.good())
+            return nullptr;
+
+        return writer;
+    }
+}
+
+#endif // IMAGE_STREAM_WRITER_HPP
@@ -5,8 +5,27 @@
 #include "scene/hittable_list.hpp"
 #include "scene/sphere.hpp"
 #include "scene/camera.hpp"
+#include "scene/bvh.hpp"
+#include "scene/sphere_scene.hpp"
+#include "scene/orbit_controller.hpp"
+#include "scene/procedural_scene.hpp"
+#include "scene/scene_loader.hpp"
+#include "image/image_checksum.hpp"
 #include "image/image_exporter.hpp"
+#include "image/stream_writer.hpp"
 #include "graphics/cpu_renderer.hpp"
+#include "graphics/aov_buffers.hpp"
+#include "graphics/bucket_renderer.hpp"
+#include "graphics/checkpoint.hpp"
+#include "graphics/denoiser.hpp"
+#include "graphics/framebuffer.hpp"
+#include "graphics/progressive_renderer.hpp"
+#include "graphics/thread_pool.hpp"
+#include "graphics/tile.hpp"
+#include "distributed/coordinator.hpp"
+#include "distributed/worker.hpp"
+#include "server/render_server.hpp"
+#include "stats/render_stats.hpp"
 
 // ImGui includes
 #include "imgui.h"
@@ -21,12 +40,28 @@
 
 // STL includes
 #include <stdio.h>
+#include <cfloat>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
 #include <thread>
 
 // External includes
 #include <argparse/argparse.hpp>
 
 void setup_args(int argc, char** argv, argparse::ArgumentParser& argparse);
+uint64_t render_settings_hash(const jmrtiow::scene::scene_description& description, const jmrtiow::math::point3& lookfrom, const jmrtiow::math::point3& lookat, const jmrtiow::math::vec3& vup, double vfov, double aperture, double focus_distance, uint32_t max_depth);
+bool resume_checkpoint(const std::string& checkpoint_path, std::vector<jmrtiow::math::color3>& checkpoint_data, jmrtiow::graphics::aov_buffers* aovs, uint32_t image_width, uint32_t image_height, uint64_t settings, uint64_t& seed, uint32_t& tile_size, uint32_t& completed_passes, bool& aovs_restored);
+jmrtiow::graphics::progressive_renderer::pass_callback make_checkpoint_callback(jmrtiow::graphics::checkpoint_writer* checkpoints, jmrtiow::graphics::checkpoint_header header, const jmrtiow::math::color3* image_data, const jmrtiow::graphics::aov_buffers* aovs, uint32_t interval_seconds);
+int render_headless(const argparse::ArgumentParser& argparser, const jmrtiow::graphics::renderer_context& context, jmrtiow::graphics::thread_pool& pool, jmrtiow::graphics::framebuffer& image, jmrtiow::graphics::aov_buffers* aovs, jmrtiow::graphics::checkpoint_writer* checkpoints, uint64_t settings);
+int render_buckets(const argparse::ArgumentParser& argparser, const jmrtiow::graphics::renderer_context& context, jmrtiow::graphics::thread_pool& pool, uint32_t image_width, uint32_t image_height, uint64_t seed, uint32_t tile_size);
+jmrtiow::image::exr_writer::settings exr_settings(const argparse::ArgumentParser& argparser);
+jmrtiow::scene::procedural_settings procedural_scene_settings(const argparse::ArgumentParser& argparser);
+void aov_layer_values(const jmrtiow::graphics::aov_buffers& aovs, size_t pixel, float* values);
+
+// EXR layers of the first hit outputs, in the order aov_layer_values fills them.
+const std::vector<std::string> aov_layer_names { "albedo.R", "albedo.G", "albedo.B", "N.X", "N.Y", "N.Z", "Z", "samples", "variance" };
 
 int main(int argc, char** argv)
 {
@@ -39,108 +74,196 @@ int main(int argc, char** argv)
     std::string image_type_string = argparser.get("--image-type");
     image::image_type image_type_selection = image::image_type::Unknown;
     std::string scene_type = argparser.get<std::string>("--scene");
+    uint64_t seed = argparser.get<uint64_t>("--seed");
 
     // Image
 
-    const double aspect_ratio = 3.0 / 2.0;
-    const uint32_t image_width = 720;
-    const uint32_t image_height = static_cast<int>(image_width / aspect_ratio);
+    const uint32_t image_width = std::max(argparser.get<uint32_t>("--width"), 2u);
+    const uint32_t image_height = argparser.get<uint32_t>("--height") > 1 ? argparser.get<uint32_t>("--height") : static_cast<uint32_t>(image_width / (3.0 / 2.0));
+    const double aspect_ratio = static_cast<double>(image_width) / image_height;
     const uint32_t samples_per_pixel = 1;
     const uint32_t max_depth = 25;
 
     // World
 
-    scene::hittable_list world;
-    if (scene_type.compare("demo2") == 0)
-        world = scene::demo_scene2();
-    else if (scene_type.compare("demo") == 0)
-        world = scene::demo_scene();
-    else
-        world = scene::random_scene();
+    scene::texture_cache::shared()->set_budget(static_cast<size_t>(argparser.get<uint32_t>("--texture-cache-mb")) << 20);
+
+    // A render server builds the scenes its clients ask for instead of the one of the command line.
+    std::string socket_path = argparser.get<std::string>("--serve");
+    if (!socket_path.empty())
+    {
+        server::render_server render_server(server::server_settings {
+            .socket_path = socket_path,
+            .thread_count = argparser.get<uint32_t>("--threads"),
+            .cached_scenes = argparser.get<uint32_t>("--scene-cache"),
+            .isa = argparser.get<std::string>("--isa"),
+        });
+
+        return render_server.run();
+    }
+
+    auto build_start = std::chrono::steady_clock::now();
+
+    scene::scene_description description {
+        .name = scene_type,
+        .texture = argparser.get<std::string>("--texture"),
+        .procedural = procedural_scene_settings(argparser),
+        .shutter = math::interval(argparser.get<double>("--shutter-open"), argparser.get<double>("--shutter-close")),
+        .flatten = argparser.get<std::string>("--kernel").compare("generic") != 0,
+    };
+
+    scene::loaded_scene loaded {};
+    if (!scene::load_scene(description, loaded))
+        return 1;
 
     math::point3 lookfrom(13, 2, 3);
     math::point3 lookat(0, 0, 0);
     math::vec3 vup(0, 1, 0);
+    auto vfov = 20.0;
     auto dist_to_focus = 10.0;
     auto aperture = 0.1;
 
-    scene::camera cam(lookfrom, lookat, vup, 20, aspect_ratio, aperture, dist_to_focus);
-
-    // Render
-
-    // Image data as R,G,B math::vec3, no alpha.
+    scene::camera cam(lookfrom, lookat, vup, vfov, aspect_ratio, aperture, dist_to_focus, description.shutter);
 
-    math::color3* image_data = new math::color3[image_height * image_width];
-    math::color3** image_data_reference = &image_data;
+    // Kernels are compiled for several instruction sets, the newest this CPU runs is used unless one is forced.
+    graphics::isa_level isa = graphics::detect_isa();
+    std::string isa_choice = argparser.get<std::string>("--isa");
+    if (isa_choice.compare("auto") != 0 && (!graphics::parse_isa(isa_choice, isa) || !graphics::isa_supported(isa)))
+    {
+        std::cerr << "This build or CPU can not run the " << isa_choice << " kernels\n";
+        return 1;
+    }
 
-    for (size_t i = 0; i < image_height * image_width; i++)
+    if (argparser.get<bool>("--headless"))
     {
-        image_data[i] = { 0.0, 0.0, 0.0 };
+        std::cerr << "Built " << loaded.world.objects.size() << " objects and their BVH in "
+                  << std::chrono::duration<double>(std::chrono::steady_clock::now() - build_start).count() << " s\n";
+        std::cerr << "Rendering with the " << graphics::isa_name(isa) << " kernels\n";
     }
 
+    // Render
 
-    bool pause = false;
-    float frame = 0;
+    graphics::render_control control {};
 
     // Create rt rendering context and renderer.
     // TODO: Enable switching of multiple renderers.
     graphics::renderer_context rt_context {
-        .camera = &cam,
-        .scene = &world,
         .max_depth = max_depth,
         .samples_per_pixel = samples_per_pixel,
-        .pause = &pause,
-        .blend_callback = [](const math::color3& a, const math::color3& b, const uint32_t& iteration)->math::color3
-        {
-            uint32_t n = iteration + 1;
-            return a * (n - 1) / n + b / n;
-        },
+        .control = &control,
+        .scene = loaded.bvh.get(),
+        .spheres = loaded.flattened ? &loaded.spheres : nullptr,
+        .isa = isa,
+        .lights = loaded.lights.objects.empty() ? nullptr : &loaded.lights,
+        .background = loaded.background,
+        .camera = &cam,
     };
 
-    graphics::cpu_renderer rt_renderer {};
+    // Worker processes spawned by a distributed headless render serve tiles and exit.
+    int worker_fd = argparser.get<int>("--worker-fd");
+    if (worker_fd >= 0)
+        return distributed::run_worker(worker_fd, rt_context, image_width, image_height);
+
+    // Render threads, headless renders use every core by default and interactive ones leave some for the UI.
+    bool headless = argparser.get<bool>("--headless");
+    uint32_t thread_count = argparser.get<uint32_t>("--threads");
+    if (thread_count == 0)
+        thread_count = headless ? std::thread::hardware_concurrency() : std::thread::hardware_concurrency() * 0.75f;
+
+    graphics::thread_pool pool(thread_count, argparser.get<bool>("--pin-threads"));
+
+    // Bucket renders only ever hold a band of the image, they never allocate the whole framebuffer.
+    if (headless && argparser.get<bool>("--buckets"))
+        return render_buckets(argparser, rt_context, pool, image_width, image_height, seed, argparser.get<uint32_t>("--tile-size"));
 
-    uint32_t threads_supported = std::thread::hardware_concurrency() * 0.75f;
-    std::vector<std::thread> work_threads {};
-    work_threads.reserve(threads_supported);
-    for (size_t i = 1; i < threads_supported + 1; i++)
+    uint32_t tile_size = argparser.get<uint32_t>("--tile-size");
+    uint32_t completed_passes = 0;
+    bool resume = argparser.get<bool>("--resume");
+    std::string framebuffer_path = argparser.get<std::string>("--framebuffer");
+
+    // First hit albedo, normal and depth, which guide the denoiser, and the sample statistics of
+    // every pixel, kept for the interactive denoiser preview, --denoise and the AOV layers of EXR
+    // files written in-process. Checkpoints keep them with the image.
+    bool keep_aovs = !headless
+        || (argparser.get<uint32_t>("--workers") == 0
+            && (argparser.get<bool>("--denoise") || image::image_type_from_string(argparser.get("--image-type")) == image::image_type::EXR));
+    std::unique_ptr<graphics::aov_buffers> aovs = keep_aovs ? std::make_unique<graphics::aov_buffers>(image_width, image_height) : nullptr;
+
+    // A mapped framebuffer resumes from its own file. A checkpoint is read before the framebuffer
+    // is created, as it decides the seed and tile size.
+    std::vector<math::color3> checkpoint_data {};
+    std::string checkpoint_path = argparser.get<std::string>("--checkpoint");
+    uint64_t settings = render_settings_hash(description, lookfrom, lookat, vup, vfov, aperture, dist_to_focus, max_depth);
+    bool aovs_restored = true;
+    if (!checkpoint_path.empty() && resume && framebuffer_path.empty()
+        && !resume_checkpoint(checkpoint_path, checkpoint_data, aovs.get(), image_width, image_height, settings, seed, tile_size, completed_passes, aovs_restored))
+        return 1;
+
+    // Image data as R,G,B math::vec3, no alpha.
+
+    graphics::framebuffer image_buffer(pool, image_width, image_height, tile_size, seed, framebuffer_path, resume);
+    if (!image_buffer.is_open())
+        return 1;
+
+    math::color3* image_data = image_buffer.data();
+    if (!checkpoint_data.empty())
     {
-        // Should change this from a lambda to its own function for clarity.
-        uint32_t local_image_range = image_width / threads_supported;
-        uint32_t local_image_height = image_height;
-        uint32_t local_image_width = local_image_range * i;
-        uint32_t local_image_start = local_image_width - local_image_range;
-
-        // On the last thread, we should set the height and range to the height of the image.
-        if (i == threads_supported)
-            local_image_width = image_width;
-
-        std::cout << "Info for thread " << i << ":\n";
-        std::cout << "image range: " << local_image_range << "\n";
-        std::cout << "image height: " << local_image_height << "\n";
-        std::cout << "image start: " << local_image_start << "\n";
-        std::cout << "image width: " << local_image_width << "\n";
-        work_threads.emplace_back([&rt_renderer, &rt_context, image_data_reference, &pause, &frame, threads_supported, image_height, image_width, local_image_width, local_image_height, local_image_start, local_image_range]()
-            {
-                graphics::view_context local_view_context {
-                    .data = image_data_reference,
-                    .iteration = 0,
-                    .data_height = image_height,
-                    .data_width = image_width,
-                    .x = local_image_start,
-                    .y = 0,
-                    .height = local_image_height,
-                    .width = local_image_range
-                };
-
-                while (!pause)
-                {
-                    rt_renderer.render(rt_context, local_view_context);
-                    frame += (1.0f / threads_supported);
-                    local_view_context.iteration++;
-                }
-            });
+        std::copy(checkpoint_data.begin(), checkpoint_data.end(), image_data);
+        image_buffer.set_passes(completed_passes);
+        checkpoint_data = {};
+    }
+
+    // A mapped framebuffer does not hold the AOV sums, after resuming one they would only count the
+    // new samples. Its own file already keeps the render, so it is not checkpointed either.
+    bool resumed_framebuffer = resume && !framebuffer_path.empty();
+    bool aovs_complete = aovs != nullptr && aovs_restored && !resumed_framebuffer;
+    if (resumed_framebuffer)
+    {
+        if (aovs != nullptr)
+            std::cerr << "A resumed framebuffer has no AOV sums, leaving out the denoiser and the EXR AOV layers until the image restarts\n";
+        if (!checkpoint_path.empty())
+            std::cerr << "The resumed framebuffer keeps the render, ignoring --checkpoint\n";
+        checkpoint_path.clear();
     }
 
+    std::unique_ptr<graphics::checkpoint_writer> checkpoints {};
+    if (!checkpoint_path.empty())
+        checkpoints = std::make_unique<graphics::checkpoint_writer>(checkpoint_path);
+
+    if (headless)
+        return render_headless(argparser, rt_context, pool, image_buffer, aovs_complete ? aovs.get() : nullptr, checkpoints.get(), settings);
+
+    graphics::cpu_renderer rt_renderer {};
+
+    graphics::progressive_renderer progressive_renderer(rt_renderer, rt_context, image_buffer, aovs.get());
+
+    // The render pool is busy for the whole session, the preview is denoised on the cores it leaves free.
+    graphics::thread_pool post_pool(std::max<int>(std::thread::hardware_concurrency() - pool.size(), 1));
+    graphics::denoiser preview_denoiser(image_width, image_height);
+    std::vector<math::color3> denoised(static_cast<size_t>(image_width) * image_height);
+    bool denoise_preview = false;
+    uint32_t denoised_passes = UINT32_MAX;
+
+    graphics::checkpoint_header checkpoint_base {
+        .magic = graphics::checkpoint_magic,
+        .version = graphics::checkpoint_version,
+        .width = image_width,
+        .height = image_height,
+        .tile_size = image_buffer.tile_size(),
+        .passes = 0,
+        .aov_sums = 0,
+        .reserved = 0,
+        .seed = image_buffer.seed(),
+        .settings = settings,
+    };
+    auto on_pass_complete = make_checkpoint_callback(checkpoints.get(), checkpoint_base, image_data, aovs_complete ? aovs.get() : nullptr, argparser.get<uint32_t>("--checkpoint-interval"));
+
+    // The pool threads render, this one only waits for them to stop.
+    std::thread render_thread([&progressive_renderer, &pool, on_pass_complete]()
+        {
+            progressive_renderer.run(pool, UINT32_MAX, on_pass_complete);
+        });
+
     // Setup SDL
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_GAMECONTROLLER) != 0)
     {
@@ -213,6 +336,17 @@ int main(int argc, char** argv)
 
     std::cout << "Image width " << image_width << " height " << image_height << '\n';
 
+    // A checkpoint does not record the camera, so navigation is off while checkpointing.
+    bool navigation_enabled = checkpoints == nullptr;
+    scene::orbit_controller controls(lookfrom, lookat, vup);
+    const uint32_t preview_block = 4;
+
+    // Rates are measured over about a second of published counters.
+    stats::counters rate_totals = stats::registry::global().totals();
+    auto rate_start = std::chrono::steady_clock::now();
+    double samples_per_second = 0.0;
+    double rays_per_second = 0.0;
+
     // Main loop
     bool done = false;
     while (!done)
@@ -222,6 +356,7 @@ int main(int argc, char** argv)
         // - When io.WantCaptureMouse is true, do not dispatch mouse input data to your main application, or clear/overwrite your copy of the mouse data.
         // - When io.WantCaptureKeyboard is true, do not dispatch keyboard input data to your main application, or clear/overwrite your copy of the keyboard data.
         // Generally you may always pass all inputs to dear imgui, and hide them from your application based on those two flags.
+        bool camera_moved = false;
         SDL_Event event;
         while (SDL_PollEvent(&event))
         {
@@ -230,6 +365,56 @@ int main(int argc, char** argv)
                 done = true;
             if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_CLOSE && event.window.windowID == SDL_GetWindowID(window))
                 done = true;
+
+            if (!navigation_enabled || io.WantCaptureMouse)
+                continue;
+
+            // Left drag orbits, right drag pans and the wheel zooms.
+            if (event.type == SDL_MOUSEMOTION && (event.motion.state & SDL_BUTTON_LMASK))
+            {
+                controls.rotate(-event.motion.xrel * 0.005, event.motion.yrel * 0.005);
+                camera_moved = true;
+            }
+            else if (event.type == SDL_MOUSEMOTION && (event.motion.state & SDL_BUTTON_RMASK))
+            {
+                controls.move(0, -event.motion.xrel * 0.002, event.motion.yrel * 0.002);
+                camera_moved = true;
+            }
+            else if (event.type == SDL_MOUSEWHEEL && event.wheel.y != 0)
+            {
+                controls.zoom(pow(0.9, event.wheel.y));
+                camera_moved = true;
+            }
+        }
+
+        // WASD moves and QE lowers or raises the camera while held, at half the orbit radius per second.
+        if (navigation_enabled && !io.WantCaptureKeyboard)
+        {
+            const Uint8* keys = SDL_GetKeyboardState(nullptr);
+            double step = 0.5 * io.DeltaTime;
+            double forward = step * (keys[SDL_SCANCODE_W] - keys[SDL_SCANCODE_S]);
+            double right = step * (keys[SDL_SCANCODE_D] - keys[SDL_SCANCODE_A]);
+            double up = step * (keys[SDL_SCANCODE_E] - keys[SDL_SCANCODE_Q]);
+
+            if (forward != 0 || right != 0 || up != 0)
+            {
+                controls.move(forward, right, up);
+                camera_moved = true;
+            }
+        }
+
+        // The camera changes once the render threads park between passes. Every move restarts
+        // with a cheap blocky preview, which refines to full resolution once the camera stops.
+        if (camera_moved)
+        {
+            // The first pass after the restart overwrites the AOV sums too.
+            aovs_complete = true;
+            control.resume();
+            progressive_renderer.restart([&cam, from = controls.lookfrom(), at = controls.lookat(), up = controls.vup(), focus = controls.distance()]()
+                {
+                    cam.look(from, at, up, focus);
+                },
+                preview_block);
         }
         if (SDL_GetWindowFlags(window) & SDL_WINDOW_MINIMIZED)
         {
@@ -256,18 +441,76 @@ int main(int argc, char** argv)
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
             ImGui::Text("Application width %.0f, height %.0f", ImGui::GetMainViewport()->Size.x, ImGui::GetMainViewport()->Size.y);
             ImGui::Text("Image stride %d", stride);
-            ImGui::Text("Active Threads %d", threads_supported);
-            ImGui::Text("Frame %.2f", frame);
+            ImGui::Text("Active Threads %u", pool.size());
+            ImGui::Text("Kernels %s", graphics::isa_name(rt_context.isa));
+            ImGui::Text("Frame %u", progressive_renderer.completed_passes());
+            if (navigation_enabled)
+                ImGui::Text("Drag to orbit, right drag to pan, wheel to zoom, WASD/QE to move");
+
+            // Paused threads wait between tiles, resuming picks the pass up where it stopped.
+            if (ImGui::Button(control.paused() ? "Resume" : "Pause"))
+            {
+                if (control.paused())
+                    control.resume();
+                else
+                    control.pause();
+            }
+
+            stats::counters totals = stats::registry::global().totals();
+            auto now = std::chrono::steady_clock::now();
+            double rate_seconds = std::chrono::duration<double>(now - rate_start).count();
+            if (rate_seconds >= 1.0)
+            {
+                samples_per_second = (totals.samples - rate_totals.samples) / rate_seconds;
+                rays_per_second = (totals.rays + totals.shadow_rays - rate_totals.rays - rate_totals.shadow_rays) / rate_seconds;
+                rate_totals = totals;
+                rate_start = now;
+            }
+
+            if (ImGui::CollapsingHeader("Statistics", ImGuiTreeNodeFlags_DefaultOpen))
+            {
+                uint64_t traced = totals.rays + totals.shadow_rays;
+                ImGui::Text("Samples/s %.3g, rays/s %.3g", samples_per_second, rays_per_second);
+                ImGui::Text("Rays %llu (%llu shadow)", static_cast<unsigned long long>(traced), static_cast<unsigned long long>(totals.shadow_rays));
+                ImGui::Text("BVH nodes/ray %.2f, primitive tests/ray %.2f", traced > 0 ? static_cast<double>(totals.bvh_nodes) / traced : 0.0, traced > 0 ? static_cast<double>(totals.primitive_tests) / traced : 0.0);
+                ImGui::Text("Tile latency avg %.2f ms, max %.2f ms", totals.tiles > 0 ? totals.tile_nanoseconds / 1e6 / totals.tiles : 0.0, totals.max_tile_nanoseconds / 1e6);
+
+                float bounce_histogram[stats::bounce_buckets];
+                for (uint32_t i = 0; i < stats::bounce_buckets; i++)
+                {
+                    bounce_histogram[i] = static_cast<float>(totals.bounces[i]);
+                }
+                ImGui::PlotHistogram("Bounces", bounce_histogram, std::min<uint32_t>(max_depth + 1, stats::bounce_buckets), 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
+            }
+
+            if (aovs_complete)
+                ImGui::Checkbox("Denoise", &denoise_preview);
+            else
+                ImGui::Text("Denoising needs the AOVs of a restarted image, move the camera");
             ImGui::Checkbox("Toggle Demo Window", &show_demo_window);
             ImGui::End();
         }
 
+        // Denoised once per completed pass. Like the plain preview, it reads the buffers while
+        // the render threads write them, a torn pixel only lasts until the next pass.
+        const math::color3* display_data = image_data;
+        if (denoise_preview && aovs_complete)
+        {
+            uint32_t passes_now = progressive_renderer.completed_passes();
+            if (passes_now != denoised_passes)
+            {
+                preview_denoiser.denoise(post_pool, image_data, *aovs, denoised.data());
+                denoised_passes = passes_now;
+            }
+            display_data = denoised.data();
+        }
+
         // Rendering
         ImGui::Render();
         SDL_RenderSetScale(renderer, io.DisplayFramebufferScale.x, io.DisplayFramebufferScale.y);
 
         // Convert double to bytes
-        auto image_bytes = jmrtiow::image::convert_to_bytes_rgba(image_data, image_width * image_height);
+        auto image_bytes = jmrtiow::image::convert_to_bytes_rgba(display_data, image_width * image_height);
 
         // Get pixels of the texture
         char* image_now;
@@ -294,11 +537,8 @@ int main(int argc, char** argv)
     }
 
     // Cleanup
-    pause = true;
-    for (size_t i = 0; i < work_threads.size(); i++)
-    {
-        work_threads[i].join();
-    }
+    control.stop();
+    render_thread.join();
 
     ImGui_ImplSDLRenderer2_Shutdown();
     ImGui_ImplSDL2_Shutdown();
@@ -311,15 +551,405 @@ int main(int argc, char** argv)
     return 0;
 }
 
+uint64_t render_settings_hash(const jmrtiow::scene::scene_description& description, const jmrtiow::math::point3& lookfrom, const jmrtiow::math::point3& lookat, const jmrtiow::math::vec3& vup, double vfov, double aperture, double focus_distance, uint32_t max_depth)
+{
+    // Only what changes the converged image, not how it is computed: thread counts, kernels and
+    // instruction sets all render the same pixels. Scene options count for the scenes that use them.
+    const jmrtiow::scene::procedural_settings& procedural = description.procedural;
+    jmrtiow::graphics::settings_hash hash {};
+    hash.add(description.name);
+    if (description.name == "earth")
+        hash.add(description.texture);
+    if (description.name == "procedural")
+        hash.add(procedural.sphere_count).add(procedural.distribution).add(procedural.diffuse_weight).add(procedural.metal_weight).add(procedural.glass_weight).add(procedural.seed);
+    hash.add(description.shutter.min).add(description.shutter.max);
+
+    for (const jmrtiow::math::vec3* v : { &lookfrom, &lookat, &vup })
+        hash.add(v->x).add(v->y).add(v->z);
+    hash.add(vfov).add(aperture).add(focus_distance).add(max_depth);
+
+    return hash.value();
+}
+
+bool resume_checkpoint(const std::string& checkpoint_path, std::vector<jmrtiow::math::color3>& checkpoint_data, jmrtiow::graphics::aov_buffers* aovs, uint32_t image_width, uint32_t image_height, uint64_t settings, uint64_t& seed, uint32_t& tile_size, uint32_t& completed_passes, bool& aovs_restored)
+{
+    using namespace jmrtiow;
+
+    graphics::checkpoint_header header;
+
+    if (!graphics::read_checkpoint(checkpoint_path, image_width, image_height, header, checkpoint_data, aovs))
+        return false;
+
+    // Samples of another scene or view would blend into this one's.
+    if (header.settings != settings)
+    {
+        std::cerr << "Checkpoint " << checkpoint_path << " was written by a render of another scene or camera\n";
+        return false;
+    }
+
+    // Keep the checkpoint's seed to continue the same sequences, and its tile size for its tile layout.
+    seed = header.seed;
+    tile_size = header.tile_size;
+    completed_passes = header.passes;
+
+    // A render that kept no AOV sums checkpointed none, the resumed ones would only count the new samples.
+    aovs_restored = aovs == nullptr || header.aov_sums != 0;
+    if (!aovs_restored)
+        std::cerr << "Checkpoint " << checkpoint_path << " has no AOV sums, leaving out the denoiser and the EXR AOV layers until the image restarts\n";
+
+    std::cerr << "Resuming from " << checkpoint_path << " at " << completed_passes << " samples per pixel\n";
+    return true;
+}
+
+jmrtiow::graphics::progressive_renderer::pass_callback make_checkpoint_callback(jmrtiow::graphics::checkpoint_writer* checkpoints, jmrtiow::graphics::checkpoint_header header, const jmrtiow::math::color3* image_data, const jmrtiow::graphics::aov_buffers* aovs, uint32_t interval_seconds)
+{
+    if (checkpoints == nullptr)
+        return {};
+
+    auto last_checkpoint = std::chrono::steady_clock::now();
+
+    return [checkpoints, header, image_data, aovs, interval_seconds, last_checkpoint](uint32_t passes) mutable
+        {
+            auto now = std::chrono::steady_clock::now();
+            if (now - last_checkpoint < std::chrono::seconds(interval_seconds))
+                return;
+
+            last_checkpoint = now;
+            header.passes = passes;
+            checkpoints->submit(header, image_data, aovs);
+        };
+}
+
+int render_headless(const argparse::ArgumentParser& argparser, const jmrtiow::graphics::renderer_context& context, jmrtiow::graphics::thread_pool& pool, jmrtiow::graphics::framebuffer& image, jmrtiow::graphics::aov_buffers* aovs, jmrtiow::graphics::checkpoint_writer* checkpoints, uint64_t settings)
+{
+    using namespace jmrtiow;
+
+    math::color3* image_data = image.data();
+    uint32_t image_width = image.width();
+    uint32_t image_height = image.height();
+    uint32_t tile_size = image.tile_size();
+    uint64_t seed = image.seed();
+
+    std::string filepath = argparser.get<std::string>("--filepath");
+    image::image_type image_type_selection = image::image_type_from_string(argparser.get("--image-type"));
+    uint32_t samples = argparser.get<uint32_t>("--samples");
+    uint32_t worker_count = argparser.get<uint32_t>("--workers");
+    std::string stats_path = argparser.get<std::string>("--stats-json");
+    bool denoise = argparser.get<bool>("--denoise");
+
+    auto start = std::chrono::steady_clock::now();
+    auto tiles = graphics::make_tiles(image_width, image_height, tile_size);
+
+    if (worker_count > 0)
+    {
+        if (checkpoints != nullptr)
+            std::cerr << "Checkpoints are only written by in-process renders, ignoring --checkpoint\n";
+        if (!stats_path.empty())
+            std::cerr << "Statistics are only counted by in-process renders, ignoring --stats-json\n";
+        if (denoise)
+            std::cerr << "Workers do not send the denoiser's guide buffers, ignoring --denoise\n";
+
+        // Workers rebuild the same world from the scene name, each tile's seed does the rest.
+        distributed::coordinator coordinator("/proc/self/exe",
+            {
+                "--scene", argparser.get<std::string>("--scene"),
+                "--sphere-count", std::to_string(argparser.get<uint64_t>("--sphere-count")),
+                "--distribution", argparser.get<std::string>("--distribution"),
+                "--material-mix", argparser.get<std::string>("--material-mix"),
+                "--scene-seed", std::to_string(argparser.get<uint64_t>("--scene-seed")),
+                "--kernel", argparser.get<std::string>("--kernel"),
+                "--isa", argparser.get<std::string>("--isa"),
+                "--texture", argparser.get<std::string>("--texture"),
+                "--texture-cache-mb", std::to_string(argparser.get<uint32_t>("--texture-cache-mb")),
+                "--shutter-open", std::format("{}", argparser.get<double>("--shutter-open")),
+                "--shutter-close", std::format("{}", argparser.get<double>("--shutter-close")),
+                "--width", std::to_string(image_width),
+                "--height", std::to_string(image_height),
+            },
+            worker_count);
+
+        if (!coordinator.render(tiles, samples, seed, image_data, image_width))
+            return 1;
+
+        image.set_passes(samples);
+    }
+    else
+    {
+        graphics::checkpoint_header checkpoint_base {
+            .magic = graphics::checkpoint_magic,
+            .version = graphics::checkpoint_version,
+            .width = image_width,
+            .height = image_height,
+            .tile_size = tile_size,
+            .passes = 0,
+            .aov_sums = 0,
+            .reserved = 0,
+            .seed = seed,
+            .settings = settings,
+        };
+
+        graphics::cpu_renderer renderer {};
+        graphics::progressive_renderer progressive_renderer(renderer, context, image, aovs);
+        progressive_renderer.run(pool, samples, make_checkpoint_callback(checkpoints, checkpoint_base, image_data, aovs, argparser.get<uint32_t>("--checkpoint-interval")));
+
+        // A finished render is checkpointed too, so it can be resumed later with more --samples.
+        if (checkpoints != nullptr)
+        {
+            checkpoint_base.passes = progressive_renderer.completed_passes();
+            checkpoints->submit(checkpoint_base, image_data, aovs);
+            checkpoints->flush();
+        }
+    }
+
+    if (worker_count == 0 && !stats_path.empty())
+    {
+        std::ofstream stats_file(stats_path);
+        stats::write_json(stats_file, stats::registry::global().totals(), std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        if (!stats_file)
+            std::cerr << "Could not write " << stats_path << '\n';
+    }
+
+    // The framebuffer keeps the raw samples, the denoised image is only exported.
+    std::vector<math::color3> denoised {};
+    const math::color3* final_data = image_data;
+    if (denoise && worker_count == 0 && aovs != nullptr)
+    {
+        denoised.resize(static_cast<size_t>(image_width) * image_height);
+        graphics::denoiser final_denoiser(image_width, image_height);
+        final_denoiser.denoise(pool, image_data, *aovs, denoised.data());
+        final_data = denoised.data();
+    }
+
+    // Rows are rendered bottom up, image files are stored top down.
+    std::vector<math::color3> export_data {};
+    export_data.reserve(static_cast<size_t>(image_width) * image_height);
+    for (uint32_t j = image_height; j-- > 0;)
+    {
+        export_data.insert(export_data.end(), final_data + j * image_width, final_data + (j + 1) * image_width);
+    }
+
+    image::image_exporter exporter {};
+    bool exported;
+    if (image_type_selection == image::image_type::EXR)
+    {
+        // Workers only send back colors, so distributed renders get the beauty layer alone, like
+        // resumed framebuffers without AOV sums.
+        std::vector<image::exr_channel> layers {};
+        if (worker_count == 0 && aovs != nullptr)
+        {
+            for (auto&& name : aov_layer_names)
+            {
+                layers.push_back(image::exr_channel { .name = name });
+                layers.back().values.reserve(export_data.size());
+            }
+
+            float values[9];
+            for (uint32_t j = image_height; j-- > 0;)
+            {
+                for (size_t i = static_cast<size_t>(j) * image_width; i < static_cast<size_t>(j + 1) * image_width; i++)
+                {
+                    aov_layer_values(*aovs, i, values);
+                    for (size_t layer = 0; layer < layers.size(); layer++)
+                        layers[layer].values.push_back(values[layer]);
+                }
+            }
+        }
+
+        exported = exporter.export_exr(filepath, export_data, std::move(layers), image_width, image_height, exr_settings(argparser));
+    }
+    else
+    {
+        exported = exporter.export_data(filepath, image_type_selection, export_data, image_width, image_height);
+    }
+
+    if (!exported)
+    {
+        std::cerr << "Could not write " << filepath << '\n';
+        return 1;
+    }
+
+    if (argparser.get<bool>("--checksum"))
+    {
+        image::image_checksum checksum {};
+        checksum.add(export_data.data(), export_data.size());
+        std::cout << std::format("Checksum {:016x}\n", checksum.value());
+    }
+
+    return 0;
+}
+
+int render_buckets(const argparse::ArgumentParser& argparser, const jmrtiow::graphics::renderer_context& context, jmrtiow::graphics::thread_pool& pool, uint32_t image_width, uint32_t image_height, uint64_t seed, uint32_t tile_size)
+{
+    using namespace jmrtiow;
+
+    std::string filepath = argparser.get<std::string>("--filepath");
+    image::image_type image_type_selection = image::image_type_from_string(argparser.get("--image-type"));
+    uint32_t samples = argparser.get<uint32_t>("--samples");
+    std::string stats_path = argparser.get<std::string>("--stats-json");
+
+    if (argparser.get<uint32_t>("--workers") > 0)
+        std::cerr << "Bucket renders run in-process, ignoring --workers\n";
+    if (!argparser.get<std::string>("--checkpoint").empty())
+        std::cerr << "Bucket renders finish each band before the next and are not checkpointed, ignoring --checkpoint\n";
+    if (argparser.get<bool>("--denoise"))
+        std::cerr << "The denoiser needs the whole image, ignoring --denoise\n";
+
+    // Only EXR files take the first hit outputs, other formats skip collecting them.
+    bool collect_aovs = image_type_selection == image::image_type::EXR;
+
+    std::ofstream file_stream(filepath, std::ios::trunc | std::ios::binary);
+    if (!file_stream.is_open())
+    {
+        std::cerr << "Could not write " << filepath << '\n';
+        return 1;
+    }
+
+    auto writer = image::make_stream_writer(image_type_selection, file_stream, image_width, image_height, collect_aovs ? aov_layer_names : std::vector<std::string> {}, exr_settings(argparser));
+    if (!writer)
+    {
+        std::cerr << "Bucket renders stream png, ppm or exr files, could not write " << filepath << '\n';
+        return 1;
+    }
+
+    // Bands are sized to give every thread a few tiles, so the end of a band leaves few of them idle.
+    tile_size = std::max<uint32_t>(tile_size, 1);
+    uint32_t tiles_per_row = (image_width + tile_size - 1) / tile_size;
+    uint32_t band_tile_rows = (4 * pool.size() + tiles_per_row - 1) / tiles_per_row;
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<float> layer_rows(collect_aovs ? aov_layer_names.size() * image_width : 0);
+    std::vector<const float*> layers {};
+    for (size_t layer = 0; layer < aov_layer_names.size() && collect_aovs; layer++)
+        layers.push_back(layer_rows.data() + layer * image_width);
+
+    image::image_checksum checksum {};
+
+    graphics::cpu_renderer renderer {};
+    graphics::bucket_renderer bucket_renderer(renderer, context, image_width, image_height, tile_size, band_tile_rows, seed, collect_aovs);
+
+    bool rendered = bucket_renderer.run(pool, samples, [&](uint32_t first_row, uint32_t row_count, const math::color3* data, const graphics::aov_buffers* aovs)
+        {
+            // Rows are rendered bottom up, image files are stored top down.
+            for (uint32_t j = row_count; j-- > 0;)
+            {
+                if (aovs != nullptr)
+                {
+                    float values[9];
+                    for (uint32_t i = 0; i < image_width; i++)
+                    {
+                        aov_layer_values(*aovs, static_cast<size_t>(j) * image_width + i, values);
+                        for (size_t layer = 0; layer < layers.size(); layer++)
+                            layer_rows[layer * image_width + i] = values[layer];
+                    }
+                }
+
+                checksum.add(data + static_cast<size_t>(j) * image_width, image_width);
+                if (!writer->write_row(data + static_cast<size_t>(j) * image_width, layers.data()))
+                    return false;
+            }
+
+            return true;
+        });
+
+    if (!rendered || !writer->close())
+    {
+        std::cerr << "Could not write " << filepath << '\n';
+        return 1;
+    }
+
+    if (argparser.get<bool>("--checksum"))
+        std::cout << std::format("Checksum {:016x}\n", checksum.value());
+
+    if (!stats_path.empty())
+    {
+        std::ofstream stats_file(stats_path);
+        stats::write_json(stats_file, stats::registry::global().totals(), std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        if (!stats_file)
+            std::cerr << "Could not write " << stats_path << '\n';
+    }
+
+    return 0;
+}
+
+jmrtiow::image::exr_writer::settings exr_settings(const argparse::ArgumentParser& argparser)
+{
+    return jmrtiow::image::exr_writer::settings {
+        .pixel_type = argparser.get<std::string>("--exr-pixel-type") == "float" ? jmrtiow::image::exr_pixel_type::float32 : jmrtiow::image::exr_pixel_type::half,
+        .tile_size = argparser.get<uint32_t>("--exr-tile-size"),
+    };
+}
+
+jmrtiow::scene::procedural_settings procedural_scene_settings(const argparse::ArgumentParser& argparser)
+{
+    double diffuse = 0.8, metal = 0.15, glass = 0.05;
+    std::string mix = argparser.get<std::string>("--material-mix");
+    if (sscanf(mix.c_str(), "%lf,%lf,%lf", &diffuse, &metal, &glass) != 3 || diffuse < 0 || metal < 0 || glass < 0)
+    {
+        std::cerr << "Material mix " << mix << " is not three non-negative weights, using 0.8,0.15,0.05\n";
+        diffuse = 0.8, metal = 0.15, glass = 0.05;
+    }
+
+    return jmrtiow::scene::procedural_settings {
+        .sphere_count = argparser.get<uint64_t>("--sphere-count"),
+        .distribution = argparser.get<std::string>("--distribution") == "clustered" ? jmrtiow::scene::sphere_distribution::clustered : jmrtiow::scene::sphere_distribution::uniform,
+        .diffuse_weight = diffuse,
+        .metal_weight = metal,
+        .glass_weight = glass,
+        .seed = argparser.get<uint64_t>("--scene-seed"),
+        .thread_count = argparser.get<uint32_t>("--threads"),
+    };
+}
+
+void aov_layer_values(const jmrtiow::graphics::aov_buffers& aovs, size_t pixel, float* values)
+{
+    jmrtiow::math::color3 albedo = aovs.mean_albedo(pixel);
+    jmrtiow::math::vec3 normal = aovs.mean_normal(pixel);
+
+    values[0] = static_cast<float>(albedo.r);
+    values[1] = static_cast<float>(albedo.g);
+    values[2] = static_cast<float>(albedo.b);
+    values[3] = static_cast<float>(normal.x);
+    values[4] = static_cast<float>(normal.y);
+    values[5] = static_cast<float>(normal.z);
+    values[6] = static_cast<float>(aovs.mean_depth(pixel));
+    values[7] = static_cast<float>(aovs.samples[pixel]);
+    values[8] = static_cast<float>(aovs.variance(pixel));
+}
+
 void setup_args(int argc, char** argv, argparse::ArgumentParser& argparser)
 {
     argparser.add_argument("--image-type", "-t")
         .default_value(std::string { "png" })
-        .choices("png", "jpg", "jpeg", "bmp", "tga", "hdr", "ppm", "webp")
+        .choices("png", "jpg", "jpeg", "bmp", "tga", "hdr", "ppm", "webp", "exr")
         .nargs(1)
-        .help("The type of image to output [choices: png, jpg, jpeg, bmp, tga, hdr, ppm, webp]")
+        .help("The type of image to output [choices: png, jpg, jpeg, bmp, tga, hdr, ppm, webp, exr]")
         .metavar("TYPE");
 
+    argparser.add_argument("--exr-pixel-type")
+        .default_value(std::string { "half" })
+        .choices("half", "float")
+        .help("Channel type of EXR output, which also holds the albedo, normal, depth, sample count and variance layers")
+        .metavar("TYPE");
+
+    argparser.add_argument("--exr-tile-size")
+        .default_value(uint32_t { 64 })
+        .scan<'u', uint32_t>()
+        .help("Edge length in pixels of the tiles of EXR output, 0 writes scanlines")
+        .metavar("PIXELS");
+
+    argparser.add_argument("--width")
+        .default_value(uint32_t { 720 })
+        .scan<'u', uint32_t>()
+        .help("Width of the image in pixels")
+        .metavar("PIXELS");
+
+    argparser.add_argument("--height")
+        .default_value(uint32_t { 0 })
+        .scan<'u', uint32_t>()
+        .help("Height of the image in pixels, 0 for a 3:2 image")
+        .metavar("PIXELS");
+
     argparser.add_argument("--filepath", "-f")
         .default_value(std::string { "img.png" })
         .help("The file location to output to")
@@ -327,10 +957,161 @@ void setup_args(int argc, char** argv, argparse::ArgumentParser& argparser)
 
     argparser.add_argument("--scene", "-s")
         .default_value(std::string { "random" })
-        .choices("random", "demo", "demo2")
+        .choices("random", "demo", "demo2", "bouncing", "checkered", "perlin", "earth", "lights", "procedural")
         .help("The scene to render")
         .metavar("SCENE");
 
+    argparser.add_argument("--kernel")
+        .default_value(std::string { "auto" })
+        .choices("auto", "generic")
+        .help("Render kernel: auto uses the inlined sphere kernel for scenes it supports, generic always traces through virtual calls")
+        .metavar("KERNEL");
+
+    argparser.add_argument("--isa")
+        .default_value(std::string { "auto" })
+        .choices("auto", "baseline", "sse4.2", "avx2", "avx512")
+        .help("Instruction set of the render kernels, auto for the newest this CPU supports")
+        .metavar("ISA");
+
+    argparser.add_argument("--sphere-count")
+        .default_value(uint64_t { 10000 })
+        .scan<'u', uint64_t>()
+        .help("Number of spheres of the procedural scene")
+        .metavar("COUNT");
+
+    argparser.add_argument("--distribution")
+        .default_value(std::string { "uniform" })
+        .choices("uniform", "clustered")
+        .help("Spread the procedural scene's spheres evenly or in clusters")
+        .metavar("DISTRIBUTION");
+
+    argparser.add_argument("--material-mix")
+        .default_value(std::string { "0.8,0.15,0.05" })
+        .help("Relative weights of diffuse, metal and glass spheres in the procedural scene")
+        .metavar("DIFFUSE,METAL,GLASS");
+
+    argparser.add_argument("--scene-seed")
+        .default_value(uint64_t { 0 })
+        .scan<'u', uint64_t>()
+        .help("Seed of the procedural scene")
+        .metavar("SEED");
+
+    argparser.add_argument("--texture")
+        .default_value(std::string { "earthmap.jpg" })
+        .help("Image wrapped around the sphere of the earth scene")
+        .metavar("PATH");
+
+    argparser.add_argument("--texture-cache-mb")
+        .default_value(uint32_t { 1024 })
+        .scan<'u', uint32_t>()
+        .help("Memory budget of the image texture cache, least recently used tiles are dropped beyond it")
+        .metavar("MEGABYTES");
+
+    argparser.add_argument("--shutter-open")
+        .default_value(0.0)
+        .scan<'g', double>()
+        .help("Time the camera shutter opens, rays are spread over the open interval for motion blur")
+        .metavar("TIME");
+
+    argparser.add_argument("--shutter-close")
+        .default_value(1.0)
+        .scan<'g', double>()
+        .help("Time the camera shutter closes")
+        .metavar("TIME");
+
+    argparser.add_argument("--headless")
+        .flag()
+        .help("Render without a window and write the image to --filepath");
+
+    argparser.add_argument("--buckets")
+        .flag()
+        .help("Render a headless image in bands of tiles, each finished and streamed to a png, ppm or exr file before the next, so memory does not grow with the image");
+
+    argparser.add_argument("--checksum")
+        .flag()
+        .help("Print a hash of the pixels of a headless render, equal for equal images whatever the threads, workers, tiles or buckets");
+
+    argparser.add_argument("--denoise")
+        .flag()
+        .help("Denoise a headless render before writing it");
+
+    argparser.add_argument("--samples")
+        .default_value(uint32_t { 64 })
+        .scan<'u', uint32_t>()
+        .help("Samples per pixel of a headless render")
+        .metavar("COUNT");
+
+    argparser.add_argument("--seed")
+        .default_value(uint64_t { 0 })
+        .scan<'u', uint64_t>()
+        .help("Base seed of the per-pixel random sequences, equal seeds give equal images")
+        .metavar("SEED");
+
+    argparser.add_argument("--threads")
+        .default_value(uint32_t { 0 })
+        .scan<'u', uint32_t>()
+        .help("Number of render threads, 0 for all cores in headless mode and three quarters of them otherwise")
+        .metavar("N");
+
+    argparser.add_argument("--pin-threads")
+        .flag()
+        .help("Pin each render thread to a CPU, filling one NUMA node before the next");
+
+    argparser.add_argument("--tile-size")
+        .default_value(uint32_t { 32 })
+        .scan<'u', uint32_t>()
+        .help("Edge length in pixels of the tiles a headless render is split into")
+        .metavar("PIXELS");
+
+    argparser.add_argument("--workers")
+        .default_value(uint32_t { 0 })
+        .scan<'u', uint32_t>()
+        .help("Number of worker processes to distribute a headless render across (0 renders in-process)")
+        .metavar("COUNT");
+
+    argparser.add_argument("--checkpoint")
+        .default_value(std::string { "" })
+        .help("Periodically save the accumulated image and sample count of in-process renders to this file")
+        .metavar("PATH");
+
+    argparser.add_argument("--checkpoint-interval")
+        .default_value(uint32_t { 60 })
+        .scan<'u', uint32_t>()
+        .help("Minimum number of seconds between checkpoints")
+        .metavar("SECONDS");
+
+    argparser.add_argument("--resume")
+        .flag()
+        .help("Continue sampling from the --framebuffer file, or else from the --checkpoint file");
+
+    argparser.add_argument("--framebuffer")
+        .default_value(std::string { "" })
+        .help("Keep the accumulated image in this memory mapped file, which other processes can read while rendering")
+        .metavar("PATH");
+
+    argparser.add_argument("--stats-json")
+        .default_value(std::string { "" })
+        .help("Write render statistics of a headless render to this JSON file")
+        .metavar("PATH");
+
+    argparser.add_argument("--serve")
+        .default_value(std::string { "" })
+        .help("Run as a render server on this Unix domain socket, rendering the jobs rtiow_client sends instead of --scene")
+        .metavar("SOCKET");
+
+    argparser.add_argument("--scene-cache")
+        .default_value(uint32_t { 4 })
+        .scan<'u', uint32_t>()
+        .help("Number of built scenes and BVHs a render server keeps between jobs")
+        .metavar("N");
+
+    argparser.add_argument("--worker-fd")
+        .default_value(-1)
+        .scan<'i', int>()
+        .hidden()
+        .help("Internal: serve tiles to a coordinator over this socket")
+        .metavar("FD");
+
     try
     {
         argparser.parse_args(argc, argv);
@@ -29,6 +29,11 @@ namespace jmrtiow::math
             z = (a.z <= b.z) ? interval(a.z, b.z) : interval(b.z, a.z);
         }
 
+        aabb(const aabb& box0, const aabb& box1)
+            : x(box0.x, box1.x), y(box0.y, box1.y), z(box0.z, box1.z)
+        {
+        }
+
         const interval& axis_interval(int n) const
         {
             if (n == 1) return y;
@@ -36,6 +41,20 @@ namespace jmrtiow::math
             return x;
         }
 
+        int longest_axis() const
+        {
+            // Returns the index of the longest axis of the bounding box.
+            if (x.size() > y.size())
+                return x.size() > z.size() ? 0 : 2;
+            else
+                return y.size() > z.size() ? 1 : 2;
+        }
+
+        point3 centroid() const
+        {
+            return point3((x.min + x.max) / 2, (y.min + y.max) / 2, (z.min + z.max) / 2);
+        }
+
         bool hit(const ray& r, interval ray_t) const
         {
             const point3& ray_orig = r.origin();
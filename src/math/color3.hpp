@@ -0,0 +1,126 @@
+#ifndef MATH_COLOR3_HPP
+#define MATH_COLOR3_HPP
+
+#include <cmath>
+#include <iostream>
+
+#include "simd.hpp"
+
+namespace jmrtiow::math
+{
+    /// @brief RGB color padded to four lanes and aligned to them, so a color fills exactly one 256-bit
+    /// register, or two 128-bit ones, and every operation is a whole-register instruction of the simd
+    /// backend. The padding lane is kept at zero.
+    class alignas(4 * sizeof(double)) color3
+    {
+    public:
+        static constexpr int lanes = 4;
+
+        // Fields
+
+        union
+        {
+            double data[lanes];
+            struct
+            {
+                double r;
+                double g;
+                double b;
+                double padding;
+            };
+        };
+
+        // Constructors
+
+        color3() : data { 0, 0, 0, 0 } {}
+        color3(double r, double g, double b) : data { r, g, b, 0 } {}
+
+        // Operators
+
+        double operator[](int i) const { return data[i]; }
+        double& operator[](int i) { return data[i]; }
+
+        color3& operator+=(const color3& c)
+        {
+            simd::add(data, c.data, data);
+            return *this;
+        }
+
+        color3& operator*=(const color3& c)
+        {
+            simd::mul(data, c.data, data);
+            return *this;
+        }
+
+        color3& operator*=(double t)
+        {
+            simd::scale(data, t, data);
+            return *this;
+        }
+
+        color3& operator/=(double t)
+        {
+            return *this *= 1 / t;
+        }
+
+        // Utility Functions
+
+        inline static color3 random()
+        {
+            return color3(random_double(), random_double(), random_double());
+        }
+
+        inline static color3 random(double min, double max)
+        {
+            return color3(random_double(min, max), random_double(min, max), random_double(min, max));
+        }
+    };
+
+    static_assert(sizeof(color3) == color3::lanes * sizeof(double));
+
+    // Utility Functions
+    inline std::ostream& operator<<(std::ostream& out, const color3& c)
+    {
+        return out << c.r << ' ' << c.g << ' ' << c.b;
+    }
+
+    inline color3 operator+(const color3& u, const color3& v)
+    {
+        color3 c;
+        simd::add(u.data, v.data, c.data);
+        return c;
+    }
+
+    inline color3 operator-(const color3& u, const color3& v)
+    {
+        color3 c;
+        simd::sub(u.data, v.data, c.data);
+        return c;
+    }
+
+    inline color3 operator*(const color3& u, const color3& v)
+    {
+        color3 c;
+        simd::mul(u.data, v.data, c.data);
+        return c;
+    }
+
+    inline color3 operator*(double t, const color3& u)
+    {
+        color3 c;
+        simd::scale(u.data, t, c.data);
+        return c;
+    }
+
+    inline color3 operator*(const color3& u, double t)
+    {
+        return t * u;
+    }
+
+    inline color3 operator/(const color3& u, double t)
+    {
+        return (1 / t) * u;
+    }
+}
+
+#endif // MATH_COLOR3_HPP
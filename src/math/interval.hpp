@@ -13,6 +13,12 @@ namespace jmrtiow::math
 
         interval(double min, double max) : min(min), max(max) {}
 
+        interval(const interval& a, const interval& b)
+            : min(fmin(a.min, b.min)), max(fmax(a.max, b.max))
+        {
+            // Create the interval tightly enclosing the two input intervals.
+        }
+
         double size() const
         {
             return max - min;
@@ -38,8 +44,8 @@ namespace jmrtiow::math
         static const interval universe;
     };
 
-    const interval interval::empty = interval(+infinity, -infinity);
-    const interval interval::universe = interval(-infinity, +infinity);
+    inline const interval interval::empty = interval(+infinity, -infinity);
+    inline const interval interval::universe = interval(-infinity, +infinity);
 }
 
 #endif //MATH_INTERVAL_HPP
@@ -10,19 +10,26 @@ namespace jmrtiow::math
     public:
         point3 orig;
         vec3 dir;
+        double tm;
+        double sprd;
 
-        ray() {}
-        ray(const point3& origin, const vec3& direction)
-            : orig(origin), dir(direction)
+        ray() : tm(0), sprd(0) {}
+        ray(const point3& origin, const vec3& direction, double time = 0.0, double spread = 0.0)
+            : orig(origin), dir(direction), tm(time), sprd(spread)
         {
         }
 
         point3 origin() const { return orig; }
         vec3 direction() const { return dir; }
+        double time() const { return tm; }
+
+        // Growth of the ray's footprint per unit of distance along direction(), i.e. the
+        // angle one pixel subtends. Used to pick texture detail, 0 means sharpest.
+        double spread() const { return sprd; }
 
         point3 at(double t) const
         {
-            return orig + t * dir;
+            return mul_add(dir, t, orig);
         }
     };
 }
@@ -0,0 +1,229 @@
+#ifndef MATH_SIMD_HPP
+#define MATH_SIMD_HPP
+
+#include <cmath>
+
+// GCC and Clang write the vector backend with their vector types of four doubles. These compile to the
+// widest registers of the function they are inlined into: two SSE2 instructions per operation in code
+// built for baseline x86-64, one AVX instruction in the render kernels compiled for AVX2 or AVX-512 (see
+// the target tags below), so every kernel version gets the vector math of its own instruction set from
+// the same source. Other compilers use AVX intrinsics if the build targets AVX, SSE2 ones on any other
+// x86-64, and plain C++ elsewhere. Defining JMRTIOW_SCALAR_MATH forces plain C++, which is the
+// reference the vector paths must match.
+//
+// A default x86-64 build gets SSE2 without fused multiply-adds; AVX and FMA for the whole program need
+// -mavx and -mfma (or -march=native) in CMAKE_CXX_FLAGS, and CMake reports the backend it configured.
+// -ffp-contract=off, which the build always passes, only stops the compiler from fusing on its own:
+// with JMRTIOW_SIMD_FMA the explicit multiply-adds below still round once, so such builds render
+// slightly different images.
+#if !defined(JMRTIOW_SCALAR_MATH) && defined(__GNUC__)
+#define JMRTIOW_SIMD_VECTOR 1
+#elif !defined(JMRTIOW_SCALAR_MATH) && defined(__AVX__)
+#define JMRTIOW_SIMD_AVX 1
+#elif !defined(JMRTIOW_SCALAR_MATH) && (defined(__SSE2__) || defined(_M_X64))
+#define JMRTIOW_SIMD_SSE2 1
+#endif
+
+#if !defined(JMRTIOW_SCALAR_MATH) && (defined(__SSE2__) || defined(_M_X64))
+#include <immintrin.h>
+#endif
+
+#if !defined(JMRTIOW_SCALAR_MATH) && defined(__FMA__)
+#define JMRTIOW_SIMD_FMA 1
+#endif
+
+// GCC and Clang can compile a function for another x86 target than the rest of the program, so render
+// kernels get a version per instruction set. Other compilers and architectures only have the baseline.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define JMRTIOW_ISA_DISPATCH 1
+// Everything a target's run() calls is inlined into it where possible, so whole bounces are compiled for
+// the target, up to the virtual calls of generic scenes.
+#define JMRTIOW_TARGET(targets) __attribute__((target(targets), flatten))
+#endif
+
+namespace jmrtiow::math::simd
+{
+    // All functions work on four doubles aligned to 32 bytes, the storage of vec3 and color3.
+    // Lane by lane operations give exactly the results of the scalar code on every backend. Fused
+    // multiply-adds are only used when the whole build targets them, and round once instead of twice.
+
+#if defined(JMRTIOW_SIMD_AVX) || (defined(JMRTIOW_SIMD_VECTOR) && defined(__AVX__))
+    constexpr const char* backend = "avx";
+#elif defined(JMRTIOW_SIMD_SSE2) || (defined(JMRTIOW_SIMD_VECTOR) && defined(__SSE2__))
+    constexpr const char* backend = "sse2";
+#elif defined(JMRTIOW_SIMD_VECTOR)
+    constexpr const char* backend = "vector";
+#else
+    constexpr const char* backend = "scalar";
+#endif
+
+    // Target tags. Code templated on one calls into the next bounce, or any other work it wants compiled
+    // for the target, through the tag's run(); baseline_target compiles it like the rest of the program.
+
+    /// @brief Target of the flags of the whole build
+    struct baseline_target
+    {
+    public:
+        /// @brief Returns f()
+        template <typename Function>
+        static auto run(const Function& f) { return f(); }
+    };
+
+#if defined(JMRTIOW_ISA_DISPATCH)
+    struct sse42_target
+    {
+    public:
+        /// @brief Returns f(), with f and what it calls compiled for SSE4.2
+        template <typename Function>
+        JMRTIOW_TARGET("sse4.2") static auto run(const Function& f) { return f(); }
+    };
+
+    /// @brief AVX2 without FMA, so the compiler has no fused multiply-adds to round differently with
+    struct avx2_target
+    {
+    public:
+        /// @brief Returns f(), with f and what it calls compiled for AVX2
+        template <typename Function>
+        JMRTIOW_TARGET("avx2") static auto run(const Function& f) { return f(); }
+    };
+
+    /// @brief AVX-512 F, VL, DQ and BW
+    struct avx512_target
+    {
+    public:
+        /// @brief Returns f(), with f and what it calls compiled for AVX-512
+        template <typename Function>
+        JMRTIOW_TARGET("avx512f,avx512vl,avx512dq,avx512bw") static auto run(const Function& f) { return f(); }
+    };
+#endif
+
+#if defined(JMRTIOW_SIMD_VECTOR)
+    /// @brief The four lanes of a vec3 or color3
+    typedef double lanes __attribute__((vector_size(4 * sizeof(double)), aligned(4 * sizeof(double)), may_alias));
+
+    // Taken by reference, as passing vector types by value has another ABI with AVX enabled.
+    inline const lanes& as_lanes(const double* a) { return *reinterpret_cast<const lanes*>(a); }
+    inline lanes& as_lanes(double* a) { return *reinterpret_cast<lanes*>(a); }
+#endif
+
+    inline void add(const double* a, const double* b, double* out)
+    {
+#if defined(JMRTIOW_SIMD_VECTOR)
+        as_lanes(out) = as_lanes(a) + as_lanes(b);
+#elif defined(JMRTIOW_SIMD_AVX)
+        _mm256_store_pd(out, _mm256_add_pd(_mm256_load_pd(a), _mm256_load_pd(b)));
+#elif defined(JMRTIOW_SIMD_SSE2)
+        _mm_store_pd(out, _mm_add_pd(_mm_load_pd(a), _mm_load_pd(b)));
+        _mm_store_pd(out + 2, _mm_add_pd(_mm_load_pd(a + 2), _mm_load_pd(b + 2)));
+#else
+        for (int i = 0; i < 4; i++)
+            out[i] = a[i] + b[i];
+#endif
+    }
+
+    inline void sub(const double* a, const double* b, double* out)
+    {
+#if defined(JMRTIOW_SIMD_VECTOR)
+        as_lanes(out) = as_lanes(a) - as_lanes(b);
+#elif defined(JMRTIOW_SIMD_AVX)
+        _mm256_store_pd(out, _mm256_sub_pd(_mm256_load_pd(a), _mm256_load_pd(b)));
+#elif defined(JMRTIOW_SIMD_SSE2)
+        _mm_store_pd(out, _mm_sub_pd(_mm_load_pd(a), _mm_load_pd(b)));
+        _mm_store_pd(out + 2, _mm_sub_pd(_mm_load_pd(a + 2), _mm_load_pd(b + 2)));
+#else
+        for (int i = 0; i < 4; i++)
+            out[i] = a[i] - b[i];
+#endif
+    }
+
+    inline void mul(const double* a, const double* b, double* out)
+    {
+#if defined(JMRTIOW_SIMD_VECTOR)
+        as_lanes(out) = as_lanes(a) * as_lanes(b);
+#elif defined(JMRTIOW_SIMD_AVX)
+        _mm256_store_pd(out, _mm256_mul_pd(_mm256_load_pd(a), _mm256_load_pd(b)));
+#elif defined(JMRTIOW_SIMD_SSE2)
+        _mm_store_pd(out, _mm_mul_pd(_mm_load_pd(a), _mm_load_pd(b)));
+        _mm_store_pd(out + 2, _mm_mul_pd(_mm_load_pd(a + 2), _mm_load_pd(b + 2)));
+#else
+        for (int i = 0; i < 4; i++)
+            out[i] = a[i] * b[i];
+#endif
+    }
+
+    inline void scale(const double* a, double t, double* out)
+    {
+#if defined(JMRTIOW_SIMD_VECTOR)
+        as_lanes(out) = as_lanes(a) * t;
+#elif defined(JMRTIOW_SIMD_AVX)
+        _mm256_store_pd(out, _mm256_mul_pd(_mm256_load_pd(a), _mm256_set1_pd(t)));
+#elif defined(JMRTIOW_SIMD_SSE2)
+        __m128d s = _mm_set1_pd(t);
+        _mm_store_pd(out, _mm_mul_pd(_mm_load_pd(a), s));
+        _mm_store_pd(out + 2, _mm_mul_pd(_mm_load_pd(a + 2), s));
+#else
+        for (int i = 0; i < 4; i++)
+            out[i] = a[i] * t;
+#endif
+    }
+
+    /// @brief out = a * t + b
+    inline void mul_add(const double* a, double t, const double* b, double* out)
+    {
+#if defined(JMRTIOW_SIMD_FMA) && defined(__AVX__)
+        _mm256_store_pd(out, _mm256_fmadd_pd(_mm256_load_pd(a), _mm256_set1_pd(t), _mm256_load_pd(b)));
+#elif defined(JMRTIOW_SIMD_VECTOR)
+        as_lanes(out) = as_lanes(a) * t + as_lanes(b);
+#elif defined(JMRTIOW_SIMD_AVX)
+        _mm256_store_pd(out, _mm256_add_pd(_mm256_mul_pd(_mm256_load_pd(a), _mm256_set1_pd(t)), _mm256_load_pd(b)));
+#elif defined(JMRTIOW_SIMD_SSE2)
+        __m128d s = _mm_set1_pd(t);
+        _mm_store_pd(out, _mm_add_pd(_mm_mul_pd(_mm_load_pd(a), s), _mm_load_pd(b)));
+        _mm_store_pd(out + 2, _mm_add_pd(_mm_mul_pd(_mm_load_pd(a + 2), s), _mm_load_pd(b + 2)));
+#else
+        for (int i = 0; i < 4; i++)
+            out[i] = a[i] * t + b[i];
+#endif
+    }
+
+    /// @brief Dot product of the first three lanes, summed in the order of the scalar code
+    inline double dot3(const double* a, const double* b)
+    {
+#if defined(JMRTIOW_SIMD_FMA)
+        return std::fma(a[2], b[2], std::fma(a[1], b[1], a[0] * b[0]));
+#elif defined(JMRTIOW_SIMD_VECTOR)
+        lanes p = as_lanes(a) * as_lanes(b);
+        return p[0] + p[1] + p[2];
+#elif defined(JMRTIOW_SIMD_AVX)
+        __m256d p = _mm256_mul_pd(_mm256_load_pd(a), _mm256_load_pd(b));
+        __m128d xy = _mm256_castpd256_pd128(p);
+        __m128d sum = _mm_add_sd(xy, _mm_unpackhi_pd(xy, xy));
+        return _mm_cvtsd_f64(_mm_add_sd(sum, _mm256_extractf128_pd(p, 1)));
+#elif defined(JMRTIOW_SIMD_SSE2)
+        __m128d xy = _mm_mul_pd(_mm_load_pd(a), _mm_load_pd(b));
+        __m128d sum = _mm_add_sd(xy, _mm_unpackhi_pd(xy, xy));
+        return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_mul_sd(_mm_load_sd(a + 2), _mm_load_sd(b + 2))));
+#else
+        return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+#endif
+    }
+
+    /// @brief 1 / sqrt(x), from the hardware estimate refined by two Newton-Raphson steps when
+    /// JMRTIOW_FAST_RSQRT is defined, which leaves a relative error around 1e-13. The estimate is not
+    /// specified exactly and differs between CPU vendors, so the fast path is opt-in: images made
+    /// with it are only reproducible on the same kind of CPU.
+    inline double rsqrt(double x)
+    {
+#if defined(JMRTIOW_FAST_RSQRT) && !defined(JMRTIOW_SCALAR_MATH) && (defined(__SSE2__) || defined(_M_X64))
+        double y = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(static_cast<float>(x))));
+        double half_x = 0.5 * x;
+        y = y * (1.5 - half_x * y * y);
+        y = y * (1.5 - half_x * y * y);
+        return y;
+#else
+        return 1 / std::sqrt(x);
+#endif
+    }
+}
+
+#endif // MATH_SIMD_HPP
@@ -4,11 +4,15 @@
 #include <cmath>
 #include <iostream>
 
+#include "simd.hpp"
+
 namespace jmrtiow::math
 {
     using std::sqrt;
 
-    class vec3
+    /// @brief Three doubles padded to four lanes and aligned to them, so the arithmetic runs on the
+    /// vector registers of the simd backend. The padding lane is kept at zero.
+    class alignas(4 * sizeof(double)) vec3
     {
     public:
         // Fields
@@ -16,45 +20,42 @@ namespace jmrtiow::math
         union
         {
 
-            double data[3];
+            double data[4];
             struct
             {
                 double x;
                 double y;
                 double z;
-            };
-            struct
-            {
-                double r;
-                double g;
-                double b;
+                double padding;
             };
         };
 
         // Constructors
 
-        vec3() : data { 0, 0, 0 } {}
-        vec3(double x, double y, double z) : data { x, y, z } {}
+        vec3() : data { 0, 0, 0, 0 } {}
+        vec3(double x, double y, double z) : data { x, y, z, 0 } {}
 
         // Operators
 
-        vec3 operator-() const { return vec3(-x, -y, -z); }
+        vec3 operator-() const
+        {
+            vec3 v;
+            simd::scale(data, -1.0, v.data);
+            return v;
+        }
+
         double operator[](int i) const { return data[i]; }
         double& operator[](int i) { return data[i]; }
 
         vec3& operator+=(const vec3& v)
         {
-            x += v.x;
-            y += v.y;
-            z += v.z;
+            simd::add(data, v.data, data);
             return *this;
         }
 
         vec3& operator*=(const double& t)
         {
-            x *= t;
-            y *= t;
-            z *= t;
+            simd::scale(data, t, data);
             return *this;
         }
 
@@ -72,7 +73,7 @@ namespace jmrtiow::math
 
         double length_squared() const
         {
-            return x * x + y * y + z * z;
+            return simd::dot3(data, data);
         }
 
         // Utility Functions
@@ -97,7 +98,6 @@ namespace jmrtiow::math
 
     // Type aliases for vec3
     using point3 = vec3; // 3D Point
-    using color3 = vec3; // RGB Color
 
     // Utility Functions
     inline std::ostream& operator<<(std::ostream& out, const vec3& v)
@@ -107,22 +107,30 @@ namespace jmrtiow::math
 
     inline vec3 operator+(const vec3& u, const vec3& v)
     {
-        return vec3(u.x + v.x, u.y + v.y, u.z + v.z);
+        vec3 w;
+        simd::add(u.data, v.data, w.data);
+        return w;
     }
 
     inline vec3 operator-(const vec3& u, const vec3& v)
     {
-        return vec3(u.x - v.x, u.y - v.y, u.z - v.z);
+        vec3 w;
+        simd::sub(u.data, v.data, w.data);
+        return w;
     }
 
     inline vec3 operator*(const vec3& u, const vec3& v)
     {
-        return vec3(u.x * v.x, u.y * v.y, u.z * v.z);
+        vec3 w;
+        simd::mul(u.data, v.data, w.data);
+        return w;
     }
 
     inline vec3 operator*(double t, const vec3& v)
     {
-        return vec3(t * v.x, t * v.y, t * v.z);
+        vec3 w;
+        simd::scale(v.data, t, w.data);
+        return w;
     }
 
     inline vec3 operator*(const vec3& v, double t)
@@ -130,14 +138,22 @@ namespace jmrtiow::math
         return t * v;
     }
 
-    inline vec3 operator/(vec3 v, double t)
+    inline vec3 operator/(const vec3& v, double t)
     {
         return (1 / t) * v;
     }
 
+    /// @brief u * t + v, in one rounding where the target has fused multiply-adds
+    inline vec3 mul_add(const vec3& u, double t, const vec3& v)
+    {
+        vec3 w;
+        simd::mul_add(u.data, t, v.data, w.data);
+        return w;
+    }
+
     inline double dot(const vec3& u, const vec3& v)
     {
-        return u.x * v.x + u.y * v.y + u.z * v.z;
+        return simd::dot3(u.data, v.data);
     }
 
     inline vec3 cross(const vec3& u, const vec3& v)
@@ -147,12 +163,12 @@ namespace jmrtiow::math
             u.x * v.y - u.y * v.x);
     }
 
-    inline vec3 unit_vector(vec3 v)
+    inline vec3 unit_vector(const vec3& v)
     {
-        return v / v.length();
+        return simd::rsqrt(v.length_squared()) * v;
     }
 
-    vec3 random_in_unit_sphere()
+    inline vec3 random_in_unit_sphere()
     {
         while (true)
         {
@@ -163,12 +179,12 @@ namespace jmrtiow::math
         }
     }
 
-    vec3 random_unit_vector()
+    inline vec3 random_unit_vector()
     {
         return unit_vector(random_in_unit_sphere());
     }
 
-    vec3 random_in_hemisphere(const vec3& normal)
+    inline vec3 random_in_hemisphere(const vec3& normal)
     {
         vec3 in_unit_sphere = random_in_unit_sphere();
         if (dot(in_unit_sphere, normal) > 0.0) // In the same hemisphere as the normal
@@ -177,12 +193,12 @@ namespace jmrtiow::math
             return -in_unit_sphere;
     }
 
-    vec3 reflect(const vec3& v, const vec3& n)
+    inline vec3 reflect(const vec3& v, const vec3& n)
     {
         return v - 2 * dot(v, n) * n;
     }
 
-    vec3 refract(const vec3& uv, const vec3& n, double etai_over_etat)
+    inline vec3 refract(const vec3& uv, const vec3& n, double etai_over_etat)
     {
         auto cos_theta = fmin(dot(-uv, n), 1.0);
         vec3 r_out_perp = etai_over_etat * (uv + cos_theta * n);
@@ -190,7 +206,22 @@ namespace jmrtiow::math
         return r_out_perp + r_out_parallel;
     }
 
-    vec3 random_in_unit_disk()
+    inline vec3 random_to_sphere(double radius, double distance_squared)
+    {
+        // Direction, around +z, towards a uniformly chosen point of the cone a sphere of
+        // radius at distance_squared subtends.
+        auto r1 = random_double();
+        auto r2 = random_double();
+        auto z = 1 + r2 * (sqrt(1 - radius * radius / distance_squared) - 1);
+
+        auto phi = 2 * pi * r1;
+        auto x = cos(phi) * sqrt(1 - z * z);
+        auto y = sin(phi) * sqrt(1 - z * z);
+
+        return vec3(x, y, z);
+    }
+
+    inline vec3 random_in_unit_disk()
     {
         while (true)
         {
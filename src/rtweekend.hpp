@@ -2,9 +2,9 @@
 #define RTWEEKEND_HPP
 
 #include <cmath>
+#include <cstdint>
 #include <limits>
 #include <memory>
-#include <random>
 
 // Usings
 
@@ -24,12 +24,42 @@ inline double degrees_to_radians(double degrees)
     return degrees * pi / 180.0;
 }
 
+/// @brief Counter based random numbers: draw n of a stream is a hash of the stream's key and n, so
+/// every value depends on (key, n) alone and never on which thread draws it or what was drawn before.
+struct random_stream
+{
+public:
+    uint64_t key;
+    uint64_t counter;
+};
+
+inline uint64_t mix_bits(uint64_t z)
+{
+    // SplitMix64 finalizer, every input bit affects every output bit.
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+inline random_stream& random_state()
+{
+    // Every thread owns its stream, so render threads never race on shared state.
+    thread_local random_stream stream { .key = 0, .counter = 0 };
+    return stream;
+}
+
+inline void seed_random(uint64_t seed)
+{
+    // Starts the calling thread's stream keyed by seed over.
+    random_state() = random_stream { .key = mix_bits(seed), .counter = 0 };
+}
+
 inline double random_double()
 {
-    // Returns a random real in [0,1).
-    static std::uniform_real_distribution<double> distribution(0.0, 1.0);
-    static std::mt19937 generator;
-    return distribution(generator);
+    // Returns a random real in [0,1), the top 53 bits of the hash fill the mantissa.
+    random_stream& stream = random_state();
+    uint64_t bits = mix_bits(stream.key + 0x9e3779b97f4a7c15ull * ++stream.counter);
+    return static_cast<double>(bits >> 11) * 0x1.0p-53;
 }
 
 inline double random_double(double min, double max)
@@ -38,6 +68,12 @@ inline double random_double(double min, double max)
     return min + (max - min) * random_double();
 }
 
+inline int random_int(int min, int max)
+{
+    // Returns a random integer in [min,max].
+    return static_cast<int>(random_double(min, max + 1));
+}
+
 inline double clamp(double x, double min, double max)
 {
     if (x < min)
@@ -51,6 +87,7 @@ inline double clamp(double x, double min, double max)
 
 #include "math/ray.hpp"
 #include "math/vec3.hpp"
+#include "math/color3.hpp"
 #include "math/interval.hpp"
 #include "scene/hittable.hpp"
 
@@ -0,0 +1,21 @@
+#ifndef SCENE_AOV_SAMPLE_HPP
+#define SCENE_AOV_SAMPLE_HPP
+
+#include "../rtweekend.hpp"
+
+namespace jmrtiow::scene
+{
+    /// @brief Arbitrary output values of a camera ray's first hit, used to guide denoising
+    struct aov_sample
+    {
+    public:
+        /// @brief Surface color: scattering attenuation, emission, or the background on a miss
+        math::color3 albedo;
+        /// @brief Normal facing the ray, zero on a miss
+        math::vec3 normal;
+        /// @brief Distance from the ray origin, zero on a miss
+        double depth;
+    };
+}
+
+#endif // SCENE_AOV_SAMPLE_HPP
@@ -0,0 +1,29 @@
+#ifndef SCENE_BACKGROUND_HPP
+#define SCENE_BACKGROUND_HPP
+
+#include "../rtweekend.hpp"
+
+namespace jmrtiow::scene
+{
+    /// @brief Radiance of rays that leave the scene
+    struct background
+    {
+    public:
+        /// @brief Use the white to blue sky gradient instead of color
+        bool sky;
+        /// @brief Constant radiance when sky is not set
+        math::color3 color;
+
+        math::color3 value(const math::ray& r) const
+        {
+            if (!sky)
+                return color;
+
+            math::vec3 unit_direction = unit_vector(r.direction());
+            auto t = 0.5 * (unit_direction.y + 1.0);
+            return (1.0 - t) * math::color3(1.0, 1.0, 1.0) + t * math::color3(0.5, 0.7, 1.0);
+        }
+    };
+}
+
+#endif // SCENE_BACKGROUND_HPP
@@ -0,0 +1,122 @@
+#ifndef SCENE_BVH_HPP
+#define SCENE_BVH_HPP
+
+#include "hittable.hpp"
+#include "hittable_list.hpp"
+#include "scene_arena.hpp"
+#include "../stats/render_stats.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace jmrtiow::scene
+{
+    /// @brief Bounding volume hierarchy over a list of objects. Node boxes are built for a
+    /// shutter interval, so moving objects stay inside their nodes for every ray time.
+    class bvh_node : public hittable
+    {
+    public:
+        bvh_node(hittable_list list, math::interval shutter)
+            : bvh_node(list.objects, 0, list.objects.size(), shutter, list.arena.get())
+        {
+            // There's a C++ subtlety here. This constructor (without span indices) creates an
+            // implicit copy of the hittable list, which we will modify. The lifetime of the copied
+            // list only extends until this constructor exits. That's OK, because we only need to
+            // persist the resulting bounding volume hierarchy.
+        }
+
+        /// @brief Nodes are made in arena if it is not null, next to the objects of the scene, and then
+        /// live as long as the arena
+        bvh_node(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end, math::interval shutter, scene_arena* arena);
+
+        virtual bool closest_hit(const math::ray& r, math::interval ray_t, hit_candidate& closest) const override;
+
+        virtual bool hit_any(const math::ray& r, math::interval ray_t) const override;
+
+        virtual math::aabb bounding_box(math::interval shutter) const override { return bbox; }
+
+    private:
+        shared_ptr<hittable> left;
+        shared_ptr<hittable> right;
+        math::aabb bbox;
+    };
+
+    inline bvh_node::bvh_node(std::vector<shared_ptr<hittable>>& objects, size_t start, size_t end, math::interval shutter, scene_arena* arena)
+    {
+        // Boxes are computed once per object, not once per comparison.
+        std::vector<std::pair<math::aabb, shared_ptr<hittable>>> boxed {};
+        boxed.reserve(end - start);
+
+        bbox = math::aabb(math::interval::empty, math::interval::empty, math::interval::empty);
+        for (size_t i = start; i < end; i++)
+        {
+            boxed.emplace_back(objects[i]->bounding_box(shutter), objects[i]);
+            bbox = math::aabb(bbox, boxed.back().first);
+        }
+
+        size_t object_span = end - start;
+
+        if (object_span == 1)
+        {
+            left = right = objects[start];
+        }
+        else if (object_span == 2)
+        {
+            left = objects[start];
+            right = objects[start + 1];
+        }
+        else
+        {
+            // Split at the median centroid along the longest axis of the node.
+            int axis = bbox.longest_axis();
+            auto mid = boxed.begin() + object_span / 2;
+
+            std::nth_element(boxed.begin(), mid, boxed.end(), [axis](const auto& a, const auto& b)
+                {
+                    return a.first.centroid()[axis] < b.first.centroid()[axis];
+                });
+
+            for (size_t i = 0; i < object_span; i++)
+            {
+                objects[start + i] = boxed[i].second;
+            }
+
+            size_t split = start + object_span / 2;
+            if (arena != nullptr)
+            {
+                left = arena->make<bvh_node>(objects, start, split, shutter, arena);
+                right = arena->make<bvh_node>(objects, split, end, shutter, arena);
+            }
+            else
+            {
+                left = make_shared<bvh_node>(objects, start, split, shutter, arena);
+                right = make_shared<bvh_node>(objects, split, end, shutter, arena);
+            }
+        }
+    }
+
+    inline bool bvh_node::closest_hit(const math::ray& r, math::interval ray_t, hit_candidate& closest) const
+    {
+        stats::local().bvh_nodes++;
+
+        if (!bbox.hit(r, ray_t))
+            return false;
+
+        bool hit_left = left->closest_hit(r, ray_t, closest);
+        bool hit_right = right != left && right->closest_hit(r, math::interval(ray_t.min, hit_left ? closest.t : ray_t.max), closest);
+
+        return hit_left || hit_right;
+    }
+
+    inline bool bvh_node::hit_any(const math::ray& r, math::interval ray_t) const
+    {
+        stats::local().bvh_nodes++;
+
+        if (!bbox.hit(r, ray_t))
+            return false;
+
+        return left->hit_any(r, ray_t) || (right != left && right->hit_any(r, ray_t));
+    }
+}
+
+#endif // SCENE_BVH_HPP
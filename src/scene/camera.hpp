@@ -9,13 +9,21 @@ namespace jmrtiow::scene
     {
     public:
         camera(
-            math::point3 lookfrom,
-            math::point3 lookat,
-            math::vec3 vup,
+            const math::point3& lookfrom,
+            const math::point3& lookat,
+            const math::vec3& vup,
             double vfov, // vertical field-of-view in degrees
             double aspect_ratio,
             double aperture,
-            double focus_dist)
+            double focus_dist,
+            math::interval shutter = math::interval(0, 0))
+            : vfov(vfov), aspect_ratio(aspect_ratio), aperture(aperture), shutter(shutter)
+        {
+            look(lookfrom, lookat, vup, focus_dist);
+        }
+
+        /// @brief Moves the camera, keeping its lens and shutter
+        void look(const math::point3& lookfrom, const math::point3& lookat, const math::vec3& vup, double focus_dist)
         {
             auto theta = degrees_to_radians(vfov);
             auto h = tan(theta / 2);
@@ -32,6 +40,7 @@ namespace jmrtiow::scene
             lower_left_corner = origin - horizontal / 2 - vertical / 2 - focus_dist * w;
 
             lens_radius = aperture / 2;
+            vertical_extent = viewport_height;
         }
 
         math::ray get_ray(double s, double t) const
@@ -39,18 +48,36 @@ namespace jmrtiow::scene
             math::vec3 rd = lens_radius * math::random_in_unit_disk();
             math::vec3 offset = u * rd.x + v * rd.y;
 
+            // Only draw a ray time when the shutter is open, so still images keep their random sequence.
+            double time = shutter.size() > 0 ? random_double(shutter.min, shutter.max) : shutter.min;
+
             return math::ray(
                 origin + offset,
-                lower_left_corner + s * horizontal + t * vertical - origin - offset);
+                lower_left_corner + s * horizontal + t * vertical - origin - offset,
+                time);
         }
 
+        /// @brief Angle one pixel subtends when the image is image_height pixels tall
+        double pixel_spread(uint32_t image_height) const
+        {
+            return vertical_extent / image_height;
+        }
+
+        /// @brief Interval of ray times the shutter is open for
+        const math::interval& shutter_interval() const { return shutter; }
+
     private:
+        double vfov;
+        double aspect_ratio;
+        double aperture;
         math::point3 origin;
         math::point3 lower_left_corner;
         math::vec3 horizontal;
         math::vec3 vertical;
         math::vec3 u, v, w;
         double lens_radius;
+        double vertical_extent;
+        math::interval shutter;
     };
 }
 
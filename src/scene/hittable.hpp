@@ -2,18 +2,33 @@
 #define SCENE_HITTABLE_HPP
 
 #include "../rtweekend.hpp"
+#include "../math/aabb.hpp"
 // #include "material.hpp"
 
 namespace jmrtiow::scene
 {
     class material;
+    class hittable;
+
+    /// @brief Closest hit so far of a traversal: only its distance and primitive, whose surface is worked
+    /// out once the traversal is over
+    struct hit_candidate
+    {
+        double t;
+        const hittable* object;
+    };
 
     struct hit_record
     {
         math::point3 p;
         math::vec3 normal;
-        shared_ptr<material> mat_ptr;
+        /// @brief Owned by the hit object, which outlives the record
+        const material* mat_ptr;
         double t;
+        double u;
+        double v;
+        // Width of the ray's footprint at p in texture coordinates, 0 means sharpest.
+        double footprint;
         bool front_face;
 
         inline void set_face_normal(const math::ray& r, const math::vec3& outward_normal)
@@ -26,7 +41,43 @@ namespace jmrtiow::scene
     class hittable
     {
     public:
-        virtual bool hit(const math::ray& r, math::interval ray_t, hit_record& rec) const = 0;
+        /// @brief Closest hit within ray_t, with the surface data of only that hit computed
+        bool hit(const math::ray& r, math::interval ray_t, hit_record& rec) const
+        {
+            hit_candidate closest;
+            if (!closest_hit(r, ray_t, closest))
+                return false;
+
+            closest.object->set_surface(r, closest.t, rec);
+            return true;
+        }
+
+        /// @brief Finds the closest hit within ray_t. Primitives write closest only when they are hit, so
+        /// composites pass the same candidate to all their children.
+        virtual bool closest_hit(const math::ray& r, math::interval ray_t, hit_candidate& closest) const = 0;
+
+        /// @brief Fills rec for the hit at t this primitive returned from closest_hit()
+        virtual void set_surface(const math::ray& r, double t, hit_record& rec) const {}
+
+        /// @brief True if anything is hit within ray_t. Stops at the first hit found and skips the hit record,
+        /// for shadow rays that only ask whether something is in the way.
+        virtual bool hit_any(const math::ray& r, math::interval ray_t) const
+        {
+            hit_candidate closest;
+            return closest_hit(r, ray_t, closest);
+        }
+
+        /// @brief Box enclosing the object for every ray time in the shutter interval
+        virtual math::aabb bounding_box(math::interval shutter) const = 0;
+
+        /// @brief True if the object emits light and can be sampled with random()
+        virtual bool is_light() const { return false; }
+
+        /// @brief Solid angle density of random(origin) returning direction, 0 if it never does
+        virtual double pdf_value(const math::point3& origin, const math::vec3& direction) const { return 0.0; }
+
+        /// @brief Direction from origin towards a random point of the object
+        virtual math::vec3 random(const math::point3& origin) const { return math::vec3(1, 0, 0); }
     };
 }
 
@@ -1,9 +1,14 @@
 #ifndef SCENE_HITTABLE_LIST_HPP
 #define SCENE_HITTABLE_LIST_HPP
 
+#include "aov_sample.hpp"
+#include "background.hpp"
 #include "hittable.hpp"
 #include "material.hpp"
 #include "sphere.hpp"
+#include "moving_sphere.hpp"
+#include "scene_arena.hpp"
+#include "../stats/render_stats.hpp"
 
 #include <memory>
 #include <vector>
@@ -22,38 +27,174 @@ namespace jmrtiow::scene
         void clear() { objects.clear(); }
         void add(std::shared_ptr<hittable> object) { objects.push_back(object); }
 
-        virtual bool hit(
-            const math::ray& r, math::interval ray_t, hit_record& rec) const override;
+        /// @brief Makes a T in the list's scene_arena, so objects and materials are laid out in build order
+        template <typename T, typename... Args>
+        std::shared_ptr<T> make(Args&&... args);
+
+        virtual bool closest_hit(const math::ray& r, math::interval ray_t, hit_candidate& closest) const override;
+
+        virtual bool hit_any(const math::ray& r, math::interval ray_t) const override;
+
+        virtual math::aabb bounding_box(math::interval shutter) const override;
+
+        virtual double pdf_value(const math::point3& origin, const math::vec3& direction) const override;
+
+        virtual math::vec3 random(const math::point3& origin) const override;
 
     public:
         std::vector<std::shared_ptr<hittable>> objects;
+        /// @brief Memory of everything make() created, made on first use and shared by copies of the list.
+        /// Objects of the arena count no references, the arena and all of them go with the last list.
+        std::shared_ptr<scene_arena> arena;
     };
 
-    bool hittable_list::hit(const math::ray& r, math::interval ray_t, hit_record& rec) const
+    template <typename T, typename... Args>
+    std::shared_ptr<T> hittable_list::make(Args&&... args)
+    {
+        if (!arena)
+            arena = std::make_shared<scene_arena>();
+
+        return arena->make<T>(std::forward<Args>(args)...);
+    }
+
+    inline bool hittable_list::closest_hit(const math::ray& r, math::interval ray_t, hit_candidate& closest) const
     {
-        hit_record temp_rec;
+        // Objects only overwrite closest when they are hit closer, no record is copied per candidate.
         bool hit_anything = false;
-        auto closest_so_far = ray_t.max;
 
         for (const auto& object : objects)
         {
-            if (object->hit(r, math::interval(ray_t.min, closest_so_far), temp_rec))
+            if (object->closest_hit(r, ray_t, closest))
             {
                 hit_anything = true;
-                closest_so_far = temp_rec.t;
-                rec = temp_rec;
+                ray_t.max = closest.t;
             }
         }
 
         return hit_anything;
     }
 
-    scene::hittable_list random_scene()
+    inline bool hittable_list::hit_any(const math::ray& r, math::interval ray_t) const
+    {
+        for (const auto& object : objects)
+        {
+            if (object->hit_any(r, ray_t))
+                return true;
+        }
+
+        return false;
+    }
+
+    inline math::aabb hittable_list::bounding_box(math::interval shutter) const
+    {
+        math::aabb bbox(math::interval::empty, math::interval::empty, math::interval::empty);
+
+        for (const auto& object : objects)
+        {
+            bbox = math::aabb(bbox, object->bounding_box(shutter));
+        }
+
+        return bbox;
+    }
+
+    inline double hittable_list::pdf_value(const math::point3& origin, const math::vec3& direction) const
+    {
+        // random() picks an object uniformly, so the density is the mean of the object densities.
+        auto weight = 1.0 / objects.size();
+        auto sum = 0.0;
+
+        for (const auto& object : objects)
+        {
+            sum += weight * object->pdf_value(origin, direction);
+        }
+
+        return sum;
+    }
+
+    inline math::vec3 hittable_list::random(const math::point3& origin) const
+    {
+        auto int_size = static_cast<int>(objects.size());
+        return objects[random_int(0, int_size - 1)]->random(origin);
+    }
+
+    /// @brief Top level objects of world that emit light, for next event estimation
+    inline hittable_list collect_lights(const hittable_list& world)
+    {
+        // The lights are objects of world's arena.
+        hittable_list lights;
+        lights.arena = world.arena;
+
+        for (const auto& object : world.objects)
+        {
+            if (object->is_light())
+                lights.add(object);
+        }
+
+        return lights;
+    }
+
+    inline scene::hittable_list random_scene()
+    {
+        scene::hittable_list world;
+
+        auto ground_material = world.make<scene::lambertian>(math::color3(0.5, 0.5, 0.5));
+        world.add(world.make<scene::sphere>(math::point3(0, -1000, 0), 1000, ground_material));
+
+        for (int a = -11; a < 11; a++)
+        {
+            for (int b = -11; b < 11; b++)
+            {
+                auto choose_mat = random_double();
+                math::point3 center(a + 0.9 * random_double(), 0.2, b + 0.9 * random_double());
+
+                if ((center - math::point3(4, 0.2, 0)).length() > 0.9)
+                {
+                    shared_ptr<scene::material> sphere_material;
+
+                    if (choose_mat < 0.8)
+                    {
+                        // diffuse
+                        auto albedo = math::color3::random() * math::color3::random();
+                        sphere_material = world.make<scene::lambertian>(albedo);
+                        world.add(world.make<scene::sphere>(center, 0.2, sphere_material));
+                    }
+                    else if (choose_mat < 0.95)
+                    {
+                        // scene::metal
+                        auto albedo = math::color3::random(0.5, 1);
+                        auto fuzz = random_double(0, 0.5);
+                        sphere_material = world.make<scene::metal>(albedo, fuzz);
+                        world.add(world.make<scene::sphere>(center, 0.2, sphere_material));
+                    }
+                    else
+                    {
+                        // glass
+                        sphere_material = world.make<scene::dielectric>(1.5);
+                        world.add(world.make<scene::sphere>(center, 0.2, sphere_material));
+                    }
+                }
+            }
+        }
+
+        auto material1 = world.make<scene::dielectric>(1.5);
+        world.add(world.make<scene::sphere>(math::point3(0, 1, 0), 1.0, material1));
+
+        auto material2 = world.make<scene::lambertian>(math::color3(0.4, 0.2, 0.1));
+        world.add(world.make<scene::sphere>(math::point3(-4, 1, 0), 1.0, material2));
+
+        auto material3 = world.make<scene::metal>(math::color3(0.7, 0.6, 0.5), 0.0);
+        world.add(world.make<scene::sphere>(math::point3(4, 1, 0), 1.0, material3));
+
+        return world;
+    }
+
+    inline scene::hittable_list bouncing_scene()
     {
+        // random_scene() with the diffuse spheres bouncing up during the shutter interval.
         scene::hittable_list world;
 
-        auto ground_material = make_shared<scene::lambertian>(math::color3(0.5, 0.5, 0.5));
-        world.add(make_shared<scene::sphere>(math::point3(0, -1000, 0), 1000, ground_material));
+        auto ground_material = world.make<scene::lambertian>(math::color3(0.5, 0.5, 0.5));
+        world.add(world.make<scene::sphere>(math::point3(0, -1000, 0), 1000, ground_material));
 
         for (int a = -11; a < 11; a++)
         {
@@ -70,40 +211,134 @@ namespace jmrtiow::scene
                     {
                         // diffuse
                         auto albedo = math::color3::random() * math::color3::random();
-                        sphere_material = make_shared<scene::lambertian>(albedo);
-                        world.add(make_shared<scene::sphere>(center, 0.2, sphere_material));
+                        sphere_material = world.make<scene::lambertian>(albedo);
+                        auto center2 = center + math::vec3(0, random_double(0, 0.5), 0);
+                        world.add(world.make<scene::moving_sphere>(center, center2, 0.0, 1.0, 0.2, sphere_material));
                     }
                     else if (choose_mat < 0.95)
                     {
                         // scene::metal
                         auto albedo = math::color3::random(0.5, 1);
                         auto fuzz = random_double(0, 0.5);
-                        sphere_material = make_shared<scene::metal>(albedo, fuzz);
-                        world.add(make_shared<scene::sphere>(center, 0.2, sphere_material));
+                        sphere_material = world.make<scene::metal>(albedo, fuzz);
+                        world.add(world.make<scene::sphere>(center, 0.2, sphere_material));
                     }
                     else
                     {
                         // glass
-                        sphere_material = make_shared<scene::dielectric>(1.5);
-                        world.add(make_shared<scene::sphere>(center, 0.2, sphere_material));
+                        sphere_material = world.make<scene::dielectric>(1.5);
+                        world.add(world.make<scene::sphere>(center, 0.2, sphere_material));
                     }
                 }
             }
         }
 
-        auto material1 = make_shared<scene::dielectric>(1.5);
-        world.add(make_shared<scene::sphere>(math::point3(0, 1, 0), 1.0, material1));
+        auto material1 = world.make<scene::dielectric>(1.5);
+        world.add(world.make<scene::sphere>(math::point3(0, 1, 0), 1.0, material1));
+
+        auto material2 = world.make<scene::lambertian>(math::color3(0.4, 0.2, 0.1));
+        world.add(world.make<scene::sphere>(math::point3(-4, 1, 0), 1.0, material2));
+
+        auto material3 = world.make<scene::metal>(math::color3(0.7, 0.6, 0.5), 0.0);
+        world.add(world.make<scene::sphere>(math::point3(4, 1, 0), 1.0, material3));
+
+        return world;
+    }
+
+    inline hittable_list checkered_spheres()
+    {
+        hittable_list world;
+
+        auto checker = world.make<scene::checker_texture>(0.32, math::color3(.2, .3, .1), math::color3(.9, .9, .9));
+
+        world.add(world.make<scene::sphere>(math::point3(0, -10, 0), 10, world.make<scene::lambertian>(checker)));
+        world.add(world.make<scene::sphere>(math::point3(0, 10, 0), 10, world.make<scene::lambertian>(checker)));
+
+        return world;
+    }
+
+    inline hittable_list perlin_spheres()
+    {
+        hittable_list world;
+
+        auto pertext = world.make<scene::noise_texture>(4);
+        world.add(world.make<scene::sphere>(math::point3(0, -1000, 0), 1000, world.make<scene::lambertian>(pertext)));
+        world.add(world.make<scene::sphere>(math::point3(0, 2, 0), 2, world.make<scene::lambertian>(pertext)));
+
+        return world;
+    }
+
+    inline hittable_list earth(const std::string& texture_filepath)
+    {
+        hittable_list world;
+
+        auto earth_texture = world.make<scene::image_texture>(texture_filepath);
+        auto earth_surface = world.make<scene::lambertian>(earth_texture);
+        world.add(world.make<scene::sphere>(math::point3(0, 0, 0), 2, earth_surface));
+
+        return world;
+    }
+
+    inline hittable_list sphere_lights()
+    {
+        // Perlin spheres inside a closed room, lit only by two small emitters.
+        hittable_list world;
 
-        auto material2 = make_shared<scene::lambertian>(math::color3(0.4, 0.2, 0.1));
-        world.add(make_shared<scene::sphere>(math::point3(-4, 1, 0), 1.0, material2));
+        auto pertext = world.make<scene::noise_texture>(4);
+        world.add(world.make<scene::sphere>(math::point3(0, -1000, 0), 1000, world.make<scene::lambertian>(pertext)));
+        world.add(world.make<scene::sphere>(math::point3(0, 2, 0), 2, world.make<scene::lambertian>(pertext)));
+        world.add(world.make<scene::sphere>(math::point3(-4, 1, 2), 1, world.make<scene::metal>(math::color3(0.8, 0.8, 0.9), 0.05)));
+        world.add(world.make<scene::sphere>(math::point3(0, 0, 0), 30, world.make<scene::lambertian>(math::color3(0.73, 0.73, 0.73))));
 
-        auto material3 = make_shared<scene::metal>(math::color3(0.7, 0.6, 0.5), 0.0);
-        world.add(make_shared<scene::sphere>(math::point3(4, 1, 0), 1.0, material3));
+        world.add(world.make<scene::sphere>(math::point3(0, 7, 0), 1, world.make<scene::diffuse_light>(math::color3(15, 15, 15))));
+        world.add(world.make<scene::sphere>(math::point3(3, 1.5, 3), 0.5, world.make<scene::diffuse_light>(math::color3(8, 4, 1))));
 
         return world;
     }
 
-    math::color3 ray_color(const math::ray& r, const scene::hittable& world, int depth)
+    /// @brief Power heuristic weight, with beta 2, of a sample drawn with density pdf against another strategy's density
+    inline double power_heuristic(double pdf, double other_pdf)
+    {
+        return pdf * pdf / (pdf * pdf + other_pdf * other_pdf);
+    }
+
+    /// @brief Radiance reaching a non-specular hit from one light sample, weighted against scattering toward the same light.
+    inline math::color3 sample_lights(const math::ray& r, const hit_record& rec, const math::color3& attenuation,
+        const scene::hittable& world, const scene::hittable& lights)
+    {
+        math::ray to_light(rec.p, lights.random(rec.p), r.time(), r.spread());
+
+        auto light_pdf = lights.pdf_value(rec.p, to_light.direction());
+        if (light_pdf <= 0)
+            return math::color3(0, 0, 0);
+
+        auto scatter_pdf = rec.mat_ptr->scattering_pdf(r, rec, to_light);
+        if (scatter_pdf <= 0)
+            return math::color3(0, 0, 0);
+
+        // The closest emitter along the ray is what the point sees, unless something is in front of it.
+        // Another emitter in the way is the closest one, so it contributes instead of blocking. Both
+        // queries find the emitter at the same t, the open interval leaves it out of the shadow ray.
+        scene::hit_record light_rec;
+        if (!lights.hit(to_light, math::interval(0.0001, infinity), light_rec))
+            return math::color3(0, 0, 0);
+
+        stats::local().shadow_rays++;
+        if (world.hit_any(to_light, math::interval(0.0001, light_rec.t)))
+            return math::color3(0, 0, 0);
+
+        math::color3 emitted = light_rec.mat_ptr->emitted(light_rec.u, light_rec.v, light_rec.p);
+        return attenuation * scatter_pdf * emitted * power_heuristic(light_pdf, scatter_pdf) / light_pdf;
+    }
+
+    /// @brief Radiance along r. Non-specular hits sample lights directly, when lights is not null,
+    /// and the emission found by scattering is then weighted down by the light sampling density. Every
+    /// bounce is traced through Target::run(), so all of them are compiled for Target.
+    /// @param scatter_pdf Density the previous bounce chose r with, 0 for camera rays and specular bounces
+    /// @param aov Receives the first hit of a camera ray, if not null
+    template <typename Target = math::simd::baseline_target>
+    inline math::color3 ray_color(const math::ray& r, const scene::hittable& world, const scene::hittable* lights,
+        const scene::background& background, int depth, double scatter_pdf = 0, scene::aov_sample* aov = nullptr)
     {
         scene::hit_record rec;
 
@@ -111,8 +346,12 @@ namespace jmrtiow::scene
         if (depth <= 0)
             return math::color3(0, 0, 0);
 
+        stats::local().rays++;
         if (world.hit(r, math::interval(0.0001, infinity), rec))
         {
+            math::color3 emitted = rec.mat_ptr->emitted(rec.u, rec.v, rec.p);
+            if (scatter_pdf > 0 && lights != nullptr && rec.mat_ptr->emissive())
+                emitted *= power_heuristic(scatter_pdf, lights->pdf_value(r.origin(), r.direction()));
 
 #if 0   // Alternate diffuse form
             math::point3 target = rec.p + random_in_hemisphere(rec.normal);
@@ -123,42 +362,60 @@ namespace jmrtiow::scene
 #endif
             math::ray scattered;
             math::color3 attenuation;
-            if (rec.mat_ptr->scatter(r, rec, attenuation, scattered))
-                return attenuation * ray_color(scattered, world, depth - 1);
-            return math::color3(0, 0, 0);
+            bool scatters = rec.mat_ptr->scatter(r, rec, attenuation, scattered);
+
+            if (aov != nullptr)
+            {
+                aov->albedo = scatters ? attenuation : emitted;
+                aov->normal = rec.normal;
+                aov->depth = rec.t * r.direction().length();
+            }
+
+            if (!scatters)
+                return emitted;
+
+            auto next_pdf = rec.mat_ptr->scattering_pdf(r, rec, scattered);
+            math::color3 direct(0, 0, 0);
+            if (next_pdf > 0 && lights != nullptr)
+                direct = sample_lights(r, rec, attenuation, world, *lights);
+
+            return emitted + direct
+                + attenuation * Target::run([&]() { return ray_color<Target>(scattered, world, lights, background, depth - 1, next_pdf); });
         }
 
-        math::vec3 unit_direction = unit_vector(r.direction());
-        auto t = 0.5 * (unit_direction.y + 1.0);
-        return (1.0 - t) * math::color3(1.0, 1.0, 1.0) + t * math::color3(0.5, 0.7, 1.0);
+        math::color3 sky = background.value(r);
+        if (aov != nullptr)
+            *aov = scene::aov_sample { .albedo = sky, .normal = math::vec3(0, 0, 0), .depth = 0.0 };
+
+        return sky;
     }
 
-    hittable_list demo_scene()
+    inline hittable_list demo_scene()
     {
         hittable_list world = hittable_list();
-        auto material_ground = make_shared<scene::lambertian>(math::color3(0.8, 0.8, 0.0));
-        auto material_center = make_shared<scene::lambertian>(math::color3(0.1, 0.2, 0.5));
-        auto material_left = make_shared<scene::dielectric>(1.5);
-        auto material_right = make_shared<scene::metal>(math::color3(0.8, 0.6, 0.2), 0.0);
-
-        world.add(make_shared<scene::sphere>(math::point3(0.0, -100.5, -1.0), 100.0, material_ground));
-        world.add(make_shared<scene::sphere>(math::point3(0.0, 0.0, -1.0), 0.5, material_center));
-        world.add(make_shared<scene::sphere>(math::point3(-1.0, 0.0, -1.0), 0.5, material_left));
-        world.add(make_shared<scene::sphere>(math::point3(-1.0, 0.0, -1.0), -0.45, material_left)); // bubble effect on the left scene::sphere.
-        world.add(make_shared<scene::sphere>(math::point3(1.0, 0.0, -1.0), 0.5, material_right));
+        auto material_ground = world.make<scene::lambertian>(math::color3(0.8, 0.8, 0.0));
+        auto material_center = world.make<scene::lambertian>(math::color3(0.1, 0.2, 0.5));
+        auto material_left = world.make<scene::dielectric>(1.5);
+        auto material_right = world.make<scene::metal>(math::color3(0.8, 0.6, 0.2), 0.0);
+
+        world.add(world.make<scene::sphere>(math::point3(0.0, -100.5, -1.0), 100.0, material_ground));
+        world.add(world.make<scene::sphere>(math::point3(0.0, 0.0, -1.0), 0.5, material_center));
+        world.add(world.make<scene::sphere>(math::point3(-1.0, 0.0, -1.0), 0.5, material_left));
+        world.add(world.make<scene::sphere>(math::point3(-1.0, 0.0, -1.0), -0.45, material_left)); // bubble effect on the left scene::sphere.
+        world.add(world.make<scene::sphere>(math::point3(1.0, 0.0, -1.0), 0.5, material_right));
         return world;
     }
 
-    hittable_list demo_scene2()
+    inline hittable_list demo_scene2()
     {
         hittable_list world = hittable_list();
 
         auto R = cos(pi / 4);
-        auto material_left = make_shared<scene::lambertian>(math::color3(0, 0, 1));
-        auto material_right = make_shared<scene::lambertian>(math::color3(1, 0, 0));
+        auto material_left = world.make<scene::lambertian>(math::color3(0, 0, 1));
+        auto material_right = world.make<scene::lambertian>(math::color3(1, 0, 0));
 
-        world.add(make_shared<scene::sphere>(math::point3(-R, 0, -1), R, material_left));
-        world.add(make_shared<scene::sphere>(math::point3(R, 0, -1), R, material_right));
+        world.add(world.make<scene::sphere>(math::point3(-R, 0, -1), R, material_left));
+        world.add(world.make<scene::sphere>(math::point3(R, 0, -1), R, material_right));
 
         return world;
     }
@@ -2,6 +2,7 @@
 #define SCENE_MATERIAL_HPP
 
 #include "../rtweekend.hpp"
+#include "texture.hpp"
 
 namespace jmrtiow::scene
 {
@@ -12,29 +13,81 @@ namespace jmrtiow::scene
     public:
         virtual bool scatter(
             const math::ray& r_in, const hit_record& rec, math::color3& attenuation, math::ray& scattered) const = 0;
+
+        /// @brief Solid angle density of scatter() producing scattered, 0 for specular materials.
+        /// Non-zero only if attenuation * scattering_pdf is the BRDF times the cosine term, which
+        /// lets light sampling evaluate the material for directions it did not choose.
+        virtual double scattering_pdf(const math::ray& r_in, const hit_record& rec, const math::ray& scattered) const
+        {
+            return 0;
+        }
+
+        virtual math::color3 emitted(double u, double v, const math::point3& p) const
+        {
+            return math::color3(0, 0, 0);
+        }
+
+        virtual bool emissive() const { return false; }
     };
 
     class lambertian : public material
     {
     public:
-        lambertian(const math::color3& a) : albedo(a) {}
+        lambertian(const math::color3& a) : albedo(make_shared<solid_color>(a)) {}
+        lambertian(shared_ptr<texture> a) : albedo(a) {}
 
         virtual bool scatter(
             const math::ray& r_in, const hit_record& rec, math::color3& attenuation, math::ray& scattered) const override
         {
-            auto scatter_direction = rec.normal + math::random_unit_vector();
+            scattered = math::ray(rec.p, scatter_direction(rec.normal), r_in.time(), r_in.spread());
+            attenuation = albedo->value(rec.u, rec.v, rec.p, rec.footprint);
+            return true;
+        }
+
+        /// @brief Cosine weighted direction around normal
+        static math::vec3 scatter_direction(const math::vec3& normal)
+        {
+            auto scatter_direction = normal + math::random_unit_vector();
 
             // Catch degenerate scatter direction
             if (scatter_direction.near_zero())
-                scatter_direction = rec.normal;
+                scatter_direction = normal;
 
-            scattered = math::ray(rec.p, scatter_direction);
-            attenuation = albedo;
-            return true;
+            return scatter_direction;
+        }
+
+        virtual double scattering_pdf(const math::ray& r_in, const hit_record& rec, const math::ray& scattered) const override
+        {
+            // Cosine weighted, which normal + random_unit_vector() samples.
+            auto cos_theta = dot(rec.normal, unit_vector(scattered.direction()));
+            return cos_theta < 0 ? 0 : cos_theta / pi;
         }
 
     public:
-        math::color3 albedo;
+        shared_ptr<texture> albedo;
+    };
+
+    class diffuse_light : public material
+    {
+    public:
+        diffuse_light(shared_ptr<texture> tex) : tex(tex) {}
+        diffuse_light(const math::color3& emit) : tex(make_shared<solid_color>(emit)) {}
+
+        virtual bool scatter(
+            const math::ray& r_in, const hit_record& rec, math::color3& attenuation, math::ray& scattered) const override
+        {
+            return false;
+        }
+
+        virtual math::color3 emitted(double u, double v, const math::point3& p) const override
+        {
+            return tex->value(u, v, p, 0);
+        }
+
+        virtual bool emissive() const override { return true; }
+
+    private:
+        shared_ptr<texture> tex;
     };
 
     class metal : public material
@@ -45,10 +98,16 @@ namespace jmrtiow::scene
         virtual bool scatter(
             const math::ray& r_in, const hit_record& rec, math::color3& attenuation, math::ray& scattered) const override
         {
-            math::vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
-            scattered = math::ray(rec.p, reflected + fuzz * math::random_in_unit_sphere());
             attenuation = albedo;
-            return (dot(scattered.direction(), rec.normal) > 0);
+            return scatter_ray(r_in, rec.p, rec.normal, fuzz, scattered);
+        }
+
+        /// @brief Mirror reflection blurred by fuzz, false if it points into the surface
+        static bool scatter_ray(const math::ray& r_in, const math::point3& p, const math::vec3& normal, double fuzz, math::ray& scattered)
+        {
+            math::vec3 reflected = reflect(unit_vector(r_in.direction()), normal);
+            scattered = math::ray(p, reflected + fuzz * math::random_in_unit_sphere(), r_in.time(), r_in.spread());
+            return (dot(scattered.direction(), normal) > 0);
         }
 
     public:
@@ -65,22 +124,25 @@ namespace jmrtiow::scene
             const math::ray& r_in, const hit_record& rec, math::color3& attenuation, math::ray& scattered) const override
         {
             attenuation = math::color3(1.0, 1.0, 1.0);
-            double refraction_ratio = rec.front_face ? (1.0 / ir) : ir;
+            scattered = math::ray(rec.p, scatter_direction(r_in.direction(), rec.normal, rec.front_face, ir), r_in.time(), r_in.spread());
+            return true;
+        }
+
+        /// @brief Refracted or, by Fresnel reflectance or total internal reflection, reflected direction
+        static math::vec3 scatter_direction(const math::vec3& direction, const math::vec3& normal, bool front_face, double ir)
+        {
+            double refraction_ratio = front_face ? (1.0 / ir) : ir;
 
-            math::vec3 unit_direction = unit_vector(r_in.direction());
-            double cos_theta = fmin(dot(-unit_direction, rec.normal), 1.0);
+            math::vec3 unit_direction = unit_vector(direction);
+            double cos_theta = fmin(dot(-unit_direction, normal), 1.0);
             double sin_theta = sqrt(1.0 - cos_theta * cos_theta);
 
             bool cannot_refract = refraction_ratio * sin_theta > 1.0;
-            math::vec3 direction;
 
             if (cannot_refract || reflectance(cos_theta, refraction_ratio) > random_double())
-                direction = reflect(unit_direction, rec.normal);
+                return reflect(unit_direction, normal);
             else
-                direction = refract(unit_direction, rec.normal, refraction_ratio);
-
-            scattered = math::ray(rec.p, direction);
-            return true;
+                return refract(unit_direction, normal, refraction_ratio);
         }
 
     public:
@@ -0,0 +1,86 @@
+#ifndef SCENE_MOVING_SPHERE_HPP
+#define SCENE_MOVING_SPHERE_HPP
+
+#include "hittable.hpp"
+#include "sphere.hpp"
+#include "../math/vec3.hpp"
+#include "../stats/render_stats.hpp"
+
+namespace jmrtiow::scene
+{
+    /// @brief Sphere moving linearly from center0 at time0 to center1 at time1
+    class moving_sphere : public hittable
+    {
+    public:
+        moving_sphere() {}
+        moving_sphere(const math::point3& cen0, const math::point3& cen1, double time0, double time1, double r, shared_ptr<material> m)
+            : center0(cen0), center1(cen1), time0(time0), time1(time1), radius(r), radius_squared(r * r), inv_radius(1.0 / r), mat_ptr(m) {};
+
+        virtual bool closest_hit(const math::ray& r, math::interval ray_t, hit_candidate& closest) const override;
+
+        virtual void set_surface(const math::ray& r, double t, hit_record& rec) const override;
+
+        virtual bool hit_any(const math::ray& r, math::interval ray_t) const override;
+
+        virtual math::aabb bounding_box(math::interval shutter) const override;
+
+        math::point3 center(double time) const;
+
+    public:
+        math::point3 center0, center1;
+        double time0, time1;
+        double radius;
+        double radius_squared;
+        double inv_radius;
+        shared_ptr<material> mat_ptr;
+    };
+
+    inline math::point3 moving_sphere::center(double time) const
+    {
+        return center0 + ((time - time0) / (time1 - time0)) * (center1 - center0);
+    }
+
+    inline bool moving_sphere::closest_hit(const math::ray& r, math::interval ray_t, hit_candidate& closest) const
+    {
+        stats::local().primitive_tests++;
+
+        double root;
+        if (!sphere_root(r, r.origin() - center(r.time()), radius_squared, ray_t, root))
+            return false;
+
+        closest = hit_candidate { .t = root, .object = this };
+        return true;
+    }
+
+    inline void moving_sphere::set_surface(const math::ray& r, double t, hit_record& rec) const
+    {
+        math::point3 current_center = center(r.time());
+
+        rec.t = t;
+        rec.p = r.at(rec.t);
+        math::vec3 outward_normal = (rec.p - current_center) * inv_radius;
+        rec.set_face_normal(r, outward_normal);
+        get_sphere_uv(outward_normal, rec.u, rec.v);
+        rec.footprint = sphere_footprint(r, rec.t, radius);
+        rec.mat_ptr = mat_ptr.get();
+    }
+
+    inline bool moving_sphere::hit_any(const math::ray& r, math::interval ray_t) const
+    {
+        stats::local().primitive_tests++;
+
+        double root;
+        return sphere_root(r, r.origin() - center(r.time()), radius_squared, ray_t, root);
+    }
+
+    inline math::aabb moving_sphere::bounding_box(math::interval shutter) const
+    {
+        // Motion is linear, so the boxes at both ends of the shutter enclose every position in between.
+        math::vec3 rvec(fabs(radius), fabs(radius), fabs(radius));
+        math::aabb box0(center(shutter.min) - rvec, center(shutter.min) + rvec);
+        math::aabb box1(center(shutter.max) - rvec, center(shutter.max) + rvec);
+        return math::aabb(box0, box1);
+    }
+}
+
+#endif // SCENE_MOVING_SPHERE_HPP
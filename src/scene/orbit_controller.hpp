@@ -0,0 +1,75 @@
+#ifndef SCENE_ORBIT_CONTROLLER_HPP
+#define SCENE_ORBIT_CONTROLLER_HPP
+
+#include "../rtweekend.hpp"
+
+namespace jmrtiow::scene
+{
+    /// @brief Camera placement orbiting a target point. Rotation is around the y axis and
+    /// distances scale with the orbit radius, so controls feel the same for any scene size.
+    class orbit_controller
+    {
+    public:
+        orbit_controller(const math::point3& lookfrom, const math::point3& lookat, const math::vec3& vup);
+
+        /// @brief Turns around the target by the given angles in radians
+        void rotate(double yaw_delta, double pitch_delta);
+
+        /// @brief Moves camera and target along the camera axes, in multiples of the orbit radius
+        void move(double forward, double right, double up);
+
+        /// @brief Scales the orbit radius, values below 1 move closer
+        void zoom(double factor);
+
+        math::point3 lookfrom() const;
+        const math::point3& lookat() const { return target; }
+        const math::vec3& vup() const { return up; }
+        double distance() const { return radius; }
+
+    private:
+        math::point3 target;
+        math::vec3 up;
+        double yaw;
+        double pitch;
+        double radius;
+    };
+
+    inline orbit_controller::orbit_controller(const math::point3& lookfrom, const math::point3& lookat, const math::vec3& vup)
+        : target(lookat), up(vup)
+    {
+        math::vec3 offset = lookfrom - lookat;
+        radius = offset.length();
+        pitch = asin(offset.y / radius);
+        yaw = atan2(offset.x, offset.z);
+    }
+
+    inline void orbit_controller::rotate(double yaw_delta, double pitch_delta)
+    {
+        // Stop short of the poles, where the view direction would line up with vup.
+        const double pitch_limit = pi / 2 - 0.01;
+
+        yaw += yaw_delta;
+        pitch = clamp(pitch + pitch_delta, -pitch_limit, pitch_limit);
+    }
+
+    inline void orbit_controller::move(double forward, double right, double up_amount)
+    {
+        math::vec3 w = unit_vector(lookfrom() - target);
+        math::vec3 u = unit_vector(cross(up, w));
+        math::vec3 v = cross(w, u);
+
+        target += radius * (-forward * w + right * u + up_amount * v);
+    }
+
+    inline void orbit_controller::zoom(double factor)
+    {
+        radius = std::max(radius * factor, 0.01);
+    }
+
+    inline math::point3 orbit_controller::lookfrom() const
+    {
+        return target + radius * math::vec3(cos(pitch) * sin(yaw), sin(pitch), cos(pitch) * cos(yaw));
+    }
+}
+
+#endif // SCENE_ORBIT_CONTROLLER_HPP
@@ -0,0 +1,134 @@
+#ifndef SCENE_PROCEDURAL_SCENE_HPP
+#define SCENE_PROCEDURAL_SCENE_HPP
+
+#include "hittable_list.hpp"
+#include "material.hpp"
+#include "sphere.hpp"
+#include "../rtweekend.hpp"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace jmrtiow::scene
+{
+    enum class sphere_distribution
+    {
+        /// @brief Evenly over the ground, about one sphere per square unit like random_scene()
+        uniform,
+        /// @brief In piles of about a thousand spheres around random points of the same ground
+        clustered,
+    };
+
+    /// @brief Parameters of procedural_scene()
+    struct procedural_settings
+    {
+    public:
+        /// @brief Number of small spheres, besides the ground
+        size_t sphere_count;
+        sphere_distribution distribution;
+        /// @brief Relative weights of diffuse, metal and glass spheres
+        double diffuse_weight;
+        double metal_weight;
+        double glass_weight;
+        /// @brief Equal seeds give equal scenes, whatever the thread count
+        uint64_t seed;
+        /// @brief Threads generating the spheres, 0 for one per core
+        uint32_t thread_count;
+    };
+
+    /// @brief Scene of any number of small spheres on a ground large enough to hold them, for measuring
+    /// how traversal and memory scale with the primitive count. Spheres are generated in parallel, every
+    /// sphere from a random stream of its own, and share a palette of materials.
+    inline hittable_list procedural_scene(const procedural_settings& settings)
+    {
+        hittable_list world;
+
+        constexpr size_t palette_size = 64;
+        constexpr size_t cluster_size = 1000;
+
+        // Side of the square the spheres are spread over, the ground sphere is wide enough for its corners.
+        double side = std::max(1.0, sqrt(static_cast<double>(settings.sphere_count)));
+        double ground_radius = std::max(1000.0, side);
+        world.add(world.make<sphere>(math::point3(0, -ground_radius, 0), ground_radius, world.make<lambertian>(math::color3(0.5, 0.5, 0.5))));
+
+        // A shared palette keeps materials a small part of the scene even at millions of spheres.
+        std::vector<shared_ptr<material>> palette {};
+        seed_random(mix_bits(settings.seed));
+        for (size_t i = 0; i < palette_size; i++)
+        {
+            palette.push_back(world.make<lambertian>(math::color3::random() * math::color3::random()));
+            palette.push_back(world.make<metal>(math::color3::random(0.5, 1), random_double(0, 0.5)));
+        }
+        auto glass = world.make<dielectric>(1.5);
+
+        size_t cluster_count = std::max<size_t>(1, settings.sphere_count / cluster_size);
+        std::vector<math::point3> clusters(cluster_count);
+        for (auto& cluster : clusters)
+            cluster = math::point3(side * (random_double() - 0.5), 0, side * (random_double() - 0.5));
+
+        double weight_sum = settings.diffuse_weight + settings.metal_weight + settings.glass_weight;
+        double diffuse_share = weight_sum > 0 ? settings.diffuse_weight / weight_sum : 1.0;
+        double metal_share = weight_sum > 0 ? settings.metal_weight / weight_sum : 0.0;
+
+        size_t first = world.objects.size();
+        world.objects.resize(first + settings.sphere_count);
+
+        uint32_t thread_count = settings.thread_count > 0 ? settings.thread_count : std::max(1u, std::thread::hardware_concurrency());
+        std::vector<std::thread> threads {};
+
+        for (uint32_t t = 0; t < thread_count; t++)
+        {
+            threads.emplace_back([&, t]()
+                {
+                    size_t begin = settings.sphere_count * t / thread_count;
+                    size_t end = settings.sphere_count * (t + 1) / thread_count;
+
+                    for (size_t i = begin; i < end; i++)
+                    {
+                        seed_random(mix_bits(settings.seed + 0x9e3779b97f4a7c15ull * (i + 1)));
+
+                        double radius = random_double(0.1, 0.3);
+                        double x, z, height = 0.0;
+                        if (settings.distribution == sphere_distribution::clustered)
+                        {
+                            // Sums of uniform offsets pile spheres up towards the cluster's center.
+                            const math::point3& center = clusters[static_cast<size_t>(random_double() * cluster_count)];
+                            double spread = 0.25 * sqrt(static_cast<double>(cluster_size));
+                            x = center.x + spread * (random_double() + random_double() - 1.0);
+                            z = center.z + spread * (random_double() + random_double() - 1.0);
+                            height = 0.5 * spread * random_double() * random_double();
+                        }
+                        else
+                        {
+                            x = side * (random_double() - 0.5);
+                            z = side * (random_double() - 0.5);
+                        }
+
+                        // Rest on the curved ground.
+                        double ground = sqrt(std::max(0.0, ground_radius * ground_radius - x * x - z * z)) - ground_radius;
+                        math::point3 center(x, ground + radius + height, z);
+
+                        double choose_mat = random_double();
+                        size_t pick = static_cast<size_t>(random_double() * palette_size);
+                        shared_ptr<material> sphere_material;
+                        if (choose_mat < diffuse_share)
+                            sphere_material = palette[2 * pick];
+                        else if (choose_mat < diffuse_share + metal_share)
+                            sphere_material = palette[2 * pick + 1];
+                        else
+                            sphere_material = glass;
+
+                        world.objects[first + i] = world.arena->make<sphere>(center, radius, sphere_material);
+                    }
+                });
+        }
+
+        for (auto& thread : threads)
+            thread.join();
+
+        return world;
+    }
+}
+
+#endif // SCENE_PROCEDURAL_SCENE_HPP
@@ -0,0 +1,102 @@
+#ifndef SCENE_SCENE_ARENA_HPP
+#define SCENE_SCENE_ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace jmrtiow::scene
+{
+    /// @brief Memory of the objects, materials and textures of one scene. Allocations are carved in build
+    /// order out of large blocks, so neighbouring objects share cache lines and pages, and are never freed
+    /// one by one: the arena destroys every object made in it and releases the blocks together when it is
+    /// destroyed itself, which the hittable_list owning it does when its scene is replaced.
+    class scene_arena : public std::pmr::memory_resource
+    {
+    public:
+        /// @brief Allocator over an arena, which must outlive everything allocated with it
+        template <typename T>
+        class allocator
+        {
+        public:
+            using value_type = T;
+
+            allocator(scene_arena* arena) : arena(arena) {}
+
+            template <typename U>
+            allocator(const allocator<U>& other) : arena(other.arena) {}
+
+            T* allocate(size_t n) { return static_cast<T*>(arena->allocate(n * sizeof(T), alignof(T))); }
+            void deallocate(T* /* p */, size_t /* n */) {}
+
+            template <typename U>
+            bool operator==(const allocator<U>& other) const { return arena == other.arena; }
+
+            scene_arena* arena;
+        };
+
+        scene_arena() {}
+        ~scene_arena();
+
+        scene_arena(const scene_arena&) = delete;
+        scene_arena& operator=(const scene_arena&) = delete;
+
+        /// @brief Constructs a T in the arena. The pointer shares no ownership and counts no references,
+        /// it stays valid as long as the arena.
+        template <typename T, typename... Args>
+        std::shared_ptr<T> make(Args&&... args);
+
+    private:
+        virtual void* do_allocate(size_t bytes, size_t alignment) override
+        {
+            // Scenes may be built by several threads.
+            std::lock_guard<std::mutex> lock(mutex);
+            return memory.allocate(bytes, alignment);
+        }
+
+        virtual void do_deallocate(void* /* p */, size_t /* bytes */, size_t /* alignment */) override {}
+
+        virtual bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+        struct made_object
+        {
+        public:
+            void* object;
+            void (*destroy)(void* object);
+        };
+
+        std::mutex mutex;
+        std::pmr::monotonic_buffer_resource memory { size_t { 1 } << 16 };
+        /// @brief Objects with a destructor to run, in the order they were made
+        std::vector<made_object> made {};
+    };
+
+    inline scene_arena::~scene_arena()
+    {
+        // Later objects may refer to earlier ones, so they go first.
+        for (auto it = made.rbegin(); it != made.rend(); ++it)
+            it->destroy(it->object);
+    }
+
+    template <typename T, typename... Args>
+    std::shared_ptr<T> scene_arena::make(Args&&... args)
+    {
+        T* object = new (allocator<T>(this).allocate(1)) T(std::forward<Args>(args)...);
+
+        if constexpr (!std::is_trivially_destructible_v<T>)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            made.push_back(made_object { .object = object, .destroy = [](void* p) { static_cast<T*>(p)->~T(); } });
+        }
+
+        // The aliasing constructor with an empty owner gives a pointer without a control block.
+        return std::shared_ptr<T>(std::shared_ptr<void> {}, object);
+    }
+}
+
+#endif // SCENE_SCENE_ARENA_HPP
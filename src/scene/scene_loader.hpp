@@ -0,0 +1,120 @@
+#ifndef SCENE_SCENE_LOADER_HPP
+#define SCENE_SCENE_LOADER_HPP
+
+#include "background.hpp"
+#include "bvh.hpp"
+#include "hittable_list.hpp"
+#include "procedural_scene.hpp"
+#include "sphere_scene.hpp"
+#include "../rtweekend.hpp"
+
+#include <iostream>
+#include <memory>
+#include <string>
+
+namespace jmrtiow::scene
+{
+    /// @brief One of the built-in scenes and its parameters, everything load_scene() needs to build
+    /// the same world again
+    struct scene_description
+    {
+    public:
+        /// @brief random, demo, demo2, bouncing, checkered, perlin, earth, lights or procedural
+        std::string name;
+        /// @brief Image wrapped around the sphere of the earth scene
+        std::string texture;
+        /// @brief Parameters of the procedural scene
+        procedural_settings procedural;
+        /// @brief Interval the camera shutter is open, BVH boxes cover all of it
+        math::interval shutter;
+        /// @brief Whether to also build a sphere_scene, which renders without virtual calls
+        bool flatten;
+    };
+
+    /// @brief A built world with everything renderers trace it through
+    struct loaded_scene
+    {
+    public:
+        /// @brief Owns the scene's arena, so it is declared first and destroyed last
+        hittable_list world;
+        /// @brief BVH over world, renderers trace this instead of world
+        std::unique_ptr<bvh_node> bvh;
+        /// @brief Flat copy of world, only valid if flattened
+        sphere_scene spheres;
+        bool flattened;
+        /// @brief Emitters of world, sampled directly
+        hittable_list lights;
+        scene::background background;
+    };
+
+    /// @brief Whether name is one of the scenes load_scene() builds
+    bool is_scene_name(const std::string& name);
+
+    /// @brief Builds the world of description with its BVH, flat copy and lights
+    /// @return False if description names no scene
+    bool load_scene(const scene_description& description, loaded_scene& loaded);
+
+    inline bool is_scene_name(const std::string& name)
+    {
+        for (const char* known : { "random", "demo", "demo2", "bouncing", "checkered", "perlin", "earth", "lights", "procedural" })
+        {
+            if (name == known)
+                return true;
+        }
+
+        return false;
+    }
+
+    inline bool load_scene(const scene_description& description, loaded_scene& loaded)
+    {
+        const std::string& name = description.name;
+        if (!is_scene_name(name))
+        {
+            std::cerr << "There is no scene called " << name << "\n";
+            return false;
+        }
+
+        // Everything of the previous scene points into its world's arena, which goes last and at once.
+        loaded.lights = hittable_list {};
+        loaded.bvh.reset();
+        loaded.world = hittable_list {};
+
+        // Scenes draw from the calling thread's random stream, which starts over from its initial
+        // state so a scene comes out the same whatever was built on the thread before it.
+        seed_random(0);
+
+        if (name == "demo2")
+            loaded.world = demo_scene2();
+        else if (name == "demo")
+            loaded.world = demo_scene();
+        else if (name == "bouncing")
+            loaded.world = bouncing_scene();
+        else if (name == "checkered")
+            loaded.world = checkered_spheres();
+        else if (name == "perlin")
+            loaded.world = perlin_spheres();
+        else if (name == "earth")
+            loaded.world = earth(description.texture);
+        else if (name == "lights")
+            loaded.world = sphere_lights();
+        else if (name == "procedural")
+            loaded.world = procedural_scene(description.procedural);
+        else
+            loaded.world = random_scene();
+
+        // Node boxes cover the whole shutter interval, so moving objects are never missed.
+        loaded.bvh = std::make_unique<bvh_node>(loaded.world, description.shutter);
+
+        // Scenes of plain spheres also get a flat copy, which renders without virtual calls.
+        loaded.spheres = sphere_scene {};
+        loaded.flattened = description.flatten && loaded.spheres.build(loaded.world, description.shutter);
+
+        // Emitters are sampled directly, scenes lit only by their emitters have a black background.
+        loaded.lights = collect_lights(loaded.world);
+        loaded.background = scene::background { .sky = loaded.lights.objects.empty(), .color = math::color3(0, 0, 0) };
+
+        return true;
+    }
+}
+
+#endif // SCENE_SCENE_LOADER_HPP
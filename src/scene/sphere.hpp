@@ -2,56 +2,155 @@
 #define SCENE_SPHERE_HPP
 
 #include "hittable.hpp"
+#include "material.hpp"
+#include "../math/onb.hpp"
 #include "../math/vec3.hpp"
+#include "../stats/render_stats.hpp"
 
 namespace jmrtiow::scene
 {
-    class sphere : public hittable
+    inline void get_sphere_uv(const math::point3& p, double& u, double& v)
     {
-    public:
-        sphere() {}
-        sphere(math::point3 cen, double r, shared_ptr<material> m) : center(cen), radius(r), mat_ptr(m) {};
+        // p: a given point on the sphere of radius one, centered at the origin.
+        // u: returned value [0,1] of angle around the Y axis from X=-1.
+        // v: returned value [0,1] of angle from Y=-1 to Y=+1.
+        //     <1 0 0> yields <0.50 0.50>       <-1  0  0> yields <0.00 0.50>
+        //     <0 1 0> yields <0.50 1.00>       < 0 -1  0> yields <0.50 0.00>
+        //     <0 0 1> yields <0.25 0.50>       < 0  0 -1> yields <0.75 0.50>
 
-        virtual bool hit(
-            const math::ray& r, math::interval ray_t, hit_record& rec) const override;
+        auto theta = acos(-p.y);
+        auto phi = atan2(-p.z, p.x) + pi;
 
-    public:
-        math::point3 center;
-        double radius;
-        shared_ptr<material> mat_ptr;
-    };
+        u = phi / (2 * pi);
+        v = theta / pi;
+    }
 
-    bool sphere::hit(const math::ray& r, math::interval ray_t, hit_record& rec) const
+    inline double sphere_footprint(const math::ray& r, double t, double radius)
+    {
+        // World space width of the ray cone at t, over the length v spans on the sphere.
+        return r.spread() * t * r.direction().length() / (pi * fabs(radius));
+    }
+
+    /// @brief Nearest root within ray_t of the ray r hitting a sphere, with oc the ray origin relative to the center
+    inline bool sphere_root(const math::ray& r, const math::vec3& oc, double radius_squared, math::interval ray_t, double& root)
     {
-        math::vec3 oc = r.origin() - center;
         auto a = r.direction().length_squared();
         auto half_b = dot(oc, r.direction());
-        auto c = oc.length_squared() - radius * radius;
+        auto c = oc.length_squared() - radius_squared;
 
         auto discriminant = half_b * half_b - a * c;
         if (discriminant < 0)
             return false;
         auto sqrtd = sqrt(discriminant);
+        auto inv_a = 1.0 / a;
 
         // Find the nearest root that lies in the acceptable range.
-        auto root = (-half_b - sqrtd) / a;
+        root = (-half_b - sqrtd) * inv_a;
         if (!ray_t.surrounds(root))
         {
-            root = (-half_b + sqrtd) / a;
+            root = (-half_b + sqrtd) * inv_a;
             if (!ray_t.surrounds(root))
                 return false;
         }
 
-        rec.t = root;
+        return true;
+    }
+
+    class sphere : public hittable
+    {
+    public:
+        sphere() {}
+        sphere(const math::point3& cen, double r, shared_ptr<material> m)
+            : center(cen), radius(r), radius_squared(r * r), inv_radius(1.0 / r), mat_ptr(m) {};
+
+        virtual bool closest_hit(const math::ray& r, math::interval ray_t, hit_candidate& closest) const override;
+
+        virtual void set_surface(const math::ray& r, double t, hit_record& rec) const override;
+
+        virtual bool hit_any(const math::ray& r, math::interval ray_t) const override;
+
+        virtual math::aabb bounding_box(math::interval shutter) const override;
+
+        virtual bool is_light() const override { return mat_ptr->emissive(); }
+
+        virtual double pdf_value(const math::point3& origin, const math::vec3& direction) const override;
+
+        virtual math::vec3 random(const math::point3& origin) const override;
+
+    public:
+        math::point3 center;
+        double radius;
+        double radius_squared;
+        /// @brief Negative for the inward facing normals of negative radii
+        double inv_radius;
+        shared_ptr<material> mat_ptr;
+    };
+
+    inline bool sphere::closest_hit(const math::ray& r, math::interval ray_t, hit_candidate& closest) const
+    {
+        stats::local().primitive_tests++;
+
+        double root;
+        if (!sphere_root(r, r.origin() - center, radius_squared, ray_t, root))
+            return false;
+
+        closest = hit_candidate { .t = root, .object = this };
+        return true;
+    }
+
+    inline void sphere::set_surface(const math::ray& r, double t, hit_record& rec) const
+    {
+        rec.t = t;
         rec.p = r.at(rec.t);
-        math::vec3 outward_normal = (rec.p - center) / radius;
+        math::vec3 outward_normal = (rec.p - center) * inv_radius;
         rec.set_face_normal(r, outward_normal);
-        rec.mat_ptr = mat_ptr;
+        get_sphere_uv(outward_normal, rec.u, rec.v);
+        rec.footprint = sphere_footprint(r, rec.t, radius);
+        rec.mat_ptr = mat_ptr.get();
+    }
 
-        return true;
+    inline bool sphere::hit_any(const math::ray& r, math::interval ray_t) const
+    {
+        stats::local().primitive_tests++;
+
+        double root;
+        return sphere_root(r, r.origin() - center, radius_squared, ray_t, root);
+    }
+
+    inline math::aabb sphere::bounding_box(math::interval shutter) const
+    {
+        math::vec3 rvec(fabs(radius), fabs(radius), fabs(radius));
+        return math::aabb(center - rvec, center + rvec);
+    }
+
+    inline double sphere::pdf_value(const math::point3& origin, const math::vec3& direction) const
+    {
+        // This method only works for stationary spheres seen from outside.
+        if (!this->hit_any(math::ray(origin, direction), math::interval(0.001, infinity)))
+            return 0;
+
+        auto distance_squared = (center - origin).length_squared();
+        if (distance_squared <= radius_squared)
+            return 0;
+
+        auto cos_theta_max = sqrt(1 - radius_squared / distance_squared);
+        auto solid_angle = 2 * pi * (1 - cos_theta_max);
+
+        return 1 / solid_angle;
+    }
+
+    inline math::vec3 sphere::random(const math::point3& origin) const
+    {
+        math::vec3 direction = center - origin;
+        auto distance_squared = direction.length_squared();
+        if (distance_squared <= radius_squared)
+            return math::random_unit_vector();
+
+        math::onb uvw(direction);
+        return uvw.transform(math::random_to_sphere(radius, distance_squared));
     }
 
-    double hit_sphere(const math::point3& center, double radius, const math::ray& r)
+    inline double hit_sphere(const math::point3& center, double radius, const math::ray& r)
     {
         math::vec3 oc = r.origin() - center;
         auto a = r.direction().length_squared();
@@ -0,0 +1,328 @@
+#ifndef SCENE_SPHERE_SCENE_HPP
+#define SCENE_SPHERE_SCENE_HPP
+
+#include "aov_sample.hpp"
+#include "background.hpp"
+#include "hittable_list.hpp"
+#include "material.hpp"
+#include "sphere.hpp"
+#include "texture.hpp"
+#include "../stats/render_stats.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+namespace jmrtiow::scene
+{
+    /// @brief A scene of static spheres with solid color lambertian, metal or dielectric materials,
+    /// flattened into arrays with a bounding volume hierarchy over them. Hits, traversal and scattering
+    /// are plain member functions, so a kernel tracing it needs no virtual calls and no reference counted
+    /// material pointers. Results are the same as tracing the scene's bvh_node.
+    class sphere_scene
+    {
+    public:
+        enum class material_kind : uint8_t
+        {
+            lambertian,
+            metal,
+            dielectric,
+        };
+
+        struct surface
+        {
+        public:
+            material_kind kind;
+            /// @brief Attenuation of lambertian and metal surfaces
+            math::color3 albedo;
+            double fuzz;
+            double ir;
+        };
+
+        struct hit
+        {
+        public:
+            math::point3 p;
+            math::vec3 normal;
+            double t;
+            uint32_t surface_id;
+            bool front_face;
+        };
+
+        /// @brief Flattens world. Fails, leaving the scene empty, if world holds anything else than
+        /// spheres with the supported materials.
+        bool build(const hittable_list& world, math::interval shutter);
+
+        bool intersect(const math::ray& r, math::interval ray_t, hit& rec) const;
+
+        bool scatter(const math::ray& r_in, const hit& rec, math::color3& attenuation, math::ray& scattered) const;
+
+        /// @brief Path traced radiance along r, the same as ray_color() without lights. Every bounce is
+        /// traced through Target::run(), so all of them are compiled for Target.
+        template <typename Target = math::simd::baseline_target>
+        math::color3 ray_color(const math::ray& r, const background& background, int depth, aov_sample* aov = nullptr) const;
+
+    private:
+        struct sphere_data
+        {
+        public:
+            math::point3 center;
+            double radius_squared;
+            double inv_radius;
+            uint32_t surface_id;
+        };
+
+        /// @brief Inner nodes have count 0, their left child follows them and right is the index of the
+        /// right one. Leaves hold count spheres from first on, as bvh_node keeps one or two objects.
+        struct node
+        {
+        public:
+            math::aabb box;
+            uint32_t first;
+            uint32_t count;
+            uint32_t right;
+        };
+
+        bool add_surface(const material* mat, uint32_t& index);
+        uint32_t build_nodes(std::vector<std::pair<math::aabb, uint32_t>>& boxed, size_t start, size_t end);
+
+        std::vector<sphere_data> spheres;
+        std::vector<surface> surfaces;
+        std::vector<node> nodes;
+    };
+
+    inline bool sphere_scene::build(const hittable_list& world, math::interval shutter)
+    {
+        spheres.clear();
+        surfaces.clear();
+        nodes.clear();
+
+        std::vector<std::pair<math::aabb, uint32_t>> boxed {};
+        boxed.reserve(world.objects.size());
+
+        // Large scenes share a few materials between many spheres, each is converted once.
+        std::unordered_map<const material*, uint32_t> converted {};
+
+        for (const auto& object : world.objects)
+        {
+            auto* s = dynamic_cast<const sphere*>(object.get());
+            if (s == nullptr)
+            {
+                spheres.clear();
+                surfaces.clear();
+                return false;
+            }
+
+            auto known = converted.find(s->mat_ptr.get());
+            uint32_t surface_index = known != converted.end() ? known->second : 0;
+            if (known == converted.end())
+            {
+                if (!add_surface(s->mat_ptr.get(), surface_index))
+                {
+                    spheres.clear();
+                    surfaces.clear();
+                    return false;
+                }
+                converted.emplace(s->mat_ptr.get(), surface_index);
+            }
+
+            boxed.emplace_back(s->bounding_box(shutter), static_cast<uint32_t>(spheres.size()));
+            spheres.push_back(sphere_data { .center = s->center, .radius_squared = s->radius_squared, .inv_radius = s->inv_radius, .surface_id = surface_index });
+        }
+
+        if (!boxed.empty())
+            build_nodes(boxed, 0, boxed.size());
+
+        // Spheres are stored in leaf order, so leaves address them as ranges.
+        std::vector<sphere_data> ordered {};
+        ordered.reserve(spheres.size());
+        for (const auto& entry : boxed)
+            ordered.push_back(spheres[entry.second]);
+        spheres.swap(ordered);
+
+        return true;
+    }
+
+    inline bool sphere_scene::add_surface(const material* mat, uint32_t& index)
+    {
+        surface entry {};
+
+        if (auto* diffuse = dynamic_cast<const lambertian*>(mat))
+        {
+            // Only constant albedos, other textures need the texture coordinates of the hit.
+            auto* albedo = dynamic_cast<const solid_color*>(diffuse->albedo.get());
+            if (albedo == nullptr)
+                return false;
+            entry = surface { .kind = material_kind::lambertian, .albedo = albedo->value(0, 0, math::point3(0, 0, 0), 0), .fuzz = 0, .ir = 0 };
+        }
+        else if (auto* specular = dynamic_cast<const metal*>(mat))
+            entry = surface { .kind = material_kind::metal, .albedo = specular->albedo, .fuzz = specular->fuzz, .ir = 0 };
+        else if (auto* glass = dynamic_cast<const dielectric*>(mat))
+            entry = surface { .kind = material_kind::dielectric, .albedo = math::color3(1.0, 1.0, 1.0), .fuzz = 0, .ir = glass->ir };
+        else
+            return false;
+
+        // Equal materials made separately share a surface too.
+        for (index = 0; index < surfaces.size(); index++)
+        {
+            const surface& s = surfaces[index];
+            if (s.kind == entry.kind && s.albedo.r == entry.albedo.r && s.albedo.g == entry.albedo.g && s.albedo.b == entry.albedo.b
+                && s.fuzz == entry.fuzz && s.ir == entry.ir)
+                return true;
+        }
+
+        surfaces.push_back(entry);
+        return true;
+    }
+
+    inline uint32_t sphere_scene::build_nodes(std::vector<std::pair<math::aabb, uint32_t>>& boxed, size_t start, size_t end)
+    {
+        // Splits as bvh_node does, so both trees find the same closest hits.
+        uint32_t index = static_cast<uint32_t>(nodes.size());
+        nodes.push_back(node { .box = math::aabb(math::interval::empty, math::interval::empty, math::interval::empty), .first = 0, .count = 0, .right = 0 });
+
+        math::aabb box = nodes[index].box;
+        for (size_t i = start; i < end; i++)
+            box = math::aabb(box, boxed[i].first);
+        nodes[index].box = box;
+
+        size_t object_span = end - start;
+
+        if (object_span <= 2)
+        {
+            nodes[index].first = static_cast<uint32_t>(start);
+            nodes[index].count = static_cast<uint32_t>(object_span);
+            return index;
+        }
+
+        int axis = box.longest_axis();
+        auto mid = boxed.begin() + start + object_span / 2;
+
+        std::nth_element(boxed.begin() + start, mid, boxed.begin() + end, [axis](const auto& a, const auto& b)
+            {
+                return a.first.centroid()[axis] < b.first.centroid()[axis];
+            });
+
+        size_t split = start + object_span / 2;
+        build_nodes(boxed, start, split);
+        uint32_t right = build_nodes(boxed, split, end);
+        nodes[index].right = right;
+
+        return index;
+    }
+
+    inline bool sphere_scene::intersect(const math::ray& r, math::interval ray_t, hit& rec) const
+    {
+        stats::counters& counters = stats::local();
+
+        if (nodes.empty())
+            return false;
+
+        // Traversal only keeps the closest t and its sphere, the surface is worked out once at the end.
+        uint32_t closest = UINT32_MAX;
+
+        // Left children are visited first and right ones see the closest hit found so far, as in bvh_node.
+        uint32_t stack[64];
+        uint32_t stack_size = 0;
+        stack[stack_size++] = 0;
+
+        while (stack_size > 0)
+        {
+            const node& n = nodes[stack[--stack_size]];
+            counters.bvh_nodes++;
+
+            if (!n.box.hit(r, ray_t))
+                continue;
+
+            if (n.count == 0)
+            {
+                stack[stack_size++] = n.right;
+                stack[stack_size++] = static_cast<uint32_t>(&n - nodes.data()) + 1;
+                continue;
+            }
+
+            for (uint32_t i = n.first; i < n.first + n.count; i++)
+            {
+                counters.primitive_tests++;
+
+                double root;
+                if (sphere_root(r, r.origin() - spheres[i].center, spheres[i].radius_squared, ray_t, root))
+                {
+                    ray_t.max = root;
+                    closest = i;
+                }
+            }
+        }
+
+        if (closest == UINT32_MAX)
+            return false;
+
+        const sphere_data& s = spheres[closest];
+        rec.t = ray_t.max;
+        rec.p = r.at(rec.t);
+        math::vec3 outward_normal = (rec.p - s.center) * s.inv_radius;
+        rec.front_face = dot(r.direction(), outward_normal) < 0;
+        rec.normal = rec.front_face ? outward_normal : -outward_normal;
+        rec.surface_id = s.surface_id;
+
+        return true;
+    }
+
+    inline bool sphere_scene::scatter(const math::ray& r_in, const hit& rec, math::color3& attenuation, math::ray& scattered) const
+    {
+        const surface& s = surfaces[rec.surface_id];
+        attenuation = s.albedo;
+
+        switch (s.kind)
+        {
+        case material_kind::lambertian:
+            scattered = math::ray(rec.p, lambertian::scatter_direction(rec.normal), r_in.time(), r_in.spread());
+            return true;
+        case material_kind::metal:
+            return metal::scatter_ray(r_in, rec.p, rec.normal, s.fuzz, scattered);
+        case material_kind::dielectric:
+            scattered = math::ray(rec.p, dielectric::scatter_direction(r_in.direction(), rec.normal, rec.front_face, s.ir), r_in.time(), r_in.spread());
+            return true;
+        }
+
+        return false;
+    }
+
+    template <typename Target>
+    inline math::color3 sphere_scene::ray_color(const math::ray& r, const background& background, int depth, aov_sample* aov) const
+    {
+        hit rec;
+
+        // If we've exceeded the math::ray bounce limit, no more light is gathered.
+        if (depth <= 0)
+            return math::color3(0, 0, 0);
+
+        stats::local().rays++;
+        if (intersect(r, math::interval(0.0001, infinity), rec))
+        {
+            math::ray scattered;
+            math::color3 attenuation;
+            bool scatters = scatter(r, rec, attenuation, scattered);
+
+            if (aov != nullptr)
+            {
+                aov->albedo = scatters ? attenuation : math::color3(0, 0, 0);
+                aov->normal = rec.normal;
+                aov->depth = rec.t * r.direction().length();
+            }
+
+            if (!scatters)
+                return math::color3(0, 0, 0);
+
+            return attenuation * Target::run([&]() { return ray_color<Target>(scattered, background, depth - 1); });
+        }
+
+        math::color3 sky = background.value(r);
+        if (aov != nullptr)
+            *aov = aov_sample { .albedo = sky, .normal = math::vec3(0, 0, 0), .depth = 0.0 };
+
+        return sky;
+    }
+}
+
+#endif // SCENE_SPHERE_SCENE_HPP
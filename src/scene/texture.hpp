@@ -0,0 +1,155 @@
+#ifndef SCENE_TEXTURE_HPP
+#define SCENE_TEXTURE_HPP
+
+#include "../rtweekend.hpp"
+#include "perlin.hpp"
+#include "texture_cache.hpp"
+
+#include <string>
+
+namespace jmrtiow::scene
+{
+    class texture
+    {
+    public:
+        /// @brief Color at texture coordinates (u, v) and point p. footprint is the width of the
+        /// sampled area in texture coordinates, textures with detail levels use it to filter.
+        virtual math::color3 value(double u, double v, const math::point3& p, double footprint) const = 0;
+    };
+
+    class solid_color : public texture
+    {
+    public:
+        solid_color(const math::color3& c) : color_value(c) {}
+
+        solid_color(double red, double green, double blue) : solid_color(math::color3(red, green, blue)) {}
+
+        virtual math::color3 value(double /* u */, double /* v */, const math::point3& /* p */, double /* footprint */) const override
+        {
+            return color_value;
+        }
+
+    private:
+        math::color3 color_value;
+    };
+
+    class checker_texture : public texture
+    {
+    public:
+        checker_texture(double scale, shared_ptr<texture> even, shared_ptr<texture> odd)
+            : inv_scale(1.0 / scale), even(even), odd(odd)
+        {
+        }
+
+        checker_texture(double scale, const math::color3& c1, const math::color3& c2)
+            : checker_texture(scale, make_shared<solid_color>(c1), make_shared<solid_color>(c2))
+        {
+        }
+
+        virtual math::color3 value(double u, double v, const math::point3& p, double footprint) const override
+        {
+            auto x = static_cast<int>(std::floor(inv_scale * p.x));
+            auto y = static_cast<int>(std::floor(inv_scale * p.y));
+            auto z = static_cast<int>(std::floor(inv_scale * p.z));
+
+            bool is_even = (x + y + z) % 2 == 0;
+
+            return is_even ? even->value(u, v, p, footprint) : odd->value(u, v, p, footprint);
+        }
+
+    private:
+        double inv_scale;
+        shared_ptr<texture> even;
+        shared_ptr<texture> odd;
+    };
+
+    class noise_texture : public texture
+    {
+    public:
+        noise_texture(double scale) : scale(scale) {}
+
+        virtual math::color3 value(double /* u */, double /* v */, const math::point3& p, double /* footprint */) const override
+        {
+            return math::color3(.5, .5, .5) * (1 + sin(scale * p.z + 10 * noise.turb(p, 7)));
+        }
+
+    private:
+        perlin noise;
+        double scale;
+    };
+
+    /// @brief Image file texture, paged in through a texture_cache and filtered trilinearly
+    /// between the two mip levels closest to the footprint.
+    class image_texture : public texture
+    {
+    public:
+        image_texture(const std::string& filepath, shared_ptr<texture_cache> cache = texture_cache::shared())
+            : cache(cache), info {}
+        {
+            handle = cache->add(filepath, info);
+            if (handle < 0)
+                std::cerr << "Could not read texture image " << filepath << '\n';
+        }
+
+        ~image_texture()
+        {
+            if (handle >= 0)
+                cache->release(handle);
+        }
+
+        image_texture(const image_texture&) = delete;
+        image_texture& operator=(const image_texture&) = delete;
+
+        virtual math::color3 value(double u, double v, const math::point3& /* p */, double footprint) const override
+        {
+            // If we have no texture data, then return solid cyan as a debugging aid.
+            if (handle < 0)
+                return math::color3(0, 1, 1);
+
+            // Clamp input texture coordinates to [0,1] x [1,0], images are stored top row first.
+            u = clamp(u, 0.0, 1.0);
+            v = 1.0 - clamp(v, 0.0, 1.0);
+
+            double lod = std::log2(std::max(footprint * std::max(info.width, info.height), 1.0));
+            lod = std::min(lod, static_cast<double>(info.levels - 1));
+
+            uint32_t level = static_cast<uint32_t>(lod);
+            double blend = lod - level;
+
+            math::color3 color = sample_level(level, u, v);
+            if (blend > 0 && level + 1 < info.levels)
+                color = (1 - blend) * color + blend * sample_level(level + 1, u, v);
+
+            return color;
+        }
+
+    private:
+        math::color3 sample_level(uint32_t level, double u, double v) const
+        {
+            uint32_t width = std::max(1u, info.width >> level);
+            uint32_t height = std::max(1u, info.height >> level);
+
+            // Bilinear filter between the four texels around the sample point.
+            double x = u * width - 0.5;
+            double y = v * height - 0.5;
+            double fx = x - std::floor(x);
+            double fy = y - std::floor(y);
+
+            uint32_t x0 = static_cast<uint32_t>(clamp(std::floor(x), 0, width - 1));
+            uint32_t y0 = static_cast<uint32_t>(clamp(std::floor(y), 0, height - 1));
+            uint32_t x1 = std::min(x0 + 1, width - 1);
+            uint32_t y1 = std::min(y0 + 1, height - 1);
+
+            math::color3 top = (1 - fx) * cache->texel(handle, level, x0, y0) + fx * cache->texel(handle, level, x1, y0);
+            math::color3 bottom = (1 - fx) * cache->texel(handle, level, x0, y1) + fx * cache->texel(handle, level, x1, y1);
+
+            return (1 - fy) * top + fy * bottom;
+        }
+
+        shared_ptr<texture_cache> cache;
+        texture_cache::image_info info;
+        int32_t handle;
+    };
+}
+
+#endif // SCENE_TEXTURE_HPP
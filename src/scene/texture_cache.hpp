@@ -0,0 +1,427 @@
+#ifndef SCENE_TEXTURE_CACHE_HPP
+#define SCENE_TEXTURE_CACHE_HPP
+
+#include "../rtweekend.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#define STB_IMAGE_STATIC
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+namespace jmrtiow::scene
+{
+    /// @brief Mip-mapped image texels stored in fixed size tiles, shared by every image texture.
+    /// Textures of the same unchanged file share one entry, which is dropped with its tiles and
+    /// tiled copy once the last of them is released. Images are only read when one of their tiles
+    /// is first needed. The least recently used
+    /// tiles are dropped once the resident tiles exceed the memory budget, and are read back
+    /// from a tiled copy of the image on disk when needed again.
+    class texture_cache
+    {
+    public:
+        /// @brief Edge length of a tile in texels
+        static constexpr uint32_t tile_size = 64;
+
+        /// @brief Linear RGB texels of one tile, row by row
+        struct tile
+        {
+            std::vector<float> texels;
+        };
+
+        /// @brief Size of an image and its number of mip levels
+        struct image_info
+        {
+            uint32_t width;
+            uint32_t height;
+            uint32_t levels;
+        };
+
+        texture_cache(size_t budget_bytes) : budget_bytes(budget_bytes), resident(0) {}
+        ~texture_cache();
+
+        texture_cache(const texture_cache&) = delete;
+        texture_cache& operator=(const texture_cache&) = delete;
+
+        /// @brief Cache used by image textures that are not given one
+        static const shared_ptr<texture_cache>& shared();
+
+        void set_budget(size_t bytes);
+        size_t resident_bytes() const;
+
+        /// @brief Registers an image file, only reading its header, or takes another reference to the
+        /// entry of the same file if it was not modified since.
+        /// @return Handle of the image, or -1 if the file is not a readable image
+        int32_t add(const std::string& filepath, image_info& info);
+
+        /// @brief Drops a reference add() returned, the image's tiles and tiled copy go with the last one.
+        /// Handles are not reused, a thread still remembering a tile of a released image never finds it.
+        void release(int32_t handle);
+
+        /// @brief Linear RGB texel of a mip level, paging its tile in if needed.
+        math::color3 texel(int32_t handle, uint32_t level, uint32_t x, uint32_t y);
+
+    private:
+        struct texture_entry
+        {
+            std::string filepath;
+            std::filesystem::file_time_type modified;
+            image_info info;
+            // Textures holding the handle, see release().
+            uint32_t references = 0;
+            // Held while an image is decoded, so concurrent misses decode it once.
+            std::mutex load_mutex;
+            bool failed = false;
+            // Tiled mip levels, written on the first miss.
+            int tiles_fd = -1;
+            std::vector<uint64_t> level_offsets;
+            std::vector<uint32_t> level_tiles_x;
+        };
+
+        struct cached_tile
+        {
+            shared_ptr<const tile> data;
+            std::list<uint64_t>::iterator lru_position;
+        };
+
+        static uint64_t tile_key(int32_t handle, uint32_t level, uint32_t tile_x, uint32_t tile_y)
+        {
+            return static_cast<uint64_t>(handle) << 47 | static_cast<uint64_t>(level) << 42 | static_cast<uint64_t>(tile_y) << 21 | tile_x;
+        }
+
+        shared_ptr<const tile> find(uint64_t key);
+        void insert(uint64_t key, shared_ptr<const tile> data);
+        bool convert(texture_entry& entry);
+        shared_ptr<const tile> page_in(int32_t handle, uint32_t level, uint32_t tile_x, uint32_t tile_y);
+
+        mutable std::mutex mutex;
+        // Indexed by handle, released entries are null.
+        std::vector<std::unique_ptr<texture_entry>> textures;
+        // Handle of the newest entry of each canonical file path.
+        std::unordered_map<std::string, int32_t> handles;
+        std::unordered_map<uint64_t, cached_tile> tiles;
+        // Most recently used tile keys first.
+        std::list<uint64_t> lru;
+        size_t budget_bytes;
+        size_t resident;
+    };
+
+    inline const shared_ptr<texture_cache>& texture_cache::shared()
+    {
+        static shared_ptr<texture_cache> cache = make_shared<texture_cache>(size_t { 1024 } << 20);
+        return cache;
+    }
+
+    inline texture_cache::~texture_cache()
+    {
+        for (auto& entry : textures)
+        {
+            if (entry && entry->tiles_fd >= 0)
+                close(entry->tiles_fd);
+        }
+    }
+
+    inline void texture_cache::set_budget(size_t bytes)
+    {
+        std::lock_guard lock(mutex);
+        budget_bytes = bytes;
+    }
+
+    inline size_t texture_cache::resident_bytes() const
+    {
+        std::lock_guard lock(mutex);
+        return resident;
+    }
+
+    inline int32_t texture_cache::add(const std::string& filepath, image_info& info)
+    {
+        // Paths are compared canonical, so the same file named two ways is still converted once.
+        std::error_code error;
+        std::filesystem::path path = std::filesystem::weakly_canonical(filepath, error);
+        if (error)
+            path = filepath;
+        auto modified = std::filesystem::last_write_time(path, error);
+
+        std::lock_guard lock(mutex);
+
+        auto found = handles.find(path.string());
+        if (found != handles.end() && textures[found->second]->modified == modified)
+        {
+            texture_entry& entry = *textures[found->second];
+            entry.references++;
+            info = entry.info;
+            return found->second;
+        }
+
+        // Tile keys hold 17 bits of handle.
+        int width, height, components;
+        if (textures.size() >= (size_t { 1 } << 17) || !stbi_info(filepath.c_str(), &width, &height, &components))
+            return -1;
+
+        info.width = width;
+        info.height = height;
+        info.levels = 1;
+        while ((std::max(info.width, info.height) >> info.levels) > 0)
+            info.levels++;
+
+        auto entry = std::make_unique<texture_entry>();
+        entry->filepath = path.string();
+        entry->modified = modified;
+        entry->info = info;
+        entry->references = 1;
+
+        // An entry of an older version of the file lives on until its textures release it.
+        int32_t handle = static_cast<int32_t>(textures.size());
+        textures.push_back(std::move(entry));
+        handles[path.string()] = handle;
+        return handle;
+    }
+
+    inline void texture_cache::release(int32_t handle)
+    {
+        std::lock_guard lock(mutex);
+
+        std::unique_ptr<texture_entry>& entry = textures[handle];
+        if (--entry->references > 0)
+            return;
+
+        auto newest = handles.find(entry->filepath);
+        if (newest != handles.end() && newest->second == handle)
+            handles.erase(newest);
+
+        for (uint32_t level = 0; level < entry->level_offsets.size(); level++)
+        {
+            uint32_t tiles_x = entry->level_tiles_x[level];
+            uint32_t tiles_y = (std::max(1u, entry->info.height >> level) + tile_size - 1) / tile_size;
+
+            for (uint32_t tile_y = 0; tile_y < tiles_y; tile_y++)
+            {
+                for (uint32_t tile_x = 0; tile_x < tiles_x; tile_x++)
+                {
+                    auto found = tiles.find(tile_key(handle, level, tile_x, tile_y));
+                    if (found == tiles.end())
+                        continue;
+
+                    resident -= found->second.data->texels.size() * sizeof(float);
+                    lru.erase(found->second.lru_position);
+                    tiles.erase(found);
+                }
+            }
+        }
+
+        if (entry->tiles_fd >= 0)
+            close(entry->tiles_fd);
+        entry.reset();
+    }
+
+    inline math::color3 texture_cache::texel(int32_t handle, uint32_t level, uint32_t x, uint32_t y)
+    {
+        // Neighbouring lookups almost always land in the same tile, so each thread remembers
+        // the last one and skips the shared map and its lock.
+        struct recent_tile
+        {
+            const texture_cache* cache = nullptr;
+            uint64_t key = 0;
+            shared_ptr<const tile> data;
+        };
+        thread_local recent_tile recent;
+
+        uint32_t tile_x = x / tile_size;
+        uint32_t tile_y = y / tile_size;
+        uint64_t key = tile_key(handle, level, tile_x, tile_y);
+
+        if (recent.cache != this || recent.key != key || !recent.data)
+        {
+            auto data = find(key);
+            if (!data)
+                data = page_in(handle, level, tile_x, tile_y);
+            if (!data)
+                return math::color3(0, 1, 1);
+
+            recent = recent_tile { .cache = this, .key = key, .data = std::move(data) };
+        }
+
+        const tile& t = *recent.data;
+        const float* texel = &t.texels[((y % tile_size) * tile_size + (x % tile_size)) * 3];
+        return math::color3(texel[0], texel[1], texel[2]);
+    }
+
+    inline shared_ptr<const texture_cache::tile> texture_cache::find(uint64_t key)
+    {
+        std::lock_guard lock(mutex);
+
+        auto found = tiles.find(key);
+        if (found == tiles.end())
+            return nullptr;
+
+        lru.splice(lru.begin(), lru, found->second.lru_position);
+        return found->second.data;
+    }
+
+    inline void texture_cache::insert(uint64_t key, shared_ptr<const tile> data)
+    {
+        std::lock_guard lock(mutex);
+
+        if (tiles.contains(key))
+            return;
+
+        resident += data->texels.size() * sizeof(float);
+        lru.push_front(key);
+        tiles.emplace(key, cached_tile { .data = std::move(data), .lru_position = lru.begin() });
+
+        // Evicted tiles stay alive for any thread still sampling them through a shared_ptr.
+        while (resident > budget_bytes && lru.size() > 1)
+        {
+            auto evicted = tiles.find(lru.back());
+            resident -= evicted->second.data->texels.size() * sizeof(float);
+            tiles.erase(evicted);
+            lru.pop_back();
+        }
+    }
+
+    inline bool texture_cache::convert(texture_entry& entry)
+    {
+        int width, height, components;
+        float* pixels = stbi_loadf(entry.filepath.c_str(), &width, &height, &components, 3);
+        if (pixels == nullptr)
+            return false;
+
+        // The tiled copy is unlinked right away, it lives as long as the descriptor and never outlives the process.
+        auto tiled_path = std::filesystem::temp_directory_path() / ("rtiow-" + std::to_string(getpid()) + "-" + std::to_string(reinterpret_cast<uintptr_t>(&entry)) + ".tiles");
+        int fd = open(tiled_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+        if (fd < 0)
+        {
+            stbi_image_free(pixels);
+            return false;
+        }
+        unlink(tiled_path.c_str());
+
+        uint32_t level_width = width;
+        uint32_t level_height = height;
+        std::vector<float> level_texels(pixels, pixels + static_cast<size_t>(width) * height * 3);
+        stbi_image_free(pixels);
+
+        std::vector<float> tile_texels(tile_size * tile_size * 3);
+        uint64_t offset = 0;
+        bool written = true;
+
+        for (uint32_t level = 0; level < entry.info.levels && written; level++)
+        {
+            uint32_t tiles_x = (level_width + tile_size - 1) / tile_size;
+            uint32_t tiles_y = (level_height + tile_size - 1) / tile_size;
+            entry.level_offsets.push_back(offset);
+            entry.level_tiles_x.push_back(tiles_x);
+
+            for (uint32_t tile_y = 0; tile_y < tiles_y && written; tile_y++)
+            {
+                for (uint32_t tile_x = 0; tile_x < tiles_x && written; tile_x++)
+                {
+                    // Edge tiles are padded by repeating the last texel, so every tile has the same size.
+                    for (uint32_t y = 0; y < tile_size; y++)
+                    {
+                        uint32_t source_y = std::min(tile_y * tile_size + y, level_height - 1);
+
+                        for (uint32_t x = 0; x < tile_size; x++)
+                        {
+                            uint32_t source_x = std::min(tile_x * tile_size + x, level_width - 1);
+                            std::memcpy(&tile_texels[(y * tile_size + x) * 3], &level_texels[(source_y * level_width + source_x) * 3], 3 * sizeof(float));
+                        }
+                    }
+
+                    size_t tile_bytes = tile_texels.size() * sizeof(float);
+                    written = pwrite(fd, tile_texels.data(), tile_bytes, offset) == static_cast<ssize_t>(tile_bytes);
+                    offset += tile_bytes;
+                }
+            }
+
+            if (level + 1 == entry.info.levels)
+                break;
+
+            // 2x2 box filter down to the next level, clamping at odd edges.
+            uint32_t next_width = std::max(1u, level_width / 2);
+            uint32_t next_height = std::max(1u, level_height / 2);
+            std::vector<float> next_texels(static_cast<size_t>(next_width) * next_height * 3);
+
+            for (uint32_t y = 0; y < next_height; y++)
+            {
+                uint32_t y0 = std::min(y * 2, level_height - 1);
+                uint32_t y1 = std::min(y * 2 + 1, level_height - 1);
+
+                for (uint32_t x = 0; x < next_width; x++)
+                {
+                    uint32_t x0 = std::min(x * 2, level_width - 1);
+                    uint32_t x1 = std::min(x * 2 + 1, level_width - 1);
+
+                    for (uint32_t c = 0; c < 3; c++)
+                    {
+                        next_texels[(y * next_width + x) * 3 + c] = 0.25f * (level_texels[(y0 * level_width + x0) * 3 + c] + level_texels[(y0 * level_width + x1) * 3 + c] + level_texels[(y1 * level_width + x0) * 3 + c] + level_texels[(y1 * level_width + x1) * 3 + c]);
+                    }
+                }
+            }
+
+            level_texels = std::move(next_texels);
+            level_width = next_width;
+            level_height = next_height;
+        }
+
+        if (!written)
+        {
+            close(fd);
+            return false;
+        }
+
+        entry.tiles_fd = fd;
+        return true;
+    }
+
+    inline shared_ptr<const texture_cache::tile> texture_cache::page_in(int32_t handle, uint32_t level, uint32_t tile_x, uint32_t tile_y)
+    {
+        texture_entry* entry;
+        {
+            std::lock_guard lock(mutex);
+            entry = textures[handle].get();
+        }
+
+        uint64_t key = tile_key(handle, level, tile_x, tile_y);
+
+        {
+            std::lock_guard load_lock(entry->load_mutex);
+
+            // Another thread may have converted the image or paged the tile in while this one waited.
+            if (auto data = find(key))
+                return data;
+
+            // The first miss decodes the source image once into tiled mip levels on disk, later
+            // misses only read the tile they need.
+            if (entry->tiles_fd < 0 && (entry->failed || !convert(*entry)))
+            {
+                entry->failed = true;
+                return nullptr;
+            }
+        }
+
+        auto data = make_shared<tile>();
+        data->texels.resize(tile_size * tile_size * 3);
+
+        size_t tile_bytes = data->texels.size() * sizeof(float);
+        uint64_t offset = entry->level_offsets[level] + (static_cast<uint64_t>(tile_y) * entry->level_tiles_x[level] + tile_x) * tile_bytes;
+
+        if (pread(entry->tiles_fd, data->texels.data(), tile_bytes, offset) != static_cast<ssize_t>(tile_bytes))
+            return nullptr;
+
+        insert(key, data);
+        return data;
+    }
+}
+
+#endif // SCENE_TEXTURE_CACHE_HPP
@@ -0,0 +1,218 @@
+#ifndef SERVER_PROTOCOL_HPP
+#define SERVER_PROTOCOL_HPP
+
+#include <stdint.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <string>
+
+#include "../core/rtiow_core.hpp"
+#include "../distributed/protocol.hpp"
+
+namespace jmrtiow::server
+{
+    // Clients talk to the server over a Unix domain socket on the same machine, so messages are
+    // raw structs in native byte order like those of the distributed workers. A client sends
+    // requests and reads replies until its jobs finished; pixels follow tile replies as
+    // core::rgb values, top row first.
+
+    constexpr uint32_t request_magic = 0x51455252; // "RREQ"
+    constexpr uint32_t reply_magic = 0x504c5252;   // "RRLP"
+
+    /// @brief Raised whenever a message changes, the server refuses requests of other versions
+    constexpr uint32_t protocol_version = 1;
+
+    /// @brief Largest image edge the server renders, larger requests are refused before anything is allocated
+    constexpr uint32_t max_image_edge = 16384;
+    /// @brief Most spheres of a procedural scene the server builds
+    constexpr uint64_t max_sphere_count = 10000000;
+
+    enum class request_kind : uint32_t
+    {
+        /// @brief Queue a render job
+        render,
+        /// @brief Stop the server once the running job finished
+        shutdown,
+    };
+
+    /// @brief Render job. Requests of other kinds only fill in the fields up to kind.
+    struct request_message
+    {
+    public:
+        /// @brief Always request_magic, used to detect a desynchronised stream
+        uint32_t magic;
+        /// @brief Always protocol_version
+        uint32_t version;
+        request_kind kind;
+
+        // Scene, see core::scene_settings. Scenes of equal fields are built once and cached.
+
+        char scene[32];
+        char texture[256];
+        uint64_t sphere_count;
+        uint32_t clustered;
+        uint32_t flatten;
+        double diffuse_weight;
+        double metal_weight;
+        double glass_weight;
+        uint64_t scene_seed;
+        double shutter_open;
+        double shutter_close;
+
+        // Camera, see core::camera_settings
+
+        double lookfrom[3];
+        double lookat[3];
+        double vup[3];
+        double vfov;
+        double aperture;
+        double focus_distance;
+
+        // Image
+
+        uint32_t width;
+        uint32_t height;
+        /// @brief Samples per pixel of the finished image
+        uint32_t samples;
+        uint32_t max_depth;
+        uint64_t seed;
+        /// @brief Edge of the square tiles the image is sent back in
+        uint32_t tile_size;
+    };
+
+    enum class reply_kind : uint32_t
+    {
+        /// @brief The job was queued behind queue_position others
+        accepted,
+        /// @brief A tile of the image at samples samples per pixel, followed by its pixels
+        tile,
+        /// @brief Every tile was sent at the job's full sample count
+        finished,
+        /// @brief The job was refused or stopped, no more replies for it follow
+        failed,
+    };
+
+    /// @brief Header of every reply, tiles are followed by pixel_count core::rgb values
+    struct reply_message
+    {
+    public:
+        /// @brief Always reply_magic, used to detect a desynchronised stream
+        uint32_t magic = reply_magic;
+        reply_kind kind = reply_kind::failed;
+        /// @brief Job of the reply, numbered from 1 in the order the server received them
+        uint64_t job_id = 0;
+        /// @brief Jobs ahead of this one when it was accepted
+        uint32_t queue_position = 0;
+        /// @brief Region of a tile, from the image's top left corner
+        core::region region {};
+        /// @brief Samples per pixel the tile holds so far
+        uint32_t samples = 0;
+        uint32_t pixel_count = 0;
+    };
+
+    /// @brief Render request with the defaults of rtiow's command line
+    request_message make_render_request();
+
+    core::scene_settings scene_settings(const request_message& request);
+    core::image_settings image_settings(const request_message& request);
+
+    /// @brief Fills the address of the socket at path
+    /// @return False if path is too long for a socket address
+    bool socket_address(const std::string& path, sockaddr_un& address);
+
+    inline request_message make_render_request()
+    {
+        request_message request {};
+        request.magic = request_magic;
+        request.version = protocol_version;
+        request.kind = request_kind::render;
+
+        core::scene_settings scene {};
+        strncpy(request.scene, scene.name.c_str(), sizeof(request.scene) - 1);
+        strncpy(request.texture, scene.texture.c_str(), sizeof(request.texture) - 1);
+        request.sphere_count = scene.sphere_count;
+        request.clustered = scene.clustered;
+        request.flatten = scene.flatten;
+        request.diffuse_weight = scene.diffuse_weight;
+        request.metal_weight = scene.metal_weight;
+        request.glass_weight = scene.glass_weight;
+        request.scene_seed = scene.scene_seed;
+        request.shutter_open = scene.shutter_open;
+        request.shutter_close = scene.shutter_close;
+
+        core::image_settings image {};
+        std::copy(std::begin(image.camera.lookfrom), std::end(image.camera.lookfrom), request.lookfrom);
+        std::copy(std::begin(image.camera.lookat), std::end(image.camera.lookat), request.lookat);
+        std::copy(std::begin(image.camera.vup), std::end(image.camera.vup), request.vup);
+        request.vfov = image.camera.vfov;
+        request.aperture = image.camera.aperture;
+        request.focus_distance = image.camera.focus_distance;
+
+        request.width = image.width;
+        request.height = image.height;
+        request.samples = 1;
+        request.max_depth = image.max_depth;
+        request.seed = image.seed;
+        request.tile_size = 32;
+        return request;
+    }
+
+    inline core::scene_settings scene_settings(const request_message& request)
+    {
+        return core::scene_settings {
+            .name = std::string(request.scene, strnlen(request.scene, sizeof(request.scene))),
+            .texture = std::string(request.texture, strnlen(request.texture, sizeof(request.texture))),
+            .sphere_count = request.sphere_count,
+            .clustered = request.clustered != 0,
+            .diffuse_weight = request.diffuse_weight,
+            .metal_weight = request.metal_weight,
+            .glass_weight = request.glass_weight,
+            .scene_seed = request.scene_seed,
+            .shutter_open = request.shutter_open,
+            .shutter_close = request.shutter_close,
+            .flatten = request.flatten != 0,
+        };
+    }
+
+    inline core::image_settings image_settings(const request_message& request)
+    {
+        core::image_settings image {
+            .width = request.width,
+            .height = request.height,
+            .camera = core::camera_settings {
+                .vfov = request.vfov,
+                .aperture = request.aperture,
+                .focus_distance = request.focus_distance,
+            },
+            .max_depth = request.max_depth,
+            .seed = request.seed,
+        };
+
+        std::copy(std::begin(request.lookfrom), std::end(request.lookfrom), image.camera.lookfrom);
+        std::copy(std::begin(request.lookat), std::end(request.lookat), image.camera.lookat);
+        std::copy(std::begin(request.vup), std::end(request.vup), image.camera.vup);
+        return image;
+    }
+
+    inline bool socket_address(const std::string& path, sockaddr_un& address)
+    {
+        address = sockaddr_un {};
+        address.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(address.sun_path))
+        {
+            std::cerr << "Socket path " << path << " is empty or longer than " << sizeof(address.sun_path) - 1 << " bytes\n";
+            return false;
+        }
+
+        memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+}
+
+#endif // SERVER_PROTOCOL_HPP
@@ -0,0 +1,383 @@
+#ifndef SERVER_RENDER_SERVER_HPP
+#define SERVER_RENDER_SERVER_HPP
+
+#include "protocol.hpp"
+#include "../core/rtiow_core.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace jmrtiow::server
+{
+    /// @brief Settings of render_server
+    struct server_settings
+    {
+    public:
+        /// @brief Path of the Unix domain socket to listen on
+        std::string socket_path;
+        /// @brief Render threads, 0 for one per core
+        uint32_t thread_count;
+        /// @brief Number of built scenes and BVHs kept between jobs
+        uint32_t cached_scenes;
+        /// @brief Kernel instruction set of every job, see core::image_settings
+        std::string isa;
+    };
+
+    /// @brief Renders jobs clients queue over a Unix domain socket, one after another, in the order
+    /// they arrived. Each job is rendered in passes of doubling sample counts, and every pass sends the
+    /// whole image back to the job's client tile by tile, so the image refines while it renders.
+    /// Scenes stay built between jobs, a job for a cached scene starts rendering at once.
+    class render_server
+    {
+    public:
+        explicit render_server(const server_settings& settings);
+        ~render_server();
+
+        render_server(const render_server&) = delete;
+        render_server& operator=(const render_server&) = delete;
+
+        bool is_open() const { return listen_fd >= 0; }
+
+        /// @brief Serves jobs until a client asks the server to shut down
+        /// @return Process exit code
+        int run();
+
+    private:
+        struct connection
+        {
+        public:
+            int fd;
+            /// @brief Cleared once the client hung up, its jobs are then dropped
+            std::atomic<bool> open = true;
+            // Replies of the render loop and of the connection's reader must not interleave.
+            std::mutex write_mutex {};
+
+            bool send(const reply_message& reply, const core::rgb* pixels = nullptr);
+        };
+
+        struct job
+        {
+        public:
+            uint64_t id;
+            request_message request;
+            std::shared_ptr<connection> client;
+        };
+
+        void accept_loop();
+        void read_requests(std::shared_ptr<connection> client);
+        void render_job(const job& current);
+
+        server_settings settings;
+        int listen_fd = -1;
+        core::renderer renderer;
+
+        std::mutex queue_mutex {};
+        std::condition_variable queue_changed {};
+        std::deque<job> queue {};
+        /// @brief Client of the job being rendered, nullptr between jobs
+        std::shared_ptr<connection> active_client {};
+        uint64_t next_job_id = 1;
+        bool stopping = false;
+
+        std::thread acceptor {};
+        /// @brief Clients connected, each with a detached thread reading its requests
+        std::vector<std::shared_ptr<connection>> connections {};
+    };
+
+    inline bool render_server::connection::send(const reply_message& reply, const core::rgb* pixels)
+    {
+        std::lock_guard<std::mutex> lock(write_mutex);
+
+        if (open && distributed::write_all(fd, &reply, sizeof(reply)) && (pixels == nullptr || distributed::write_all(fd, pixels, reply.pixel_count * sizeof(core::rgb))))
+            return true;
+
+        open = false;
+        return false;
+    }
+
+    inline render_server::render_server(const server_settings& settings)
+        : settings(settings), renderer(settings.thread_count)
+    {
+        renderer.set_scene_cache_size(settings.cached_scenes);
+
+        sockaddr_un address;
+        if (!socket_address(settings.socket_path, address))
+            return;
+
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            std::cerr << "Could not create the server socket\n";
+            return;
+        }
+
+        // A socket file nobody accepts on is left over from a server that did not exit cleanly.
+        if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0)
+        {
+            std::cerr << "A server is already listening on " << settings.socket_path << "\n";
+            close(fd);
+            return;
+        }
+        close(fd);
+        unlink(settings.socket_path.c_str());
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 16) != 0)
+        {
+            std::cerr << "Could not listen on " << settings.socket_path << ": " << strerror(errno) << "\n";
+            if (fd >= 0)
+                close(fd);
+            return;
+        }
+
+        listen_fd = fd;
+    }
+
+    inline render_server::~render_server()
+    {
+        if (listen_fd >= 0)
+        {
+            close(listen_fd);
+            unlink(settings.socket_path.c_str());
+        }
+    }
+
+    inline int render_server::run()
+    {
+        if (!is_open())
+            return 1;
+
+        std::cerr << "Serving render jobs on " << settings.socket_path << " with " << renderer.thread_count() << " threads\n";
+        acceptor = std::thread([this]() { accept_loop(); });
+
+        while (true)
+        {
+            job current;
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                queue_changed.wait(lock, [this]() { return stopping || !queue.empty(); });
+                if (stopping)
+                    break;
+
+                current = std::move(queue.front());
+                queue.pop_front();
+                active_client = current.client;
+            }
+
+            // Limits on requests keep jobs within reason, a job that still runs out of memory fails alone.
+            try
+            {
+                if (current.client->open)
+                    render_job(current);
+            }
+            catch (const std::bad_alloc&)
+            {
+                std::cerr << "Job " << current.id << " ran out of memory\n";
+                current.client->send(reply_message { .magic = reply_magic, .kind = reply_kind::failed, .job_id = current.id });
+            }
+
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            active_client = nullptr;
+        }
+
+        // Jobs still queued are refused, and every blocked accept() and recv() is woken up to return.
+        shutdown(listen_fd, SHUT_RDWR);
+        acceptor.join();
+
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            for (const job& dropped : queue)
+                dropped.client->send(reply_message { .magic = reply_magic, .kind = reply_kind::failed, .job_id = dropped.id });
+            queue.clear();
+
+            for (auto& client : connections)
+                shutdown(client->fd, SHUT_RDWR);
+            queue_changed.wait(lock, [this]() { return connections.empty(); });
+        }
+
+        std::cerr << "Server stopped\n";
+        return 0;
+    }
+
+    inline void render_server::accept_loop()
+    {
+        while (true)
+        {
+            int fd = accept4(listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0 && errno == EINTR)
+                continue;
+
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            if (fd < 0 || stopping)
+            {
+                if (fd >= 0)
+                    close(fd);
+                else if (!stopping)
+                    std::cerr << "No longer accepting clients: " << strerror(errno) << "\n";
+                return;
+            }
+
+            auto client = std::make_shared<connection>();
+            client->fd = fd;
+            connections.push_back(client);
+            std::thread([this, client]() { read_requests(client); }).detach();
+        }
+    }
+
+    inline void render_server::read_requests(std::shared_ptr<connection> client)
+    {
+        request_message request;
+
+        while (distributed::read_all(client->fd, &request, sizeof(request)))
+        {
+            if (request.magic != request_magic)
+                break;
+
+            if (request.version != protocol_version)
+            {
+                std::cerr << "Refusing a request of protocol version " << request.version << "\n";
+                client->send(reply_message { .magic = reply_magic, .kind = reply_kind::failed });
+                break;
+            }
+
+            if (request.kind == request_kind::shutdown)
+            {
+                std::cerr << "Shutting down once the running job finished\n";
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                stopping = true;
+                queue_changed.notify_all();
+                break;
+            }
+
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            uint64_t id = next_job_id++;
+
+            if (request.kind != request_kind::render || request.width < 2 || request.height < 2 || request.width > max_image_edge || request.height > max_image_edge
+                || request.sphere_count > max_sphere_count || request.samples == 0 || request.tile_size == 0)
+            {
+                lock.unlock();
+                std::cerr << "Job " << id << " refused, it is not a render of 2x2 to " << max_image_edge << "x" << max_image_edge << " pixels, at least one sample and at most "
+                          << max_sphere_count << " spheres\n";
+                client->send(reply_message { .magic = reply_magic, .kind = reply_kind::failed, .job_id = id });
+                continue;
+            }
+
+            // Accepted goes out before the job is queued, so it always precedes the job's tiles.
+            uint32_t position = static_cast<uint32_t>(queue.size()) + (active_client != nullptr ? 1 : 0);
+            lock.unlock();
+
+            if (!client->send(reply_message { .magic = reply_magic, .kind = reply_kind::accepted, .job_id = id, .queue_position = position }))
+                break;
+
+            lock.lock();
+            queue.push_back(job { .id = id, .request = request, .client = client });
+            queue_changed.notify_all();
+        }
+
+        // A client that hung up takes its queued jobs with it, and stops its running one.
+        {
+            std::lock_guard<std::mutex> write_lock(client->write_mutex);
+            client->open = false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            if (active_client == client)
+                renderer.cancel();
+
+            connections.erase(std::find(connections.begin(), connections.end(), client));
+            queue_changed.notify_all();
+        }
+
+        // Nothing writes to a closed connection, and the server may be gone once it is off the list.
+        close(client->fd);
+    }
+
+    inline void render_server::render_job(const job& current)
+    {
+        const request_message& request = current.request;
+        auto start = std::chrono::steady_clock::now();
+
+        reply_message failed { .magic = reply_magic, .kind = reply_kind::failed, .job_id = current.id };
+
+        core::scene_settings scene = scene_settings(request);
+        if (!renderer.build_scene(scene))
+        {
+            current.client->send(failed);
+            return;
+        }
+
+        std::cerr << "Job " << current.id << ": " << scene.name << " " << request.width << "x" << request.height << " at " << request.samples
+                  << " samples, scene ready after " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s\n";
+
+        core::image_settings image = image_settings(request);
+        image.isa = settings.isa;
+
+        core::region whole { .x = 0, .y = 0, .width = request.width, .height = request.height };
+        std::vector<core::rgb> pixels(static_cast<size_t>(request.width) * request.height);
+        std::vector<core::rgb> tile_pixels {};
+
+        // Passes double in samples, the first one is back within one sample's render time.
+        for (uint32_t done = 0, pass = 1; done < request.samples; done += pass, pass = static_cast<uint32_t>(std::min<uint64_t>(2ull * pass, request.samples - done)))
+        {
+            if (!current.client->open || !renderer.render_region(image, whole, done, pass, pixels.data()))
+            {
+                std::cerr << "Job " << current.id << " stopped after " << done << " samples\n";
+                current.client->send(failed);
+                return;
+            }
+
+            for (uint32_t y = 0; y < request.height; y += request.tile_size)
+            {
+                for (uint32_t x = 0; x < request.width; x += request.tile_size)
+                {
+                    core::region area {
+                        .x = x,
+                        .y = y,
+                        .width = std::min(request.tile_size, request.width - x),
+                        .height = std::min(request.tile_size, request.height - y),
+                    };
+
+                    tile_pixels.clear();
+                    for (uint32_t row = area.y; row < area.y + area.height; row++)
+                    {
+                        const core::rgb* source = pixels.data() + static_cast<size_t>(row) * request.width + area.x;
+                        tile_pixels.insert(tile_pixels.end(), source, source + area.width);
+                    }
+
+                    reply_message tile {
+                        .magic = reply_magic,
+                        .kind = reply_kind::tile,
+                        .job_id = current.id,
+                        .region = area,
+                        .samples = done + pass,
+                        .pixel_count = static_cast<uint32_t>(tile_pixels.size()),
+                    };
+
+                    if (!current.client->send(tile, tile_pixels.data()))
+                        return;
+                }
+            }
+        }
+
+        current.client->send(reply_message { .magic = reply_magic, .kind = reply_kind::finished, .job_id = current.id });
+        std::cerr << "Job " << current.id << " finished after " << std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s\n";
+    }
+}
+
+#endif // SERVER_RENDER_SERVER_HPP
@@ -0,0 +1,348 @@
+// Local includes
+#include "rtweekend.hpp"
+
+#include "image/image_checksum.hpp"
+#include "image/image_type.hpp"
+#include "image/stream_writer.hpp"
+#include "server/protocol.hpp"
+
+// STL includes
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <map>
+#include <vector>
+
+// External includes
+#include <argparse/argparse.hpp>
+
+// Sends render jobs to an rtiow --serve process and follows their tiles, to try out and test a
+// render server from the command line.
+
+void setup_args(int argc, char** argv, argparse::ArgumentParser& argparser);
+jmrtiow::server::request_message render_request(const argparse::ArgumentParser& argparser);
+bool write_image(const argparse::ArgumentParser& argparser, const std::vector<jmrtiow::math::color3>& image, uint32_t width, uint32_t height);
+
+int main(int argc, char** argv)
+{
+    using namespace jmrtiow;
+
+    argparse::ArgumentParser argparser("rtiow_client", "0.1");
+    setup_args(argc, argv, argparser);
+
+    sockaddr_un address;
+    if (!server::socket_address(argparser.get<std::string>("--socket"), address))
+        return 1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+    {
+        std::cerr << "Could not connect to " << argparser.get<std::string>("--socket") << "\n";
+        return 1;
+    }
+
+    if (argparser.get<bool>("--shutdown"))
+    {
+        server::request_message request {};
+        request.magic = server::request_magic;
+        request.version = server::protocol_version;
+        request.kind = server::request_kind::shutdown;
+
+        bool sent = distributed::write_all(fd, &request, sizeof(request));
+        close(fd);
+        return sent ? 0 : 1;
+    }
+
+    server::request_message request = render_request(argparser);
+    if (request.width > server::max_image_edge || request.height > server::max_image_edge || request.sphere_count > server::max_sphere_count)
+    {
+        std::cerr << "The server renders images of at most " << server::max_image_edge << "x" << server::max_image_edge << " pixels and "
+                  << server::max_sphere_count << " spheres\n";
+        close(fd);
+        return 1;
+    }
+
+    uint32_t jobs = std::max(argparser.get<uint32_t>("--repeat"), 1u);
+    for (uint32_t i = 0; i < jobs; i++)
+    {
+        if (!distributed::write_all(fd, &request, sizeof(request)))
+        {
+            std::cerr << "Lost the server while sending jobs\n";
+            return 1;
+        }
+    }
+
+    // Every job renders the same image, tiles are kept in one and each pass reported once it is complete.
+    std::vector<math::color3> image(static_cast<size_t>(request.width) * request.height);
+    std::vector<core::rgb> pixels {};
+    std::map<uint64_t, std::chrono::steady_clock::time_point> started {};
+    uint32_t finished = 0, failed = 0;
+    bool quiet = argparser.get<bool>("--quiet");
+
+    server::reply_message reply;
+    while (finished + failed < jobs && distributed::read_all(fd, &reply, sizeof(reply)))
+    {
+        if (reply.magic != server::reply_magic)
+        {
+            std::cerr << "The server's replies are out of step\n";
+            return 1;
+        }
+
+        switch (reply.kind)
+        {
+        case server::reply_kind::accepted:
+            started[reply.job_id] = std::chrono::steady_clock::now();
+            std::cerr << "Job " << reply.job_id << " queued behind " << reply.queue_position << " others\n";
+            break;
+
+        case server::reply_kind::tile:
+        {
+            const core::region& area = reply.region;
+            pixels.resize(reply.pixel_count);
+            if (reply.pixel_count != static_cast<size_t>(area.width) * area.height || area.x + area.width > request.width || area.y + area.height > request.height
+                || !distributed::read_all(fd, pixels.data(), pixels.size() * sizeof(core::rgb)))
+            {
+                std::cerr << "Received a broken tile\n";
+                return 1;
+            }
+
+            for (uint32_t row = 0; row < area.height; row++)
+            {
+                for (uint32_t i = 0; i < area.width; i++)
+                {
+                    const core::rgb& p = pixels[static_cast<size_t>(row) * area.width + i];
+                    image[static_cast<size_t>(area.y + row) * request.width + area.x + i] = math::color3(p.r, p.g, p.b);
+                }
+            }
+
+            // The server sends a pass from the top left tile to the bottom right one.
+            if (!quiet && area.x + area.width == request.width && area.y + area.height == request.height)
+            {
+                std::cerr << std::format("Job {}: {} of {} samples after {:.3f} s\n", reply.job_id, reply.samples, request.samples,
+                    std::chrono::duration<double>(std::chrono::steady_clock::now() - started[reply.job_id]).count());
+            }
+            break;
+        }
+
+        case server::reply_kind::finished:
+            finished++;
+            std::cerr << std::format("Job {} finished after {:.3f} s\n", reply.job_id, std::chrono::duration<double>(std::chrono::steady_clock::now() - started[reply.job_id]).count());
+            break;
+
+        case server::reply_kind::failed:
+            failed++;
+            std::cerr << "Job " << reply.job_id << " failed, see the server's output\n";
+            break;
+        }
+    }
+
+    close(fd);
+
+    if (finished + failed < jobs)
+    {
+        std::cerr << "The server hung up before every job finished\n";
+        return 1;
+    }
+
+    if (finished == 0)
+        return 1;
+
+    if (argparser.get<bool>("--checksum"))
+    {
+        image::image_checksum checksum {};
+        checksum.add(image.data(), image.size());
+        std::cout << std::format("Checksum {:016x}\n", checksum.value());
+    }
+
+    if (!argparser.get<std::string>("--filepath").empty() && !write_image(argparser, image, request.width, request.height))
+        return 1;
+
+    return failed > 0 ? 1 : 0;
+}
+
+jmrtiow::server::request_message render_request(const argparse::ArgumentParser& argparser)
+{
+    jmrtiow::server::request_message request = jmrtiow::server::make_render_request();
+
+    std::string scene = argparser.get<std::string>("--scene");
+    std::string texture = argparser.get<std::string>("--texture");
+    strncpy(request.scene, scene.c_str(), sizeof(request.scene) - 1);
+    strncpy(request.texture, texture.c_str(), sizeof(request.texture) - 1);
+    request.sphere_count = argparser.get<uint64_t>("--sphere-count");
+    request.clustered = argparser.get<std::string>("--distribution") == "clustered";
+    request.scene_seed = argparser.get<uint64_t>("--scene-seed");
+    request.flatten = argparser.get<std::string>("--kernel") != "generic";
+
+    auto lookfrom = argparser.get<std::vector<double>>("--lookfrom");
+    auto lookat = argparser.get<std::vector<double>>("--lookat");
+    std::copy(lookfrom.begin(), lookfrom.end(), request.lookfrom);
+    std::copy(lookat.begin(), lookat.end(), request.lookat);
+    request.vfov = argparser.get<double>("--vfov");
+    request.aperture = argparser.get<double>("--aperture");
+
+    request.width = std::max(argparser.get<uint32_t>("--width"), 2u);
+    request.height = argparser.get<uint32_t>("--height") > 1 ? argparser.get<uint32_t>("--height") : static_cast<uint32_t>(request.width / (3.0 / 2.0));
+    request.samples = argparser.get<uint32_t>("--samples");
+    request.seed = argparser.get<uint64_t>("--seed");
+    request.tile_size = argparser.get<uint32_t>("--tile-size");
+    return request;
+}
+
+bool write_image(const argparse::ArgumentParser& argparser, const std::vector<jmrtiow::math::color3>& image, uint32_t width, uint32_t height)
+{
+    std::string filepath = argparser.get<std::string>("--filepath");
+    std::ofstream file_stream(filepath, std::ios::binary);
+    auto writer = jmrtiow::image::make_stream_writer(jmrtiow::image::image_type_from_string(argparser.get("--image-type")), file_stream, width, height);
+    if (!file_stream || !writer)
+    {
+        std::cerr << "Could not write " << filepath << "\n";
+        return false;
+    }
+
+    for (uint32_t row = 0; row < height; row++)
+    {
+        if (!writer->write_row(image.data() + static_cast<size_t>(row) * width, nullptr))
+            return false;
+    }
+
+    return writer->close();
+}
+
+void setup_args(int argc, char** argv, argparse::ArgumentParser& argparser)
+{
+    argparser.add_argument("--socket")
+        .default_value(std::string { "rtiow.sock" })
+        .help("Unix domain socket of the rtiow --serve process")
+        .metavar("SOCKET");
+
+    argparser.add_argument("--shutdown")
+        .flag()
+        .help("Ask the server to stop once its running job finished, instead of sending a job");
+
+    argparser.add_argument("--scene", "-s")
+        .default_value(std::string { "random" })
+        .choices("random", "demo", "demo2", "bouncing", "checkered", "perlin", "earth", "lights", "procedural")
+        .help("The scene to render")
+        .metavar("SCENE");
+
+    argparser.add_argument("--kernel")
+        .default_value(std::string { "auto" })
+        .choices("auto", "generic")
+        .help("Render kernel: auto uses the inlined sphere kernel for scenes it supports, generic always traces through virtual calls")
+        .metavar("KERNEL");
+
+    argparser.add_argument("--sphere-count")
+        .default_value(uint64_t { 10000 })
+        .scan<'u', uint64_t>()
+        .help("Number of spheres of the procedural scene")
+        .metavar("N");
+
+    argparser.add_argument("--distribution")
+        .default_value(std::string { "uniform" })
+        .choices("uniform", "clustered")
+        .help("Spread the procedural scene's spheres evenly or in clusters")
+        .metavar("DISTRIBUTION");
+
+    argparser.add_argument("--scene-seed")
+        .default_value(uint64_t { 0 })
+        .scan<'u', uint64_t>()
+        .help("Seed of the procedural scene")
+        .metavar("SEED");
+
+    argparser.add_argument("--texture")
+        .default_value(std::string { "earthmap.jpg" })
+        .help("Image wrapped around the sphere of the earth scene, as the server sees it")
+        .metavar("PATH");
+
+    argparser.add_argument("--lookfrom")
+        .default_value(std::vector<double> { 13, 2, 3 })
+        .nargs(3)
+        .scan<'g', double>()
+        .help("Camera position")
+        .metavar("X Y Z");
+
+    argparser.add_argument("--lookat")
+        .default_value(std::vector<double> { 0, 0, 0 })
+        .nargs(3)
+        .scan<'g', double>()
+        .help("Point the camera looks at")
+        .metavar("X Y Z");
+
+    argparser.add_argument("--vfov")
+        .default_value(20.0)
+        .scan<'g', double>()
+        .help("Vertical field of view in degrees")
+        .metavar("DEGREES");
+
+    argparser.add_argument("--aperture")
+        .default_value(0.1)
+        .scan<'g', double>()
+        .help("Lens aperture, 0 for a pinhole camera")
+        .metavar("APERTURE");
+
+    argparser.add_argument("--width", "-w")
+        .default_value(uint32_t { 1200 })
+        .scan<'u', uint32_t>()
+        .help("Width of the image")
+        .metavar("WIDTH");
+
+    argparser.add_argument("--height")
+        .default_value(uint32_t { 0 })
+        .scan<'u', uint32_t>()
+        .help("Height of the image, 0 for two thirds of the width")
+        .metavar("HEIGHT");
+
+    argparser.add_argument("--samples")
+        .default_value(uint32_t { 64 })
+        .scan<'u', uint32_t>()
+        .help("Samples per pixel of the finished image")
+        .metavar("N");
+
+    argparser.add_argument("--seed")
+        .default_value(uint64_t { 0 })
+        .scan<'u', uint64_t>()
+        .help("Base seed of the render, equal seeds render equal images")
+        .metavar("SEED");
+
+    argparser.add_argument("--tile-size")
+        .default_value(uint32_t { 32 })
+        .scan<'u', uint32_t>()
+        .help("Edge length in pixels of the tiles the server sends")
+        .metavar("PIXELS");
+
+    argparser.add_argument("--repeat")
+        .default_value(uint32_t { 1 })
+        .scan<'u', uint32_t>()
+        .help("Send the job this many times, to see it queue and reuse the cached scene")
+        .metavar("N");
+
+    argparser.add_argument("--filepath", "-f")
+        .default_value(std::string { "" })
+        .help("Write the finished image to this file")
+        .metavar("PATH");
+
+    argparser.add_argument("--image-type", "-t")
+        .default_value(std::string { "png" })
+        .choices("png", "ppm", "exr")
+        .help("Type of the image file")
+        .metavar("TYPE");
+
+    argparser.add_argument("--checksum")
+        .flag()
+        .help("Print a checksum of the finished image, equal to rtiow --checksum for the same render");
+
+    argparser.add_argument("--quiet", "-q")
+        .flag()
+        .help("Only report queued and finished jobs, not every pass");
+
+    try
+    {
+        argparser.parse_args(argc, argv);
+    }
+    catch (const std::exception& err)
+    {
+        std::cerr << err.what() << std::endl;
+        std::cerr << argparser;
+        std::exit(1);
+    }
+}
@@ -0,0 +1,218 @@
+#ifndef STATS_RENDER_STATS_HPP
+#define STATS_RENDER_STATS_HPP
+
+#include <algorithm>
+#include <iterator>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace jmrtiow::stats
+{
+    /// @brief Number of path lengths kept apart in the bounce histogram, longer paths share the last bucket
+    constexpr uint32_t bounce_buckets = 32;
+
+    /// @brief Work done by one thread, or summed over threads
+    struct counters
+    {
+        /// @brief Camera and scattered rays intersected with the scene
+        uint64_t rays;
+        /// @brief Rays toward a light sample
+        uint64_t shadow_rays;
+        /// @brief BVH nodes whose box was tested
+        uint64_t bvh_nodes;
+        /// @brief Ray-primitive intersection tests
+        uint64_t primitive_tests;
+        /// @brief Pixel samples completed
+        uint64_t samples;
+        /// @brief Tile samples completed, and the time they took
+        uint64_t tiles;
+        uint64_t tile_nanoseconds;
+        uint64_t max_tile_nanoseconds;
+        /// @brief Paths by number of bounces, a camera ray that hits nothing has 0
+        uint64_t bounces[bounce_buckets];
+    };
+
+    /// @brief Counters of the calling thread. Only that thread writes them, with plain
+    /// increments, and they are only seen by others once published.
+    counters& local();
+
+    /// @brief Counters published by every render thread. Each thread gets its own cache line
+    /// padded slot, so publishing is a relaxed store into memory no other thread writes and
+    /// reading the totals never slows the render threads down.
+    class registry
+    {
+    public:
+        static registry& global();
+
+        /// @brief Makes the calling thread's counters visible to totals()
+        void publish();
+
+        /// @brief Sum of the published counters of every thread, including exited ones
+        counters totals() const;
+
+    private:
+        static constexpr size_t counter_count = sizeof(counters) / sizeof(uint64_t);
+        // Every counter is summed over threads except this one, which is a maximum.
+        static constexpr size_t max_tile_index = offsetof(counters, max_tile_nanoseconds) / sizeof(uint64_t);
+
+        static void combine(uint64_t* total, const uint64_t* values);
+
+        struct alignas(64) slot
+        {
+            std::atomic<uint64_t> values[counter_count];
+            bool in_use;
+        };
+
+        // Releases a thread's slot when the thread exits, keeping what it counted.
+        struct slot_handle
+        {
+            slot* assigned = nullptr;
+            ~slot_handle();
+        };
+
+        slot& thread_slot();
+        void retire(slot& s);
+
+        mutable std::mutex mutex;
+        std::deque<slot> slots;
+        uint64_t retired[counter_count] {};
+    };
+
+    /// @brief Writes totals as a JSON object, with rates over the given wall clock time
+    void write_json(std::ostream& out, const counters& totals, double seconds);
+
+    inline counters& local()
+    {
+        thread_local counters thread_counters {};
+        return thread_counters;
+    }
+
+    inline registry& registry::global()
+    {
+        static registry instance;
+        return instance;
+    }
+
+    inline registry::slot_handle::~slot_handle()
+    {
+        if (assigned != nullptr)
+            registry::global().retire(*assigned);
+    }
+
+    inline registry::slot& registry::thread_slot()
+    {
+        thread_local slot_handle handle;
+        if (handle.assigned != nullptr)
+            return *handle.assigned;
+
+        std::lock_guard lock(mutex);
+
+        auto free_slot = std::find_if(slots.begin(), slots.end(), [](const slot& s) { return !s.in_use; });
+        if (free_slot == slots.end())
+        {
+            slots.emplace_back();
+            free_slot = std::prev(slots.end());
+        }
+
+        for (auto& value : free_slot->values)
+            value.store(0, std::memory_order_relaxed);
+        free_slot->in_use = true;
+
+        handle.assigned = &*free_slot;
+        return *handle.assigned;
+    }
+
+    inline void registry::combine(uint64_t* total, const uint64_t* values)
+    {
+        for (size_t i = 0; i < counter_count; i++)
+        {
+            total[i] = i == max_tile_index ? std::max(total[i], values[i]) : total[i] + values[i];
+        }
+    }
+
+    inline void registry::publish()
+    {
+        uint64_t values[counter_count];
+        std::memcpy(values, &local(), sizeof(values));
+
+        // Single writer per slot, so no read-modify-write is needed.
+        slot& s = thread_slot();
+        for (size_t i = 0; i < counter_count; i++)
+        {
+            s.values[i].store(values[i], std::memory_order_relaxed);
+        }
+    }
+
+    inline void registry::retire(slot& s)
+    {
+        std::lock_guard lock(mutex);
+
+        // The thread's counters die with it, its last published values are folded into the retired totals.
+        uint64_t values[counter_count];
+        for (size_t i = 0; i < counter_count; i++)
+        {
+            values[i] = s.values[i].load(std::memory_order_relaxed);
+            s.values[i].store(0, std::memory_order_relaxed);
+        }
+
+        combine(retired, values);
+        s.in_use = false;
+    }
+
+    inline counters registry::totals() const
+    {
+        uint64_t values[counter_count];
+
+        std::lock_guard lock(mutex);
+        std::memcpy(values, retired, sizeof(values));
+
+        for (const auto& s : slots)
+        {
+            uint64_t slot_values[counter_count];
+            for (size_t i = 0; i < counter_count; i++)
+            {
+                slot_values[i] = s.values[i].load(std::memory_order_relaxed);
+            }
+
+            combine(values, slot_values);
+        }
+
+        counters result;
+        std::memcpy(&result, values, sizeof(result));
+        return result;
+    }
+
+    inline void write_json(std::ostream& out, const counters& totals, double seconds)
+    {
+        double average_tile_ms = totals.tiles > 0 ? totals.tile_nanoseconds / 1e6 / totals.tiles : 0.0;
+
+        out << "{\n"
+            << "  \"seconds\": " << seconds << ",\n"
+            << "  \"rays\": " << totals.rays << ",\n"
+            << "  \"shadow_rays\": " << totals.shadow_rays << ",\n"
+            << "  \"bvh_nodes\": " << totals.bvh_nodes << ",\n"
+            << "  \"primitive_tests\": " << totals.primitive_tests << ",\n"
+            << "  \"samples\": " << totals.samples << ",\n"
+            << "  \"samples_per_second\": " << (seconds > 0 ? totals.samples / seconds : 0.0) << ",\n"
+            << "  \"rays_per_second\": " << (seconds > 0 ? (totals.rays + totals.shadow_rays) / seconds : 0.0) << ",\n"
+            << "  \"tiles\": " << totals.tiles << ",\n"
+            << "  \"average_tile_ms\": " << average_tile_ms << ",\n"
+            << "  \"max_tile_ms\": " << totals.max_tile_nanoseconds / 1e6 << ",\n"
+            << "  \"bounces\": [";
+
+        for (uint32_t i = 0; i < bounce_buckets; i++)
+        {
+            out << (i > 0 ? ", " : "") << totals.bounces[i];
+        }
+
+        out << "]\n}\n";
+    }
+}
+
+#endif // STATS_RENDER_STATS_HPP
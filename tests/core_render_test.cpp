@@ -0,0 +1,178 @@
+// Local includes
+#include "rtweekend.hpp"
+
+#include "core/rtiow_core.hpp"
+#include "image/image_checksum.hpp"
+
+// STL includes
+#include <algorithm>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Renders a small scene through rtiow_core in every way the API allows splitting the work, on one
+// thread and on several, with both render kernels, and checks each image against a stored checksum.
+// Pixels depend only on the scene, the seed and their sample indices, so all of them must come out bit
+// for bit the same.
+
+namespace
+{
+    using namespace jmrtiow;
+
+    // rtiow --headless --scene demo --width 96 --height 64 --samples 4 --seed 7 --checksum. Targets with
+    // fused multiply-adds round differently, their renders are only checked against each other.
+    constexpr uint64_t golden_checksum = 0x546a8239b34a54da;
+#if defined(JMRTIOW_SIMD_FMA)
+    constexpr bool check_golden = false;
+#else
+    constexpr bool check_golden = true;
+#endif
+
+    constexpr uint32_t width = 96;
+    constexpr uint32_t height = 64;
+    constexpr uint32_t samples = 4;
+
+    /// @brief Renders the image into pixels through render, which covers it in some order
+    using render_order = std::function<bool(core::renderer& renderer, const core::image_settings& image, std::vector<core::rgb>& pixels)>;
+
+    bool render_area(core::renderer& renderer, const core::image_settings& image, const core::region& area, uint32_t first_sample, uint32_t count,
+        std::vector<core::rgb>& pixels)
+    {
+        std::vector<core::rgb> area_pixels(static_cast<size_t>(area.width) * area.height);
+        for (uint32_t row = 0; row < area.height; row++)
+        {
+            for (uint32_t i = 0; i < area.width; i++)
+                area_pixels[static_cast<size_t>(row) * area.width + i] = pixels[static_cast<size_t>(area.y + row) * width + area.x + i];
+        }
+
+        if (!renderer.render_region(image, area, first_sample, count, area_pixels.data()))
+            return false;
+
+        for (uint32_t row = 0; row < area.height; row++)
+        {
+            for (uint32_t i = 0; i < area.width; i++)
+                pixels[static_cast<size_t>(area.y + row) * width + area.x + i] = area_pixels[static_cast<size_t>(row) * area.width + i];
+        }
+
+        return true;
+    }
+
+    /// @brief Same as rtiow --checksum, rows top first
+    uint64_t checksum(const std::vector<core::rgb>& pixels)
+    {
+        image::image_checksum sum {};
+        for (const core::rgb& p : pixels)
+        {
+            math::color3 color(p.r, p.g, p.b);
+            sum.add(&color, 1);
+        }
+
+        return sum.value();
+    }
+}
+
+int main()
+{
+    core::scene_settings scene {};
+    scene.name = "demo";
+
+    core::image_settings image {};
+    image.width = width;
+    image.height = height;
+    image.seed = 7;
+
+    std::vector<std::pair<std::string, render_order>> orders {
+        { "whole image", [](core::renderer& renderer, const core::image_settings& image, std::vector<core::rgb>& pixels)
+            { return render_area(renderer, image, core::region { .x = 0, .y = 0, .width = width, .height = height }, 0, samples, pixels); } },
+
+        { "one sample per call", [](core::renderer& renderer, const core::image_settings& image, std::vector<core::rgb>& pixels)
+            {
+                for (uint32_t sample = 0; sample < samples; sample++)
+                {
+                    if (!render_area(renderer, image, core::region { .x = 0, .y = 0, .width = width, .height = height }, sample, 1, pixels))
+                        return false;
+                }
+                return true;
+            } },
+
+        // Uneven bands bottom first, so neither tile edges nor row order line up with the whole image.
+        { "bands bottom up", [](core::renderer& renderer, const core::image_settings& image, std::vector<core::rgb>& pixels)
+            {
+                for (uint32_t bottom = height; bottom > 0;)
+                {
+                    uint32_t band = std::min(bottom, 23u);
+                    if (!render_area(renderer, image, core::region { .x = 0, .y = bottom - band, .width = width, .height = band }, 0, samples, pixels))
+                        return false;
+                    bottom -= band;
+                }
+                return true;
+            } },
+
+        { "columns right to left in two passes", [](core::renderer& renderer, const core::image_settings& image, std::vector<core::rgb>& pixels)
+            {
+                for (uint32_t first_sample : { 0u, samples / 2 })
+                {
+                    for (uint32_t right = width; right > 0;)
+                    {
+                        uint32_t column = std::min(right, 37u);
+                        core::region area { .x = right - column, .y = 0, .width = column, .height = height };
+                        if (!render_area(renderer, image, area, first_sample, first_sample == 0 ? samples / 2 : samples - samples / 2, pixels))
+                            return false;
+                        right -= column;
+                    }
+                }
+                return true;
+            } },
+    };
+
+    int failures = 0;
+    uint64_t expected = golden_checksum;
+    bool have_expected = check_golden;
+    for (uint32_t threads : { 1u, 4u })
+    {
+        core::renderer renderer(threads);
+
+        // The inlined sphere kernel and the generic one render the same image.
+        for (bool flatten : { true, false })
+        {
+            scene.flatten = flatten;
+            if (!renderer.build_scene(scene))
+                return 1;
+
+            const char* kernel = flatten ? "sphere" : "generic";
+
+            for (const auto& [name, render] : orders)
+            {
+                std::vector<core::rgb> pixels(static_cast<size_t>(width) * height);
+                if (!render(renderer, image, pixels))
+                {
+                    std::cerr << std::format("{} threads, {} kernel, {}: render failed\n", threads, kernel, name);
+                    failures++;
+                    continue;
+                }
+
+                uint64_t value = checksum(pixels);
+                if (!have_expected)
+                {
+                    expected = value;
+                    have_expected = true;
+                }
+
+                if (value != expected)
+                {
+                    std::cerr << std::format("{} threads, {} kernel, {}: checksum {:016x}, expected {:016x}\n", threads, kernel, name, value, expected);
+                    failures++;
+                }
+            }
+        }
+    }
+
+    if (failures > 0)
+        return 1;
+
+    std::cerr << "Every render matched checksum " << std::format("{:016x}", expected) << (check_golden ? "\n" : ", fused multiply-adds leave out the stored one\n");
+    return 0;
+}
@@ -0,0 +1,100 @@
+// Local includes
+#include "rtweekend.hpp"
+
+#include "core/rtiow_core.hpp"
+#include "graphics/isa.hpp"
+#include "image/image_checksum.hpp"
+
+// STL includes
+#include <format>
+#include <iostream>
+#include <vector>
+
+// Renders a small scene through rtiow_core with the kernels of every instruction set this CPU runs,
+// sphere and generic, and checks that each image has the checksum of the baseline sphere kernel. The
+// vector math of each version is compiled for its target but must round exactly like the baseline.
+
+namespace
+{
+    using namespace jmrtiow;
+
+    constexpr uint32_t width = 96;
+    constexpr uint32_t height = 64;
+    constexpr uint32_t samples = 4;
+
+    /// @brief Same as rtiow --checksum, rows top first
+    uint64_t checksum(const std::vector<core::rgb>& pixels)
+    {
+        image::image_checksum sum {};
+        for (const core::rgb& p : pixels)
+        {
+            math::color3 color(p.r, p.g, p.b);
+            sum.add(&color, 1);
+        }
+
+        return sum.value();
+    }
+}
+
+int main()
+{
+    core::scene_settings scene {};
+    scene.name = "demo";
+
+    core::image_settings image {};
+    image.width = width;
+    image.height = height;
+    image.seed = 7;
+
+    core::renderer renderer(2);
+
+    int failures = 0;
+    uint64_t expected = 0;
+    bool have_expected = false;
+    for (bool flatten : { true, false })
+    {
+        scene.flatten = flatten;
+        if (!renderer.build_scene(scene))
+            return 1;
+
+        const char* kernel = flatten ? "sphere" : "generic";
+
+        for (graphics::isa_level level : { graphics::isa_level::baseline, graphics::isa_level::sse42, graphics::isa_level::avx2, graphics::isa_level::avx512 })
+        {
+            if (!graphics::isa_supported(level))
+            {
+                std::cerr << std::format("{} {} kernel: not supported here, skipped\n", graphics::isa_name(level), kernel);
+                continue;
+            }
+
+            image.isa = graphics::isa_name(level);
+
+            std::vector<core::rgb> pixels(static_cast<size_t>(width) * height);
+            if (!renderer.render_region(image, core::region { .x = 0, .y = 0, .width = width, .height = height }, 0, samples, pixels.data()))
+            {
+                std::cerr << std::format("{} {} kernel: render failed\n", image.isa, kernel);
+                failures++;
+                continue;
+            }
+
+            uint64_t value = checksum(pixels);
+            if (!have_expected)
+            {
+                expected = value;
+                have_expected = true;
+            }
+
+            if (value != expected)
+            {
+                std::cerr << std::format("{} {} kernel: checksum {:016x}, baseline {:016x}\n", image.isa, kernel, value, expected);
+                failures++;
+            }
+            else
+            {
+                std::cerr << std::format("{} {} kernel: checksum {:016x}\n", image.isa, kernel, value);
+            }
+        }
+    }
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,214 @@
+// Local includes
+#include "rtweekend.hpp"
+
+// STL includes
+#include <bit>
+#include <cmath>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Runs the vec3 operations on fixed inputs and writes the exact bits of every result, padding lane
+// included. CMake builds this twice, with the simd backend of the target and with JMRTIOW_SCALAR_MATH,
+// and the test compares the results of the first build to those of the second.
+//
+// Usage: --write PATH writes the results, --compare PATH checks them against PATH.
+
+namespace
+{
+    using namespace jmrtiow;
+
+    struct result
+    {
+    public:
+        std::string name;
+        double values[4];
+    };
+
+    /// @brief Operations a target with fused multiply-adds rounds once instead of twice
+    bool fused(const std::string& name)
+    {
+#if defined(JMRTIOW_SIMD_FMA)
+        return name.starts_with("mul_add") || name.starts_with("dot") || name.starts_with("length") || name.starts_with("unit_vector");
+#else
+        return false;
+#endif
+    }
+
+    /// @brief Mixed signs and magnitudes from a fixed sequence, so both builds see the same inputs
+    std::vector<math::vec3> inputs()
+    {
+        std::vector<math::vec3> vectors {
+            math::vec3(1, 0, 0),
+            math::vec3(0, -1, 0),
+            math::vec3(3, 4, 12),
+            math::vec3(-1e-150, 2e-150, 3e-150),
+            math::vec3(1e150, -1e150, 0.5e150),
+            math::vec3(0.1, 0.2, 0.3),
+        };
+
+        uint64_t state = 0x243f6a8885a308d3ull;
+        auto next = [&state]()
+        {
+            state = state * 6364136223846793005ull + 1442695040888963407ull;
+            return static_cast<double>(state >> 11) / static_cast<double>(1ull << 53) * 20.0 - 10.0;
+        };
+
+        for (int i = 0; i < 64; i++)
+        {
+            double x = next(), y = next(), z = next();
+            vectors.emplace_back(x, y, z);
+        }
+
+        return vectors;
+    }
+
+    std::vector<result> run_ops()
+    {
+        std::vector<result> results {};
+        auto add_vec = [&results](std::string name, const math::vec3& v) { results.push_back(result { std::move(name), { v.data[0], v.data[1], v.data[2], v.data[3] } }); };
+        auto add_scalar = [&results](std::string name, double d) { results.push_back(result { std::move(name), { d, 0, 0, 0 } }); };
+
+        std::vector<math::vec3> vectors = inputs();
+        for (size_t i = 0; i < vectors.size(); i++)
+        {
+            const math::vec3& u = vectors[i];
+            const math::vec3& v = vectors[(i * 7 + 3) % vectors.size()];
+            double t = v.y != 0 ? v.y : 0.75;
+            std::string n = std::to_string(i);
+
+            math::vec3 w = u;
+            w += v;
+            add_vec("add_assign " + n, w);
+            w = u;
+            w *= t;
+            add_vec("scale_assign " + n, w);
+            w = u;
+            w /= t;
+            add_vec("divide_assign " + n, w);
+
+            add_vec("negate " + n, -u);
+            add_vec("add " + n, u + v);
+            add_vec("sub " + n, u - v);
+            add_vec("mul " + n, u * v);
+            add_vec("scale " + n, t * u);
+            add_vec("divide " + n, u / t);
+            add_vec("mul_add " + n, math::mul_add(u, t, v));
+            add_scalar("dot " + n, math::dot(u, v));
+            add_vec("cross " + n, math::cross(u, v));
+            add_scalar("length_squared " + n, u.length_squared());
+            add_scalar("length " + n, u.length());
+            add_vec("unit_vector " + n, math::unit_vector(u));
+        }
+
+        return results;
+    }
+
+    std::string format_result(const result& r)
+    {
+        return std::format("{} {:016x} {:016x} {:016x} {:016x}", r.name, std::bit_cast<uint64_t>(r.values[0]), std::bit_cast<uint64_t>(r.values[1]),
+            std::bit_cast<uint64_t>(r.values[2]), std::bit_cast<uint64_t>(r.values[3]));
+    }
+
+    /// @brief Reads a line of format_result(), names hold one space
+    bool parse_result(const std::string& line, result& r)
+    {
+        std::istringstream stream(line);
+        std::string op, index;
+        uint64_t bits[4];
+        if (!(stream >> op >> index >> std::hex >> bits[0] >> bits[1] >> bits[2] >> bits[3]))
+            return false;
+
+        r.name = op + " " + index;
+        for (int i = 0; i < 4; i++)
+            r.values[i] = std::bit_cast<double>(bits[i]);
+        return true;
+    }
+
+    bool matches(const result& r, const result& reference)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            double a = r.values[i], b = reference.values[i];
+            if (std::bit_cast<uint64_t>(a) == std::bit_cast<uint64_t>(b))
+                continue;
+
+            // One rounding instead of two moves a result by a few units in the last place of its terms.
+            if (!fused(r.name) || !(std::abs(a - b) <= 1e-13 * std::max(1.0, std::abs(b))))
+                return false;
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string mode = argc == 3 ? argv[1] : "";
+    if (mode != "--write" && mode != "--compare")
+    {
+        std::cerr << "Usage: " << argv[0] << " --write PATH | --compare PATH\n";
+        return 1;
+    }
+
+#if defined(JMRTIOW_SIMD_FMA)
+    std::cerr << "Math backend " << math::simd::backend << " with fused multiply-adds\n";
+#else
+    std::cerr << "Math backend " << math::simd::backend << "\n";
+#endif
+
+    std::vector<result> results = run_ops();
+
+    if (mode == "--write")
+    {
+        std::ofstream file(argv[2]);
+        for (const result& r : results)
+            file << format_result(r) << "\n";
+
+        if (!file)
+        {
+            std::cerr << "Could not write " << argv[2] << "\n";
+            return 1;
+        }
+        return 0;
+    }
+
+    std::ifstream file(argv[2]);
+    std::string line;
+    size_t index = 0, failures = 0;
+    while (std::getline(file, line))
+    {
+        result reference;
+        if (!parse_result(line, reference) || index >= results.size() || results[index].name != reference.name)
+        {
+            std::cerr << argv[2] << " holds other results, line " << index + 1 << ": " << line << "\n";
+            return 1;
+        }
+
+        if (!matches(results[index], reference))
+        {
+            std::cerr << "got      " << format_result(results[index]) << "\nexpected " << line << "\n";
+            failures++;
+        }
+
+        index++;
+    }
+
+    if (index != results.size())
+    {
+        std::cerr << "Could not read the " << results.size() << " results of " << argv[2] << "\n";
+        return 1;
+    }
+
+    if (failures > 0)
+    {
+        std::cerr << failures << " of " << results.size() << " results differ from the scalar backend\n";
+        return 1;
+    }
+
+    std::cerr << "All " << results.size() << " results match the scalar backend\n";
+    return 0;
+}
@@ -0,0 +1,33 @@
+# Renders the same image in-process and split across local worker processes, run by the workers_checksum
+# test. Tiles carry their own seeds, so both checksums must be equal.
+#
+# Expects RTIOW (the executable) and WORK_DIR.
+
+set(render_args --headless --scene random --width 96 --samples 4 --seed 5 --checksum -t ppm)
+
+foreach(mode single workers)
+    set(extra_args "")
+    if(mode STREQUAL "workers")
+        set(extra_args --workers 2)
+    endif()
+
+    execute_process(
+        COMMAND ${RTIOW} ${render_args} ${extra_args} -f ${WORK_DIR}/workers_checksum_${mode}.ppm
+        OUTPUT_VARIABLE output
+        RESULT_VARIABLE result)
+
+    if(NOT result EQUAL 0)
+        message(FATAL_ERROR "The ${mode} render failed")
+    endif()
+
+    string(REGEX MATCH "Checksum [0-9a-f]+" checksum_${mode} "${output}")
+    if(NOT checksum_${mode})
+        message(FATAL_ERROR "The ${mode} render printed no checksum")
+    endif()
+endforeach()
+
+if(NOT checksum_single STREQUAL checksum_workers)
+    message(FATAL_ERROR "Two workers rendered ${checksum_workers}, a single process ${checksum_single}")
+endif()
+
+message(STATUS "Both renders gave ${checksum_single}")